@@ -0,0 +1,494 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+
+	// extends a BAT-LZ parse of blocks T_1..T_k with a new block T_{k+1},
+	// parsing only the new block. Sources may be in any old block or
+	// earlier in the new one
+
+	// the new block is parsed as greedy_BATLZ does, on its own suffix
+	// array. Each old block is searched on its own suffix array, which is
+	// already on disk, with a range maximum over the (static) distances
+	// to their next unusable position, computed from the old depths
+
+#include "segm.h"
+#include "rmq.h"
+#include "verify.h"
+#include "progress.h"
+
+#define K 4  // space/time tradeoff for bitmaps
+
+uint MAX;    // max number of copies allowed
+
+	// the new block, as in greedy_BATLZ
+
+byte *T; // null-terminated new block
+
+uint64_t n; // its length, with the terminator
+
+uintData *SA, *ISA, *Map; // its SA and inverse, Map as in greedy_BATLZ
+
+uintData *D; // distance to next unusable pos, 0 for unusable pos
+
+uintData *U; // number of uses (length of chain)
+
+wmatrix M; // wmatrix of SA
+
+segm S; // segment structures, one per wm level
+
+	// the old blocks
+
+typedef struct {
+    byte *T; // null-terminated text of the block
+    uint64_t n; // its length, without the terminator
+    uint64_t start; // its position in the old text
+    uintData *SA; // its suffix array, without the terminator
+    uintData *DSA; // DSA[k] = usable length from SA[k], within the block
+    rmq R; // range maximum on DSA
+    } oldblock;
+
+oldblock *B; // the k old blocks
+uint k;
+
+uint64_t n0; // old text length, without the terminator
+
+uintData *U0; // chain length of each old position
+
+// initializes the structures of the new block, given SA and ISA of
+// length n and maximum allowed chain length
+void initialize (uint64_t n, uint64_t maxChain)
+{
+  uint64_t i;
+  uint depth;
+	// create the data D and U
+  D = myalloc (n*sizeof(uintData));
+  for (i=0;i<n;i++) D[i] = n; // maximum bound for all positions
+  U = myalloc (n*sizeof(uintData));
+	// create wavelet matrix on the SA
+  depth = numbits(n);
+
+  fprintf(stderr,"Creating wavelet matrix... "); fflush(stderr);
+
+  M = wmCreate (n,depth,SA,K);
+
+  fprintf(stderr,"done\n");
+
+  Map = SA; // SA was scrambled by wmCreate
+
+  // create the segments, one per wmatrix level
+
+  fprintf(stderr,"Creating chain structures... "); fflush(stderr);
+
+  S = segmCreate(M,D,Map);
+
+  fprintf(stderr,"done\n");
+
+	// stores the maximum number of copies
+  if (maxChain == 0)
+  {
+    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
+    exit(1);
+  }
+  MAX = maxChain;
+}
+
+#define nomax ((uint64_t)~0)
+
+// finds the longest admissible phrase T[i..], returning matching length
+// and source
+static uint64_t check (segm S, int64_t i, int64_t sp, int64_t ep,
+		       uintData val)
+
+{ uint lev = 0;
+  int p = numbits(S->size);
+  uint64_t v,maxv;
+  int64_t nsp,nep;
+
+  maxv = nomax;
+  while ((i >= 0) && (sp <= ep))
+  {
+    p--;
+    if (i >= (1<<p)-1) // all the left part is inside
+    {
+      nsp = sp; nep = ep;
+      wmTrackLeftRange (S->wm,lev,&nsp,&nep);
+      if (nsp <= nep)
+      {
+        v = cappedMax (S,lev+1,nsp,nep,val);
+        v = Map[v];
+        if (D[v] >= val) return v;
+        if ((maxv == nomax) || (D[v] > D[maxv])) maxv = v;
+      }
+      i -= (1<<p);
+      wmTrackRightRange (S->wm,lev,&sp,&ep);
+    }
+    else
+    {
+      wmTrackLeftRange (S->wm,lev,&sp,&ep);
+    }
+    lev++;
+  }
+
+  return maxv;
+}
+
+
+// SA[sp..ep] corresponds to T[i..i+len-1], extend by 1 char and
+// descend the whole stree edge
+uint64_t restrictRange (int64_t sp, int64_t ep, uint64_t i, uint64_t len,
+		   int64_t *nsp, int64_t *nep)
+{
+  int64_t p,m,om;
+  byte c,c0 = T[i+len];
+  while (sp <= ep)
+  {
+    m = (sp+ep)/2;
+    c = T[SA[m]+len];
+    if (c == c0) break;
+    if (c < c0) sp = m+1;
+    else ep = m-1;
+  }
+  if (sp > ep)
+  {
+    *nsp = sp; *nep = ep; return len;
+  }
+  // char found at m
+  p = om = m;
+  *nsp = sp;
+  while (*nsp < p)
+  {
+    m = (*nsp+p)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nsp = m+1;
+  }
+  p = om;
+  *nep = ep;
+  while (*nep > p)
+  {
+    m = (*nep+p+1)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nep = m-1;
+  }
+  if (*nsp == *nep)
+    return n-SA[*nsp]; // stree leaf
+
+  while (T[SA[*nsp]+len] == T[SA[*nep]+len]) len++;
+
+  return len;
+}
+
+uint64_t nextPhrase (uint64_t i, uint64_t *source)
+{
+  uint64_t n = S->size; // text length
+  int64_t sp,ep,nsp,nep;
+  uint64_t len,l,maxl;
+
+  len = 0; sp = 0; ep = n-1;
+
+  while (1) // text terminator ensures termination here
+  {
+    l = restrictRange (sp,ep,i,len,&nsp,&nep);
+    if (nsp > nep) break; // cannot be extended even to len
+    maxl = check (S,i-1,nsp,nep,l);
+    if ((maxl == nomax) || (D[maxl] <= len)) break; // has no points
+    *source = maxl; len = D[*source];
+    sp = nsp; ep = nep;
+    if (len < l) break; // cannot be extended beyond l
+    len = l;
+  }
+  return len;
+}
+
+// the same on old block b, whose SA does not contain T[i..], so the
+// chars of each edge are compared with it. The phrase cannot reach the
+// terminator of the new block
+uint64_t nextPhraseOld (oldblock *b, uint64_t i, uint64_t *source)
+{
+  int64_t sp,ep,nsp,nep,p,m;
+  uint64_t len,l,best,s;
+  byte c0;
+
+  best = 0; len = 0; sp = 0; ep = b->n-1;
+
+  while (i+len < n-1)
+  {
+    c0 = T[i+len];
+    nsp = sp; nep = ep; // first and last suffix with c0 at len
+    while (nsp < nep)
+    {
+      m = (nsp+nep)/2;
+      if (b->T[b->SA[m]+len] < c0) nsp = m+1; else nep = m;
+    }
+    if (b->T[b->SA[nsp]+len] != c0) break;
+    p = nsp; nep = ep;
+    while (p < nep)
+    {
+      m = (p+nep+1)/2;
+      if (b->T[b->SA[m]+len] > c0) nep = m-1; else p = m;
+    }
+    l = len+1;
+    while ((i+l < n-1) && (b->T[b->SA[nsp]+l] == T[i+l]) &&
+           (b->T[b->SA[nep]+l] == T[i+l])) l++;
+    p = rmqMax(b->R,nsp,nep);
+    if (b->DSA[p] <= len) break; // no usable source this long
+    s = b->SA[p];
+    *source = b->start+s; best = min(b->DSA[p],l);
+    if (b->DSA[p] < l) break; // cannot be extended beyond it
+    len = l; sp = nsp; ep = nep;
+  }
+  return best;
+}
+
+
+// phrase T[i..j] = T[pi..] and T[j] is explicit
+// update D and U. last unusable position was last (can be -1 at first)
+// the source is in the new block, or in the old text if old
+// returns new value of last
+int64_t copyPhrase (uint64_t i, uint64_t j, uint64_t pi, bool old,
+		    int64_t last)
+{
+  int64_t k,s;
+  s = pi;
+  for (k = i; k < j; k++)
+	{
+    U[k] = (old ? U0[s] : U[s])+1;
+	  s++; if (!old && (s == i)) s = pi; // for self-overlapping phrases
+	  if (U[k] >= MAX) // new unusable position
+	     while (last < k)
+        {
+          last++;
+          D[last] = k-last;
+          segmUpdate(S,ISA[last],D[last]);
+        }
+	}
+
+  U[j] = 0; // explicit char
+
+  return last;
+}
+
+
+bool file_exists (char *filename) {
+  struct stat   buffer;
+  return (stat (filename, &buffer) == 0);
+}
+
+// reads text file fname into *T, null-terminated, and its suffix array,
+// created with gensa if it does not exist, into *SA. Gives its length
+uint64_t readBlock (char *fname, byte **T, uintData **SA)
+{
+  struct stat st;
+  FILE *f;
+  uint64_t n;
+  char fnameSA[1024];
+
+  strcpy (fnameSA,fname);
+  strcat(fnameSA,".sa");
+  if (stat(fname,&st) != 0)
+  {
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  n = st.st_size;
+  f = fopen(fname,"r");
+  if ((f == NULL) || (n == 0))
+  {
+    fprintf(stderr,"Cannot open %s, or it is empty\n",fname);
+    exit(1);
+  }
+  *T = myalloc(n+1);
+  fread (*T,1,n,f);
+  fclose(f);
+  (*T)[n] = 0;
+
+  if (!file_exists(fnameSA))
+  {
+    fprintf(stderr,"File %s does not exist, creating it\n",fnameSA);
+    char cmdbuf[1024];
+    snprintf (cmdbuf, sizeof(cmdbuf), "./gensa %s %s", fname, fnameSA);
+    int ret = system(cmdbuf);
+    if (ret != 0)
+    {
+      fprintf(stderr,"Error creating %s\n",fnameSA);
+      exit(1);
+    }
+  }
+
+  f = fopen(fnameSA,"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",fnameSA);
+    exit(1);
+  }
+  *SA = myalloc((n+1)*sizeof(uintData));
+  (*SA)[0] = n; // simulate the final \0, kkp does not add it
+  fread (*SA+1,sizeof(uintData),n,f);
+  fclose(f);
+  return n;
+}
+
+// loads old block b from file fname, and prepares it for searching
+// with the distances D0 of the old text
+void loadOld (oldblock *b, char *fname, uintData *D0)
+{
+  uint64_t i;
+  b->n = readBlock(fname,&b->T,&b->SA);
+  b->SA++; // the terminator cannot be copied, so it is not searched
+  b->DSA = myalloc(b->n*sizeof(uintData));
+  for (i=0;i<b->n;i++)
+    b->DSA[i] = min(D0[b->start+b->SA[i]],b->n-b->SA[i]);
+  b->R = rmqCreate(b->DSA,b->n);
+}
+
+void main (int argc, char **argv)
+{
+  uint64_t z,i,j,len,source,l,s,m;
+  int64_t last = -1;
+  uint b,bs;
+  FILE *f;
+  archive A;
+  archive V = NULL; // phrases kept for --verify
+  uintData *D0;
+  byte *TV;
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  progress P;
+
+  if (argFlag(&argc,argv,"--verify")) V = arcCreate();
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
+
+  if (argc < 4)
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> <maxchain> "
+    "<block_1> ... <block_k> <new_block> [--verify]\n"
+    "[--progress <s>] [--status <file>] [--status-socket <path>]\n"
+    "<compressed_file> is a parse of <block_1>...<block_k> concatenated,\n"
+    "which is extended with <new_block> and written to stdout\n"
+    "There must exist <block_i>.sa, <new_block>.sa is created if needed\n"
+    "--verify checks the parse in memory after producing it\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],PROGEVERY);
+    exit(1);
+  }
+
+  fprintf(stderr,"Reading old parse... "); fflush(stderr);
+  f = fopen(argv[1],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[1]);
+    exit(1);
+  }
+  A = arcLoad(f);
+  fclose(f);
+  if (A->r > 0)
+  {
+    fprintf(stderr,"%s is relative to a reference, cannot append to it\n",
+            argv[1]);
+    exit(1);
+  }
+  n0 = A->n-1;
+  if (A->chr[A->z-1] != 0)
+  {
+    fprintf(stderr,"%s does not end with the terminator\n",argv[1]);
+    exit(1);
+  }
+  MAX = atoi(argv[2]);
+  if (MAX == 0)
+  {
+    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
+    exit(1);
+  }
+	// the distance of each old position to the next unusable one
+  U0 = arcDepths(A);
+  D0 = myalloc(n0*sizeof(uintData));
+  for (i=n0;i-- > 0;)
+    D0[i] = U0[i] >= MAX ? 0 : (i+1 < n0 ? D0[i+1]+1 : 1);
+  fprintf(stderr,"done, n = %li, z = %li phrases\n",n0,A->z);
+
+  fprintf(stderr,"Reading old blocks... "); fflush(stderr);
+  k = argc-4;
+  B = myalloc(k*sizeof(oldblock));
+  s = 0;
+  for (b=0;b<k;b++)
+  {
+    B[b].start = s;
+    loadOld(&B[b],argv[3+b],D0);
+    s += B[b].n;
+  }
+  myfree(D0);
+  if (s != n0)
+  {
+    fprintf(stderr,"\nthe blocks have %li chars, the parse %li\n",s,n0);
+    exit(1);
+  }
+  fprintf(stderr,"done\n");
+
+  fprintf(stderr,"Reading new block and its suffix array... ");
+  fflush(stderr);
+  n = readBlock(argv[argc-1],&T,&SA)+1;
+  ISA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) ISA[SA[i]] = i;
+  fprintf(stderr,"done\n");
+
+  initialize(n,MAX);
+
+	// recover SA after wm construction, to save space
+  SA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) SA[ISA[i]] = i;
+
+	// parsing
+
+  fprintf(stderr,"Parsing starts, n = %li\n",n);
+  fprintf(stderr,"File %s appended, n = %li, parsed with maxchain = %i\n\n",
+	  argv[argc-1],n0+n,MAX);
+
+	// the old terminator becomes T[0], which stays explicit
+  printf("n = %li\n", n0+n);
+  A->chr[A->z-1] = T[0];
+  for (j=0;j<A->z;j++)
+  {
+    printf("(%li,%li,%d)\n", A->source[j], A->len[j], A->chr[j]);
+    if (V != NULL) arcAdd(V,A->source[j],A->len[j],A->chr[j]);
+  }
+  copyPhrase (0,0,0,false,last);
+  i = 1; z = A->z;
+  P = progCreate(n,i,z,prog != NULL ? atof(prog) : PROGEVERY,status,sock);
+
+  while (i < n)
+  {
+    len = nextPhrase(i,&source);
+    bs = k;
+    for (b=0;b<k;b++)
+    {
+      l = nextPhraseOld(&B[b],i,&s);
+      if (l > len) { len = l; source = s; bs = b; }
+    }
+    if (len == 0) { printf("(0,0,%d)\n", T[i]); source = 0; }
+    else if (bs < k) printf("(%li,%li,%d)\n", source, len, T[i+len]);
+    else printf("(%li,%li,%d)\n", n0+source, len, T[i+len]);
+    if (V != NULL) arcAdd(V,(bs < k ? 0 : n0)+source,len,T[i+len]);
+    last = copyPhrase (i,i+len,source,bs < k,last);
+    i += len+1;
+    z++;
+    progSet(P,i,z);
+  }
+  progDestroy(P);
+  printf("\nz = %li phrases\n",z);
+  fprintf(stderr,"\n\nz = %li phrases, %li of them new\n\n",z,z-A->z);
+  if (V != NULL)
+  {
+    TV = myalloc(n0+n);
+    m = 0;
+    for (b=0;b<k;b++) { memcpy(TV+m,B[b].T,B[b].n); m += B[b].n; }
+    memcpy(TV+m,T,n);
+    if (!verifyParse(V,TV,n0+n,MAX,0)) exit(1);
+  }
+  exit(0);
+}
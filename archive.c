@@ -0,0 +1,614 @@
+
+	// supports random access to a BAT-LZ parse, as printed by the
+	// variants: phrase (s,l,c) copies T[s..s+l-1] and then adds c
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "archive.h"
+#include "elias.h"
+
+#define HEAD 7 // words after the magic: n, z, bphr, nb, words, efwords, r
+
+#define DECODEDEPTH 64 // levels of sources decoded as runs, then by chars
+
+	// creates an empty archive, to add phrases to it
+
+archive arcCreate (void)
+
+   { archive A = myalloc(sizeof(struct s_archive));
+     A->n = A->z = A->r = 0;
+     A->ref = NULL;
+     A->size = 1024;
+     A->start = myalloc((A->size+1)*sizeof(uint64_t));
+     A->source = myalloc(A->size*sizeof(uint64_t));
+     A->len = myalloc(A->size*sizeof(uint64_t));
+     A->chr = myalloc(A->size*sizeof(byte));
+     A->start[0] = 0;
+     A->cache = NULL;
+     A->map = NULL;
+     A->starts = NULL;
+     return A;
+   }
+
+	// makes the empty archive A start its phrases at position r, after
+	// a reference of length r
+
+void arcStartAt (archive A, uint64_t r)
+
+   { A->n = A->r = A->start[0] = r;
+   }
+
+	// maps file fname as the reference of A, which must be r bytes long
+
+void arcSetReference (archive A, char *fname)
+
+   { struct stat st;
+     int fd = open(fname,O_RDONLY);
+     if ((fd == -1) || fstat(fd,&st))
+	{ fprintf(stderr,"Cannot open %s\n",fname);
+	  exit(1);
+	}
+     if (st.st_size != A->r)
+	{ fprintf(stderr,"Error: reference %s has %li bytes, the parse "
+			 "expects %li\n",fname,(uint64_t)st.st_size,A->r);
+	  exit(1);
+	}
+     if (A->r == 0) { close(fd); return; }
+     A->ref = mmap(NULL,A->r,PROT_READ,MAP_SHARED,fd,0);
+     close(fd);
+     if (A->ref == MAP_FAILED)
+	{ fprintf(stderr,"Cannot map %s\n",fname);
+	  exit(1);
+	}
+   }
+
+	// appends phrase (source,len,c) to A
+
+void arcAdd (archive A, uint64_t source, uint64_t len, byte c)
+
+   { if (A->z == A->size)
+	{ A->size *= 2;
+	  A->start = myrealloc(A->start,(A->size+1)*sizeof(uint64_t));
+	  A->source = myrealloc(A->source,A->size*sizeof(uint64_t));
+	  A->len = myrealloc(A->len,A->size*sizeof(uint64_t));
+	  A->chr = myrealloc(A->chr,A->size*sizeof(byte));
+	}
+     A->source[A->z] = len ? source : 0; // greedier prints -1 sometimes
+     A->len[A->z] = len;
+     A->chr[A->z] = c;
+     A->n += len+1;
+     A->start[++A->z] = A->n;
+   }
+
+	// a phrase being read, from the arrays or from the packed data
+
+typedef struct {
+    uint64_t j; // the phrase
+    uint64_t start,source,len; // its fields
+    byte chr;
+    uint64_t pos; // next bit to read in the packed data
+    } cursor;
+
+	// decodes the fields of phrase C->j, whose start is known, from the
+	// packed data at C->pos
+
+static inline void unpack (uint64_t *data, cursor *C)
+
+   { C->len = eliasGammaRead(data,&C->pos)-1;
+     C->source = C->len ? C->start - eliasDeltaRead(data,&C->pos) : 0;
+     C->chr = streamRead(data,&C->pos,8);
+   }
+
+	// fills C with phrase j of a loaded archive
+
+static inline void fill (archive A, uint64_t j, cursor *C)
+
+   { C->j = j;
+     C->start = A->start[j];
+     C->source = A->source[j];
+     C->len = A->len[j];
+     C->chr = A->chr[j];
+   }
+
+	// moves C to the next phrase, which must exist. In the packed data
+	// the blocks follow each other, so it is read where C is
+
+static inline void next (archive A, cursor *C)
+
+   { if (A->map == NULL) { fill(A,C->j+1,C); return; }
+     C->j++;
+     C->start += C->len+1;
+     unpack(A->data,C);
+   }
+
+	// sets C to the phrase that covers T[i]
+
+static void seek (archive A, uint64_t i, cursor *C)
+
+   { uint64_t l,r,m;
+     if (A->map == NULL)
+	{ l = 0; r = A->z-1; // binary search, z > 0
+	  while (l < r)
+	     { m = (l+r+1)/2;
+	       if (A->start[m] <= i) l = m; else r = m-1;
+	     }
+	  fill(A,l,C);
+	  return;
+	}
+     if (A->starts != NULL) l = efPred(A->starts,i)/A->bphr;
+     else { l = 0; r = A->nb-1; // binary search on the directory
+	    while (l < r)
+	       { m = (l+r+1)/2;
+		 if (A->tstart[m] <= i) l = m; else r = m-1;
+	       }
+	  }
+     C->j = l*A->bphr;
+     C->start = A->tstart[l];
+     C->pos = A->boff[l];
+     unpack(A->data,C);
+     while (C->start+C->len < i) next(A,C);
+   }
+
+	// a range of packed blocks to decode into A
+
+typedef struct {
+    archive A;
+    uint64_t *data; // the packed phrases
+    uint64_t *boff; // bit offset of each block in data
+    uint64_t *tstart; // text position of each block
+    uint64_t bphr; // phrases per block
+    uint64_t from,to; // blocks to decode
+    } unpackjob;
+
+	// decodes blocks J->from..J->to-1 into the arrays of J->A, which
+	// are already allocated. Each block needs only its offsets
+
+static void *unpackBlocks (void *arg)
+
+   { unpackjob *J = (unpackjob*)arg;
+     archive A = J->A;
+     uint64_t b,j,last;
+     cursor C;
+     for (b=J->from;b<J->to;b++)
+	{ C.pos = J->boff[b];
+	  C.start = J->tstart[b];
+	  last = min((b+1)*J->bphr,A->z);
+	  for (j=b*J->bphr;j<last;j++)
+	     { unpack(J->data,&C);
+	       A->start[j] = C.start;
+	       A->source[j] = C.source;
+	       A->len[j] = C.len;
+	       A->chr[j] = C.chr;
+	       C.start += C.len+1;
+	     }
+	}
+     return NULL;
+   }
+
+	// loads the rest of a packed archive from file, after its magic.
+	// The blocks are decoded in parallel, one thread per core
+
+static archive loadPacked (FILE *file)
+
+   { archive A = myalloc(sizeof(struct s_archive));
+     uint64_t head[HEAD],nb,words,*boff,*tstart,*data,t,threads;
+     pthread_t *th;
+     unpackjob *J;
+     if (fread(head,sizeof(uint64_t),HEAD,file) != HEAD)
+	{ fprintf(stderr,"Error: truncated packed archive\n");
+	  exit(1);
+	}
+     A->n = head[0]; A->z = A->size = head[1];
+     A->r = head[6]; A->ref = NULL;
+     nb = head[3]; words = head[4];
+     boff = myalloc((nb+1)*sizeof(uint64_t));
+     tstart = myalloc(nb*sizeof(uint64_t));
+     data = myalloc((words+1)*sizeof(uint64_t));
+     if ((fread(boff,sizeof(uint64_t),nb+1,file) != nb+1) ||
+	 (fread(tstart,sizeof(uint64_t),nb,file) != nb) ||
+	 (fread(data,sizeof(uint64_t),words+1,file) != words+1))
+	{ fprintf(stderr,"Error: truncated packed archive\n");
+	  exit(1);
+	}
+     A->start = myalloc((A->size+1)*sizeof(uint64_t));
+     A->source = myalloc(A->size*sizeof(uint64_t));
+     A->len = myalloc(A->size*sizeof(uint64_t));
+     A->chr = myalloc(A->size*sizeof(byte));
+     A->start[A->z] = A->n;
+     A->cache = NULL;
+     A->map = NULL;
+     A->starts = NULL; // the set of starts is not needed with the arrays
+     eliasInit();
+     threads = sysconf(_SC_NPROCESSORS_ONLN);
+     if (threads > nb) threads = nb;
+     th = myalloc(threads*sizeof(pthread_t));
+     J = myalloc(threads*sizeof(unpackjob));
+     for (t=0;t<threads;t++)
+	{ J[t].A = A; J[t].data = data; J[t].boff = boff;
+	  J[t].tstart = tstart; J[t].bphr = head[2];
+	  J[t].from = t*nb/threads; J[t].to = (t+1)*nb/threads;
+	  pthread_create(&th[t],NULL,unpackBlocks,&J[t]);
+	}
+     for (t=0;t<threads;t++) pthread_join(th[t],NULL);
+     myfree(th); myfree(J);
+     myfree(boff); myfree(tstart); myfree(data);
+     return A;
+   }
+
+	// loads archive from file, in the format printed by the variants
+	// or in the packed one, which must be opened for reading
+
+archive arcLoad (FILE *file)
+
+   { archive A;
+     int64_t n,r,source,len;
+     int c;
+     char magic[8];
+     c = getc(file); // the printed format never starts with the magic
+     if (c == ARCMAGIC[0])
+	{ magic[0] = c;
+	  if ((fread(magic+1,1,7,file) != 7) || memcmp(magic,ARCMAGIC,8))
+	     { fprintf(stderr,"Error: wrong magic in packed archive\n");
+	       exit(1);
+	     }
+	  return loadPacked(file);
+	}
+     ungetc(c,file);
+     if (fscanf(file," r = %li",&r) != 1) r = 0; // relative parses
+     if (fscanf(file," n = %li",&n) != 1)
+	{ fprintf(stderr,"Error: archive does not start with n = ...\n");
+	  exit(1);
+	}
+     A = arcCreate();
+     arcStartAt(A,r);
+     while (fscanf(file," (%li,%li,%i)",&source,&len,&c) == 3)
+	arcAdd(A,source,len,(byte)c);
+     if (A->n != n)
+	{ fprintf(stderr,"Error: archive says n = %li but phrases "
+			 "cover %li positions\n",n,A->n);
+	  exit(1);
+	}
+     return A;
+   }
+
+	// maps the packed archive in file fname, in constant time. Gives
+	// NULL if fname is not packed. Mapped archives only support
+	// arcPhrase, arcAccess and arcExtract
+
+archive arcMap (char *fname)
+
+   { archive A;
+     struct stat st;
+     uint64_t *head,words;
+     int fd = open(fname,O_RDONLY);
+     void *map;
+     if (fd == -1)
+	{ fprintf(stderr,"Cannot open %s\n",fname);
+	  exit(1);
+	}
+     fstat(fd,&st);
+     if (st.st_size < 8+HEAD*sizeof(uint64_t)) { close(fd); return NULL; }
+     map = mmap(NULL,st.st_size,PROT_READ,MAP_SHARED,fd,0);
+     close(fd);
+     if (map == MAP_FAILED)
+	{ fprintf(stderr,"Cannot map %s\n",fname);
+	  exit(1);
+	}
+     if (memcmp(map,ARCMAGIC,8)) { munmap(map,st.st_size); return NULL; }
+     A = myalloc(sizeof(struct s_archive));
+     A->map = map; A->mapsize = st.st_size;
+     head = (uint64_t*)((char*)map+8);
+     A->n = head[0]; A->z = head[1]; A->bphr = head[2]; A->nb = head[3];
+     A->r = head[6]; A->ref = NULL;
+     A->size = 0;
+     A->start = A->source = A->len = NULL;
+     A->chr = NULL;
+     A->cache = NULL;
+     A->boff = head+HEAD;
+     A->tstart = A->boff+A->nb+1;
+     A->data = A->tstart+A->nb;
+     A->starts = head[5] ? efMap(A->data+head[4]+1,&words) : NULL;
+     eliasInit();
+     return A;
+   }
+
+	// writes A to file in the packed format, in blocks of bphr phrases
+	// that can be decoded independently, and gives the bytes written.
+	// Lengths are gamma-coded, the distances from each phrase to its
+	// source are delta-coded, and the chars are stored in 8 bits. If
+	// starts, the Elias-Fano set of phrase starts is also written
+
+uint64_t arcSave (archive A, FILE *file, uint64_t bphr, int starts)
+
+   { uint64_t head[HEAD],nb,b,j,*boff,*tstart;
+     bitstream S = streamCreate();
+     efset E = NULL;
+     nb = (A->z+bphr-1)/bphr;
+     boff = myalloc((nb+1)*sizeof(uint64_t));
+     tstart = myalloc(nb*sizeof(uint64_t));
+     for (b=0;b<nb;b++)
+	{ boff[b] = S->pos;
+	  tstart[b] = A->start[b*bphr];
+	  for (j=b*bphr;j<min((b+1)*bphr,A->z);j++)
+	     { eliasGammaWrite(S,A->len[j]+1);
+	       if (A->len[j]) eliasDeltaWrite(S,A->start[j]-A->source[j]);
+	       streamWrite(S,A->chr[j],8);
+	     }
+	}
+     boff[nb] = S->pos;
+     head[0] = A->n; head[1] = A->z; head[2] = bphr; head[3] = nb;
+     head[4] = streamWords(S);
+     S->data[head[4]] = 0; // the word after the last, to read across
+     head[5] = 0; head[6] = A->r;
+     if (starts)
+	{ E = efCreate(A->start,A->z,A->n);
+	  head[5] = E->words;
+	}
+     fwrite(ARCMAGIC,1,8,file);
+     fwrite(head,sizeof(uint64_t),HEAD,file);
+     fwrite(boff,sizeof(uint64_t),nb+1,file);
+     fwrite(tstart,sizeof(uint64_t),nb,file);
+     fwrite(S->data,sizeof(uint64_t),head[4]+1,file);
+     if (E != NULL) { efSave(E,file); efDestroy(E); }
+     myfree(boff); myfree(tstart);
+     streamDestroy(S);
+     return 8 + (HEAD+2*nb+1+head[4]+1+head[5])*sizeof(uint64_t);
+   }
+
+	// writes A to file in the format printed by the variants
+
+void arcPrint (archive A, FILE *file)
+
+   { uint64_t j;
+     if (A->r) fprintf(file,"r = %li\n",A->r);
+     fprintf(file,"n = %li\n",A->n);
+     for (j=0;j<A->z;j++)
+	 fprintf(file,"(%li,%li,%i)\n",A->source[j],A->len[j],A->chr[j]);
+   }
+
+	// destroys A, not its cache
+
+void arcDestroy (archive A)
+
+   { if (A->ref != NULL) munmap(A->ref,A->r);
+     if (A->map != NULL)
+	{ if (A->starts != NULL) efDestroy(A->starts);
+	  munmap(A->map,A->mapsize);
+	  myfree(A);
+	  return;
+	}
+     myfree(A->start);
+     myfree(A->source);
+     myfree(A->len);
+     myfree(A->chr);
+     myfree(A);
+   }
+
+	// gives space of archive in w-bit words, not counting its cache.
+	// For a mapped archive, this is the mapped file
+
+uint64_t arcSpace (archive A)
+
+   { if (A->map != NULL)
+	return (sizeof(struct s_archive) + A->mapsize)/(w/8);
+     return (sizeof(struct s_archive) + A->size*(3*sizeof(uint64_t)+1)
+	     + sizeof(uint64_t))/(w/8);
+   }
+
+	// puts cache C (or NULL for none) in front of the extraction
+
+void arcSetCache (archive A, blkcache C)
+
+   { A->cache = C;
+   }
+
+	// gives the phrase that covers T[i], or z = 0 if the parse is empty
+
+uint64_t arcPhrase (archive A, uint64_t i)
+
+   { cursor C;
+     if (A->z == 0) return 0; // seek needs a phrase
+     if (A->starts != NULL) return efPred(A->starts,i);
+     seek(A,i,&C);
+     return C.j;
+   }
+
+	// gives T[i], i < r, from the reference
+
+static inline byte reference (archive A, uint64_t i)
+
+   { if (A->ref == NULL)
+	{ fprintf(stderr,"Error: the parse is relative to a reference, "
+			 "which was not given\n");
+	  exit(1);
+	}
+     return A->ref[i];
+   }
+
+	// follows the chain from T[i] until an explicit char is found, or
+	// until it lands in a cached block. A self-overlapping copy is
+	// periodic, so it is followed to its first period as the variants
+	// count it
+
+static byte follow (archive A, uint64_t i)
+
+   { cursor C;
+     byte c;
+     while (1)
+	{ if (i < A->r) return reference(A,i);
+	  if ((A->cache != NULL) &&
+	      cachePeek(A->cache,i/cacheBlock(A->cache),
+		       i%cacheBlock(A->cache),1,&c)) return c;
+	  seek(A,i,&C);
+	  if (i == C.start+C.len) return C.chr;
+	  i = C.source + (i - C.start) % (C.start-C.source);
+	}
+   }
+
+static void decodeAt (archive A, uint64_t i, uint64_t len, byte *buf,
+		      uint depth);
+
+	// writes T[i..i+len-1] into buf, the sources of a run of a copy.
+	// Each block they span is taken from the cache under one lock, or
+	// decoded in turn if it is not cached, so a chain of hops does not
+	// lock the cache at each char. Past DECODEDEPTH levels, or without a
+	// cache, each char is followed on its own
+
+static void resolve (archive A, uint64_t i, uint64_t len, byte *buf,
+		     uint depth)
+
+   { uint64_t bs,b,from,to,p;
+     if ((A->cache == NULL) || (depth == DECODEDEPTH))
+	{ for (p=i;p<i+len;p++) buf[p-i] = follow(A,p);
+	  return;
+	}
+     bs = cacheBlock(A->cache);
+     for (b=i/bs;b*bs<i+len;b++)
+	{ from = max(i,b*bs); to = min(i+len,(b+1)*bs);
+	  if (!cachePeek(A->cache,b,from-b*bs,to-from,buf+from-i))
+	     decodeAt(A,from,to-from,buf+from-i,depth+1);
+	}
+   }
+
+	// writes T[i..i+len-1] into buf, uncached, at the given depth of
+	// resolve. Copies whose source falls inside buf are solved from buf
+	// itself, and the others a run at a time
+
+static void decodeAt (archive A, uint64_t i, uint64_t len, byte *buf,
+		      uint depth)
+
+   { uint64_t p,s,k;
+     cursor C;
+     for (p=i;(p<A->r) && (p<i+len);p++) buf[p-i] = reference(A,p);
+     if (p == i+len) return;
+     seek(A,p,&C);
+     while (p < i+len)
+	{ if (C.start+C.len < p) next(A,&C);
+	  if (p == C.start+C.len) { buf[p-i] = C.chr; p++; continue; }
+	  s = C.source + (p - C.start);
+	  if (s >= i) { buf[p-i] = buf[s-i]; p++; continue; }
+		// up to the explicit char, the end, or the sources in buf
+	  k = min(min(C.start+C.len,i+len),p+(i-s)) - p;
+	  resolve(A,s,k,buf+p-i,depth);
+	  p += k;
+	}
+   }
+
+	// writes T[i..i+len-1] into buf, uncached
+
+static void decode (archive A, uint64_t i, uint64_t len, byte *buf)
+
+   { decodeAt(A,i,len,buf,0);
+   }
+
+	// decodes block b into buf and caches it
+
+static void load (archive A, uint64_t b, byte *buf)
+
+   { uint64_t bs = cacheBlock(A->cache);
+     uint64_t i = b*bs;
+     if (i+bs > A->n)
+	{ decode(A,i,A->n-i,buf);
+	  memset(buf+A->n-i,0,i+bs-A->n);
+	}
+     else decode(A,i,bs,buf);
+     cachePut(A->cache,b,buf);
+   }
+
+	// brings block b into buf, from the cache or decoding and caching it
+
+static void block (archive A, uint64_t b, byte *buf)
+
+   { if (!cacheRead(A->cache,b,buf)) load(A,b,buf);
+   }
+
+	// gives T[i]
+
+byte arcAccess (archive A, uint64_t i)
+
+   { uint64_t bs;
+     byte c,*buf;
+     if (A->cache == NULL) return follow(A,i);
+     bs = cacheBlock(A->cache);
+     if (cacheGet(A->cache,i/bs,i%bs,&c)) return c;
+     buf = myalloc(bs); // the miss is already counted
+     load(A,i/bs,buf);
+     c = buf[i%bs];
+     myfree(buf);
+     return c;
+   }
+
+	// writes T[i..i+len-1] into buf
+
+void arcExtract (archive A, uint64_t i, uint64_t len, byte *buf)
+
+   { uint64_t bs,b,from,to;
+     byte *bbuf;
+     if (A->cache == NULL) { decode(A,i,len,buf); return; }
+     bs = cacheBlock(A->cache);
+     bbuf = myalloc(bs);
+     for (b=i/bs;b*bs<i+len;b++)
+	{ block(A,b,bbuf);
+	  from = max(i,b*bs); to = min(i+len,(b+1)*bs);
+	  memcpy(buf+from-i,bbuf+from-b*bs,to-from);
+	}
+     myfree(bbuf);
+   }
+
+	// allocates and gives the chain length of every text position,
+	// computed left to right as the variants do
+
+uintData *arcDepths (archive A)
+
+   { uint64_t j,p,t;
+     uintData *U = myalloc(A->n*sizeof(uintData));
+     for (p=0;p<A->r;p++) U[p] = 0;
+     for (j=0;j<A->z;j++)
+	{ p = A->start[j];
+	  for (t=0;t<A->len[j];t++)
+	      U[p+t] = U[A->source[j] + t % (p-A->source[j])] + 1;
+	  U[p+A->len[j]] = 0;
+	}
+     return U;
+   }
+
+static double now (void)
+
+   { struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC,&t);
+     return t.tv_sec + t.tv_nsec/1e9;
+   }
+
+	// gives the time to extract len bytes from queries random positions,
+	// in microseconds per byte, the best of three rounds. The positions
+	// are drawn with xorshift64* before timing
+
+double arcLatency (archive A, uint64_t len, uint64_t queries, uint64_t seed)
+
+   { uint64_t *pos,q,x,round;
+     byte *buf;
+     double t,best = 0;
+     if (len > A->n-A->r) len = A->n-A->r;
+     if ((len == 0) || (queries == 0)) return 0;
+     pos = myalloc(queries*sizeof(uint64_t));
+     x = seed ? seed : 1;
+     for (q=0;q<queries;q++)
+	{ x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+	  pos[q] = A->r + (x*0x2545F4914F6CDD1DULL) % (A->n-A->r-len+1);
+	}
+     buf = myalloc(len);
+     for (round=0;round<3;round++)
+	{ t = now();
+	  for (q=0;q<queries;q++) arcExtract(A,pos[q],len,buf);
+	  t = (now()-t)*1e6/(queries*len);
+	  if ((round == 0) || (t < best)) best = t;
+	}
+     myfree(buf); myfree(pos);
+     return best;
+   }
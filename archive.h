@@ -0,0 +1,108 @@
+
+#ifndef INCLUDEDarchive
+#define INCLUDEDarchive
+
+	// supports random access to a BAT-LZ parse, as printed by the
+	// variants: phrase (s,l,c) copies T[s..s+l-1] and then adds c
+
+	// T[i] is obtained by following the chain of copies from i until
+	// an explicit char is reached, so it costs as many hops as the
+	// chain length of i, which the parse bounds by maxchain
+
+	// a packed archive can also be mapped from its file instead of
+	// loaded. The phrases are then decoded on demand: the directory of
+	// blocks, or the Elias-Fano set of phrase starts if it was stored,
+	// leads to the block of the phrase, which is decoded from its start
+
+	// a relative parse copies also from a reference text R, which is
+	// stored apart: positions 0..r-1 are R, explicit with chain length
+	// 0, and the phrases start at position r
+
+#include "cache.h"
+#include "efset.h"
+
+#define ARCMAGIC "BATLZPK3" // starts the packed format, 8 bytes
+#define ARCBLOCK 256 // default phrases per packed block
+
+typedef struct s_archive {
+    uint64_t n; // text length, including the final terminator
+    uint64_t r; // reference length, 0 if the parse is not relative
+    byte *ref; // the mapped reference, NULL if not set
+    uint64_t z; // number of phrases
+    uint64_t size; // allocated phrases
+    uint64_t *start; // text position of each phrase, start[z] = n
+    uint64_t *source; // source of each phrase
+    uint64_t *len; // copied length of each phrase, char at start+len
+    byte *chr; // explicit char of each phrase
+    blkcache cache; // decoded blocks, NULL if not used
+	// only for mapped archives, whose arrays above are NULL
+    void *map; // the mapped file, NULL if the archive is loaded
+    uint64_t mapsize; // its length in bytes
+    uint64_t bphr; // phrases per block
+    uint64_t nb; // number of blocks
+    uint64_t *boff; // bit offset of each block in data, boff[nb] = end
+    uint64_t *tstart; // text position of each block
+    uint64_t *data; // the packed phrases
+    efset starts; // the text position of each phrase, or NULL
+    } *archive;
+
+	// creates an empty archive, to add phrases to it
+archive arcCreate (void);
+
+	// makes the empty archive A start its phrases at position r, after
+	// a reference of length r
+void arcStartAt (archive A, uint64_t r);
+
+	// maps file fname as the reference of A, which must be r bytes long
+void arcSetReference (archive A, char *fname);
+
+	// appends phrase (source,len,c) to A
+void arcAdd (archive A, uint64_t source, uint64_t len, byte c);
+
+	// loads archive from file, in the format printed by the variants
+	// or in the packed one, which must be opened for reading
+archive arcLoad (FILE *file);
+
+	// maps the packed archive in file fname, in constant time. Gives
+	// NULL if fname is not packed. Mapped archives only support
+	// arcPhrase, arcAccess and arcExtract
+archive arcMap (char *fname);
+
+	// writes A to file in the packed format, in blocks of bphr phrases
+	// that can be decoded independently, and gives the bytes written.
+	// Lengths are gamma-coded, the distances from each phrase to its
+	// source are delta-coded, and the chars are stored in 8 bits. If
+	// starts, the Elias-Fano set of phrase starts is also written
+uint64_t arcSave (archive A, FILE *file, uint64_t bphr, int starts);
+
+	// writes A to file in the format printed by the variants
+void arcPrint (archive A, FILE *file);
+
+	// destroys A, not its cache
+void arcDestroy (archive A);
+
+	// gives space of archive in w-bit words, not counting its cache.
+	// For a mapped archive, this is the mapped file
+uint64_t arcSpace (archive A);
+
+	// puts cache C (or NULL for none) in front of the extraction
+void arcSetCache (archive A, blkcache C);
+
+	// gives the phrase that covers T[i], or z = 0 if the parse is empty
+uint64_t arcPhrase (archive A, uint64_t i);
+
+	// gives T[i]
+byte arcAccess (archive A, uint64_t i);
+
+	// writes T[i..i+len-1] into buf
+void arcExtract (archive A, uint64_t i, uint64_t len, byte *buf);
+
+	// allocates and gives the chain length of every text position
+uintData *arcDepths (archive A);
+
+	// gives the time to extract len bytes from each of queries random
+	// positions of A, drawn from seed, in microseconds per extracted
+	// byte. The best of three rounds is given, to discount noise
+double arcLatency (archive A, uint64_t len, uint64_t queries, uint64_t seed);
+
+#endif
@@ -11,6 +11,9 @@
 	// change uintA to uint64_t to handle longer texts
 
 #include "segm.h"
+#include "verify.h"
+#include "depth.h"
+#include "progress.h"
 
 #define K 4  // space/time tradeoff for bitmaps
 
@@ -196,9 +199,7 @@ void copyPhrase (uint64_t i, uint64_t j, uint64_t pi)
     U[k] = U[s]+1;
 	  s++; 
     if (s == i) s = pi; // for self-overlapping phrases     
-    if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
 	}
-  if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
   
   U[j] = 0; // explicit char
 }
@@ -215,14 +216,35 @@ void main (int argc, char **argv)
   struct stat st;
   FILE *f;
   char fname[1024];
+  archive V = NULL; // phrases kept for --verify and --depths
+  char *depths; // file for --depths
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  progress P;
+  int verify;
   char fnameSA[1024];
 
+  verify = argFlag(&argc,argv,"--verify");
+  depths = argOption(&argc,argv,"--depths");
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
+  if (verify || (depths != NULL)) V = arcCreate();
+
   if (argc < 2)
   { 
-    fprintf(stderr,"Usage: %s <filename> [<maxchain>]\n"
+    fprintf(stderr,"Usage: %s <filename> [<maxchain>] [--verify] "
+    "[--depths <file>] [--progress <s>] [--status <file>] "
+    "[--status-socket <path>]\n"
     "There must exist <filename>.sa as well\n"
           "No maxchain uses infinity and yields the max chain\n"
-    "Redirect output to save/discard tuples\n\n",argv[0]);
+    "--verify checks the parse in memory after producing it\n"
+    "--depths writes the chain length of each position to <file>\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],PROGEVERY);
     exit(1);
   }
 
@@ -288,8 +310,10 @@ void main (int argc, char **argv)
   fprintf(stderr,"File %s, n = %li, parsed with maxchain = %i\n\n", argv[1],n,atoi(argv[2]));
   printf("n = %d\n",n);
   printf ("(0,0,%d)\n",T[0]);
+  if (V != NULL) arcAdd(V,0,0,T[0]);
   copyPhrase (0,0,0);
   i = 1; z = 1;
+  P = progCreate(n,i,z,prog != NULL ? atof(prog) : PROGEVERY,status,sock);
   
   while (i < n)
   { 
@@ -298,6 +322,7 @@ void main (int argc, char **argv)
     if (len == 0) 
     {
       printf("(0,0,%d)\n",T[i]);
+      if (V != NULL) arcAdd(V,0,0,T[i]);
       z++;
     }
     else
@@ -313,6 +338,7 @@ void main (int argc, char **argv)
           currentLen++;
         }
         printf("(%d,%d,%d)\n",sourceOut,currentLen,T[i+lenOut]);
+        if (V != NULL) arcAdd(V,sourceOut,currentLen,T[i+lenOut]);
         lenOut++;
         sourceOut = source+lenOut;
         currentLen = 0;
@@ -321,14 +347,24 @@ void main (int argc, char **argv)
       if(sourceOut <= source+len)
       {
         printf ("(%d,%d,%d)\n",sourceOut,source+len-sourceOut,T[i+len]);
+        if (V != NULL) arcAdd(V,sourceOut,source+len-sourceOut,T[i+len]);
         z++;
       }
     }
     i += len+1;
+    progSet(P,i,z);
   }
+  progDestroy(P);
 
   printf("\nz = %li\n",z);
   fprintf(stderr,"\n\nz = %li\n",z);
+  if (depths != NULL) // U holds the chains before cutting the phrases
+  {
+    myfree(U);
+    U = arcDepths(V);
+    depthStore(depths,U,n,MAX);
+  }
+  if (verify && !verifyParse(V,T,n,MAX,0)) exit(1);
 
   free(T); free(SA); free(ISA); free(Map); free(D); free(U);
   exit(0);
@@ -10,6 +10,9 @@
 	// change uintA to uint64_t to handle longer texts
 
 #include "segm.h"
+#include "verify.h"
+#include "depth.h"
+#include "progress.h"
 
 #define K 4  // space/time tradeoff for bitmaps
 
@@ -196,9 +199,7 @@ uint64_t copyPhrase (uint64_t i, uint64_t j, uint64_t pi, int64_t last,
     U[k] = U[s]+1;
     s++; if (s == i) s = pi; // for self-overlapping phrases
     if (U[k] > cmax) break;
-    if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
   }
-  if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
 
   U[k] = 0; // explicit char
 
@@ -212,13 +213,32 @@ void main (int argc, char **argv)
   struct stat st;
   FILE *f;
   char fname[1024];
+  archive V = NULL; // phrases kept for --verify
+  char *depths; // file for --depths
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  progress P;
+
+  if (argFlag(&argc,argv,"--verify")) V = arcCreate();
+  depths = argOption(&argc,argv,"--depths");
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
 
   if (argc < 2)
   { 
-    fprintf(stderr,"Usage: %s <filename> [<maxchain>]\n"
+    fprintf(stderr,"Usage: %s <filename> [<maxchain>] [--verify] "
+    "[--depths <file>] [--progress <s>] [--status <file>] "
+    "[--status-socket <path>]\n"
     "There must exist <filename>.sa as well\n"
           "No maxchain uses infinity and yields the max chain\n"
-    "Redirect output to save/discard tuples\n\n",argv[0]);
+    "--verify checks the parse in memory after producing it\n"
+    "--depths writes the chain length of each position to <file>\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],PROGEVERY);
     exit(1);
   }
 
@@ -273,8 +293,10 @@ void main (int argc, char **argv)
 
   printf("n = %d\n",n);
   printf ("(0,0,%d)\n",T[0]);
+  if (V != NULL) arcAdd(V,0,0,T[0]);
   copyPhrase (0,0,0,last,n);
   i = 1; z = 1;
+  P = progCreate(n,i,z,prog != NULL ? atof(prog) : PROGEVERY,status,sock);
   
   while (i < n)
   { 
@@ -283,9 +305,12 @@ void main (int argc, char **argv)
     len = copyPhrase (i,i+len,source,last,cmax) - i;
     if (len == 0) printf ("(0,0,%d)\n",T[i]);
     else printf ("(%d,%d,%d)\n",source,len,T[i+len]);
+    if (V != NULL) arcAdd(V,source,len,T[i+len]);
     i += len+1;
     z++;
+    progSet(P,i,z);
   }
+  progDestroy(P);
 
   printf("\nz = %li phrases\n",z);
   fprintf(stderr,"\n\nz = %li phrases\n",z);
@@ -297,5 +322,8 @@ void main (int argc, char **argv)
     fprintf(stderr,"Maximum chain length = %li\n",u);
   }
   fprintf(stderr,"\n");
+  if (depths != NULL) depthStore(depths,U,n,argc == 3 ? atoi(argv[2]) : n);
+  if ((V != NULL) && !verifyParse(V,T,n,argc == 3 ? atoi(argv[2]) : n,0)) 
+    exit(1);
   exit(0);
 }
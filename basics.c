@@ -1,4 +1,6 @@
 
+#include <string.h>
+
 #include "basics.h"
 
 void *myalloc (size_t n)
@@ -39,3 +41,29 @@ uint numbits (uint n)
      return bits ? bits : 1;
    }
 
+int argFlag (int *argc, char **argv, char *flag)
+
+   { int i,j;
+     for (i=1;i<*argc;i++)
+	 if (!strcmp(argv[i],flag))
+	    { for (j=i+1;j<*argc;j++) argv[j-1] = argv[j];
+	      (*argc)--;
+	      return 1;
+	    }
+     return 0;
+   }
+
+char *argOption (int *argc, char **argv, char *flag)
+
+   { int i,j;
+     char *val;
+     for (i=1;i+1<*argc;i++)
+	 if (!strcmp(argv[i],flag))
+	    { val = argv[i+1];
+	      for (j=i+2;j<*argc;j++) argv[j-2] = argv[j];
+	      *argc -= 2;
+	      return val;
+	    }
+     return NULL;
+   }
+
@@ -23,4 +23,11 @@ void myfree (void *p);
 	// number of bits needed to represent n, gives 1 for n=0
 uint numbits (uint n);
 
+	// removes flag from argv[1..*argc-1] if present, gives 1 if it was
+int argFlag (int *argc, char **argv, char *flag);
+
+	// removes flag and the next argument from argv[1..*argc-1] if
+	// present, gives the next argument or NULL if it was not there
+char *argOption (int *argc, char **argv, char *flag);
+
 #endif
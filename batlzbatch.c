@@ -0,0 +1,372 @@
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// runs a variant on each file of a manifest, as many at a time as a
+// memory and a core budget allow. The peak memory of each job is asked
+// to the variant itself (--estimate) from the length of its file, the
+// jobs are started from the largest, and smaller ones fill the memory
+// left while larger ones wait. Writes a CSV line per job to a results
+// file
+
+#include "memplan.h"
+
+#define MAXARGS 64 // arguments of the variant
+#define SLACK 1.1 // default factor applied to the estimates
+#define FIXED (4*1024*1024) // of a process beyond its estimate: code, stacks
+
+typedef struct {
+  char *file; // the input, from the manifest
+  uint64_t n; // its length
+  uint64_t est; // the memory reserved for the job, 0 if it is not run
+  char *why; // the reason it is not run, NULL if it is
+  pid_t pid; // while running
+  double t0; // when it started
+} job;
+
+static double now (void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// by decreasing memory, and then length and name, so that the same file
+// listed twice ends up next to itself
+static int bySize (const void *a, const void *b)
+{
+  const job *x = a,*y = b;
+  if (x->est != y->est) return x->est < y->est ? 1 : -1;
+  if (x->n != y->n) return x->n < y->n ? 1 : -1;
+  return strcmp(x->file,y->file);
+}
+
+// runs args[0] with stdout to a pipe, which is scanned for "peak = <bytes>",
+// and stderr discarded. Gives the bytes, 0 if the run failed
+static uint64_t ask (char **args)
+{
+  int fd[2],status;
+  pid_t pid;
+  FILE *out;
+  char *line = NULL;
+  size_t len = 0;
+  uint64_t peak = 0;
+
+  if (pipe(fd) != 0)
+  {
+    fprintf(stderr,"Cannot create a pipe\n");
+    exit(1);
+  }
+  fflush(stdout); fflush(stderr);
+  pid = fork();
+  if (pid < 0)
+  {
+    fprintf(stderr,"Cannot fork\n");
+    exit(1);
+  }
+  if (pid == 0)
+  {
+    int e = open("/dev/null",O_WRONLY);
+    dup2(fd[1],1);
+    if (e >= 0) dup2(e,2);
+    close(fd[0]); close(fd[1]);
+    execv(args[0],args);
+    _exit(127);
+  }
+  close(fd[1]);
+  out = fdopen(fd[0],"r");
+  while (getline(&line,&len,out) != -1) sscanf(line,"peak = %lu",&peak);
+  free(line);
+  fclose(out);
+  waitpid(pid,&status,0);
+  return (WIFEXITED(status) && (WEXITSTATUS(status) == 0)) ? peak : 0;
+}
+
+// starts args[0] with stdout to file oname and stderr to file lname
+static pid_t spawn (char **args, char *oname, char *lname)
+{
+  pid_t pid;
+  fflush(stdout); fflush(stderr);
+  pid = fork();
+  if (pid < 0)
+  {
+    fprintf(stderr,"Cannot fork\n");
+    exit(1);
+  }
+  if (pid == 0)
+  {
+    int o = open(oname,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    int e = open(lname,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if ((o < 0) || (e < 0)) _exit(126);
+    dup2(o,1); dup2(e,2);
+    close(o); close(e);
+    execv(args[0],args);
+    fprintf(stderr,"Cannot run %s\n",args[0]);
+    _exit(127);
+  }
+  return pid;
+}
+
+// the phrases written at the end of the output, "z = <z>", 0 if none
+static uint64_t phrases (char *oname)
+{
+  char buf[257],*p,*q = NULL;
+  uint64_t z = 0;
+  size_t got;
+  FILE *f = fopen(oname,"r");
+  if (f == NULL) return 0;
+  fseek(f,0,SEEK_END);
+  fseek(f,-min(ftell(f),256),SEEK_END);
+  got = fread(buf,1,256,f);
+  fclose(f);
+  buf[got] = 0;
+  for (p=buf;(p = strstr(p,"z = ")) != NULL;p++) q = p;
+  if (q != NULL) sscanf(q,"z = %lu",&z);
+  return z;
+}
+
+// writes s to f as a CSV field, quoted if it needs it
+static void field (FILE *f, char *s)
+{
+  if (strpbrk(s,",\"\n") == NULL) { fputs(s,f); return; }
+  fputc('"',f);
+  for (;*s;s++) { if (*s == '"') fputc('"',f); fputc(*s,f); }
+  fputc('"',f);
+}
+
+void main (int argc, char **argv)
+{
+  job *J = NULL,*j;
+  char *args[MAXARGS],prog[1024],*oname,*lname,*opt,*line = NULL;
+  char *extra = NULL,*suffix = ".batlz",*rname = NULL,*base;
+  uint64_t mem = 0,perByte = 0,used = 0,top = 0,nj = 0,cap = 0,k,l;
+  uint64_t done = 0,ok = 0,dup = 0,first = 0;
+  long cores = 0,running = 0;
+  double slack = SLACK,t0,secs,user,sys;
+  size_t len = 0;
+  int keep,status,na;
+  pid_t pid;
+  struct rusage ru;
+  struct stat st;
+  FILE *f,*res;
+
+  keep = argFlag(&argc,argv,"--keep-logs");
+  if ((opt = argOption(&argc,argv,"--mem")) != NULL) mem = memParse(opt);
+  if ((opt = argOption(&argc,argv,"--cores")) != NULL) cores = atol(opt);
+  if ((opt = argOption(&argc,argv,"--slack")) != NULL) slack = atof(opt);
+  if ((opt = argOption(&argc,argv,"--per-byte")) != NULL)
+    perByte = atol(opt);
+  extra = argOption(&argc,argv,"--args");
+  if ((opt = argOption(&argc,argv,"--suffix")) != NULL) suffix = opt;
+  rname = argOption(&argc,argv,"--results");
+
+  if ((argc != 4) || (slack < 1))
+  {
+    fprintf(stderr,"Usage: %s <variant> <manifest> <maxchain> "
+    "[--mem <size>] [--cores <k>]\n"
+    "[--args \"<options>\"] [--slack <f>] [--per-byte <b>] "
+    "[--suffix <s>] [--results <file>]\n"
+    "[--keep-logs]\n"
+    "Runs <variant> with <maxchain> (and the <options> given) on each\n"
+    "file listed in <manifest>, one per line, writing the parse of <file>\n"
+    "to <file><s> (.batlz by default). At most <k> jobs run at a time\n"
+    "(one per core by default), and the memory reserved for them adds up\n"
+    "to at most <size> (like 512M or 4G, no suffix is MB; the memory\n"
+    "available by default). Each job reserves the peak memory its variant\n"
+    "estimates with --estimate, times <f> (%.1f by default), or <b> bytes\n"
+    "per byte of its file with --per-byte, for variants without an\n"
+    "estimate, plus %i MB for the process. The largest jobs start first, and smaller ones take the\n"
+    "memory left. The time, peak memory, phrases and outcome of each job\n"
+    "go to <file> (<manifest>.csv by default), and its stderr to\n"
+    "<file><s>.log, kept only if it fails unless --keep-logs is given\n\n",
+    argv[0],SLACK,FIXED/1024/1024);
+    exit(1);
+  }
+  if (strchr(argv[1],'/')) strcpy(prog,argv[1]);
+  else sprintf(prog,"./%s",argv[1]); // as gensa is run by the variants
+  if (access(prog,X_OK) != 0)
+  {
+    fprintf(stderr,"Cannot run %s\n",prog);
+    exit(1);
+  }
+  if (mem == 0)
+    mem = (uint64_t)sysconf(_SC_AVPHYS_PAGES)*sysconf(_SC_PAGESIZE);
+  if (cores <= 0) cores = sysconf(_SC_NPROCESSORS_ONLN);
+  if (cores <= 0) cores = 1;
+  if (rname == NULL)
+  {
+    rname = myalloc(strlen(argv[2])+8);
+    sprintf(rname,"%s.csv",argv[2]);
+  }
+
+  // the manifest, skipping empty lines and comments
+  f = fopen(argv[2],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[2]);
+    exit(1);
+  }
+  while (getline(&line,&len,f) != -1)
+  {
+    l = strlen(line);
+    while ((l > 0) && strchr(" \t\r\n",line[l-1])) line[--l] = 0;
+    if ((l == 0) || (line[0] == '#')) continue;
+    if (nj == cap)
+    {
+      cap = cap ? 2*cap : 1024;
+      J = myrealloc(J,cap*sizeof(job));
+    }
+    j = &J[nj++];
+    j->file = strdup(line);
+    j->n = 0; j->est = 0; j->why = NULL; j->pid = 0;
+  }
+  free(line);
+  fclose(f);
+  if (nj == 0)
+  {
+    fprintf(stderr,"Error: %s lists no files\n",argv[2]);
+    exit(1);
+  }
+
+  // the arguments of the variant, the file going in args[1], and room
+  // for --estimate
+  args[0] = prog; args[2] = argv[3]; na = 3;
+  for (opt=extra ? strtok(extra," ") : NULL;opt != NULL;opt=strtok(NULL," "))
+  {
+    if (na+2 == MAXARGS)
+    {
+      fprintf(stderr,"Error: more than %i arguments in --args\n",MAXARGS-5);
+      exit(1);
+    }
+    args[na++] = opt;
+  }
+
+  // the estimates, one run of the variant per file unless --per-byte
+  fprintf(stderr,"Estimating the memory of %li jobs... ",nj); fflush(stderr);
+  args[na] = "--estimate"; args[na+1] = NULL;
+  for (k=0;k<nj;k++)
+  {
+    j = &J[k];
+    if ((stat(j->file,&st) != 0) || !S_ISREG(st.st_mode))
+    {
+      j->why = "missing";
+      continue;
+    }
+    j->n = st.st_size;
+    if (perByte) j->est = perByte*(j->n+1);
+    else
+    {
+      args[1] = j->file;
+      j->est = ask(args);
+    }
+    if (j->est == 0) { j->why = "no_estimate"; continue; }
+    j->est = j->est*slack + FIXED;
+    if (j->est > mem) j->why = "too_large";
+  }
+  args[na] = NULL;
+  fprintf(stderr,"done\n");
+  qsort(J,nj,sizeof(job),bySize);
+  for (k=1;k<nj;k++) // both would write the same output
+    if ((J[k].why == NULL) && !strcmp(J[k].file,J[k-1].file))
+    {
+      J[k].why = "duplicate";
+      dup++;
+    }
+
+  res = fopen(rname,"w");
+  if (res == NULL)
+  {
+    fprintf(stderr,"Cannot create %s\n",rname);
+    exit(1);
+  }
+  fprintf(res,"file,n,estimate_bytes,status,exit,seconds,user_seconds,"
+          "sys_seconds,peak_rss_bytes,z\n");
+  for (k=0;k<nj;k++) // those not run
+  {
+    if (J[k].why == NULL) continue;
+    field(res,J[k].file);
+    fprintf(res,",%li,%li,%s,,,,,,\n",J[k].n,J[k].est,J[k].why);
+    fprintf(stderr,"%s: not run, %s",J[k].file,J[k].why);
+    if (!strcmp(J[k].why,"too_large"))
+      fprintf(stderr,", needs %.1f MB, above the budget of %.1f MB",
+              J[k].est/1048576.0,mem/1048576.0);
+    fprintf(stderr,"\n");
+    done++;
+  }
+  fflush(res);
+  base = strrchr(prog,'/')+1;
+  fprintf(stderr,"Running %li jobs of %s, %li at a time in %.1f MB\n",
+          nj-done,base,cores,mem/1048576.0);
+
+  oname = myalloc(4096); lname = myalloc(4096);
+  t0 = now();
+  while (done < nj)
+  {
+    // from the largest pending job that fits, while there are cores
+    while ((first < nj) && ((J[first].why != NULL) || J[first].pid))
+      first++;
+    for (k=first;(k<nj) && (running<cores);k++)
+    {
+      j = &J[k];
+      if ((j->why != NULL) || j->pid || (used+j->est > mem)) continue;
+      snprintf(oname,4096,"%s%s",j->file,suffix);
+      snprintf(lname,4096,"%s%s.log",j->file,suffix);
+      args[1] = j->file;
+      j->t0 = now();
+      j->pid = spawn(args,oname,lname);
+      used += j->est;
+      if (used > top) top = used;
+      running++;
+    }
+
+    // one of them ends
+    pid = wait4(-1,&status,0,&ru);
+    if (pid < 0)
+    {
+      fprintf(stderr,"Error: lost track of the jobs\n");
+      exit(1);
+    }
+    for (k=0;(k<nj) && (J[k].pid != pid);k++);
+    if (k == nj) continue;
+    j = &J[k];
+    secs = now()-j->t0;
+    user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6;
+    sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+    snprintf(oname,4096,"%s%s",j->file,suffix);
+    snprintf(lname,4096,"%s%s.log",j->file,suffix);
+    j->why = WIFSIGNALED(status) ? "killed" :
+             WEXITSTATUS(status) != 0 ? "failed" : "ok";
+    field(res,j->file);
+    fprintf(res,",%li,%li,%s,%i,%.3f,%.3f,%.3f,%li,%li\n",j->n,j->est,
+            j->why,WIFSIGNALED(status) ? WTERMSIG(status) :
+            WEXITSTATUS(status),secs,user,sys,((uint64_t)ru.ru_maxrss)*1024,
+            phrases(oname));
+    fflush(res);
+    done++;
+    fprintf(stderr,"[%li/%li] %s: %s, %.1f s, %.1f MB of %.1f MB reserved",
+            done,nj,j->file,j->why,secs,ru.ru_maxrss/1024.0,
+            j->est/1048576.0);
+    if (((uint64_t)ru.ru_maxrss)*1024 > j->est)
+      fprintf(stderr,", above the estimate");
+    fprintf(stderr,"\n");
+    if (!strcmp(j->why,"ok"))
+    {
+      ok++;
+      if (!keep) unlink(lname);
+    }
+    else fprintf(stderr,"  see %s\n",lname);
+    used -= j->est;
+    running--;
+    j->pid = 0;
+  }
+  fclose(res);
+
+  fprintf(stderr,"\n%li of %li jobs ok in %.1f s, at most %.1f MB reserved "
+          "at a time, results in %s\n",ok,nj-dup,now()-t0,top/1048576.0,
+          rname);
+  exit(ok+dup == nj ? 0 : 1);
+}
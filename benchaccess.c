@@ -0,0 +1,281 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+// measures random access to a compressed file: throughput and latency
+// percentiles of a workload run from several threads, also broken down
+// by the chain length (depth) of the accessed positions
+
+#include "archive.h"
+#include "depth.h"
+
+#define PAGE 4096 // hot spot granularity of the zipf workload
+
+typedef struct {
+  archive A;
+  int kind; // the workload, an index in workloads[]
+  uint64_t len; // bytes per query
+  uint64_t q; // queries of the thread
+  uint64_t *pos; // their positions, then their depths
+  uint64_t *lat; // their latencies in ns
+} job;
+
+char *workloads[] = { "char", "substr", "zipf", "seq" };
+uint64_t defaultLen[] = { 1, 64, 1, 4096 };
+
+static uint64_t ns (void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec*1000000000ULL + t.tv_nsec;
+}
+
+// xorshift64*
+static uint64_t next (uint64_t *x)
+{
+  *x ^= *x >> 12; *x ^= *x << 25; *x ^= *x >> 27;
+  return *x * 0x2545F4914F6CDD1DULL;
+}
+
+// draws the positions of J's queries, in [r..n-len]. The zipf workload
+// picks the page of rank k with probability cdf[k]-cdf[k-1], where the
+// ranks are scattered over the pages by perm
+static void draw (job *J, uint64_t seed, double *cdf, uint64_t *perm,
+                  uint64_t pages)
+{
+  archive A = J->A;
+  uint64_t x = seed ? seed : 1;
+  uint64_t span = A->n-A->r-J->len+1;
+  uint64_t k,l,r,m,p;
+  double u;
+  for (k=0;k<J->q;k++)
+  {
+    if (!strcmp(workloads[J->kind],"zipf"))
+    {
+      u = (next(&x) >> 11) * (1.0/9007199254740992.0);
+      l = 0; r = pages-1;
+      while (l < r)
+      {
+        m = (l+r)/2;
+        if (cdf[m] < u) l = m+1; else r = m;
+      }
+      p = perm[l]*PAGE + next(&x) % PAGE;
+      J->pos[k] = A->r + (p < span ? p : next(&x) % span);
+    }
+    else if (!strcmp(workloads[J->kind],"seq"))
+    {
+      if (k == 0) J->pos[k] = A->r + next(&x) % span;
+      else if (J->pos[k-1]+2*J->len <= A->n) J->pos[k] = J->pos[k-1]+J->len;
+      else J->pos[k] = A->r; // wrap around
+    }
+    else J->pos[k] = A->r + next(&x) % span;
+  }
+}
+
+static void *run (void *arg)
+{
+  job *J = (job*)arg;
+  byte *buf = myalloc(J->len);
+  uint64_t k,t;
+  for (k=0;k<J->q;k++)
+  {
+    t = ns();
+    if (J->len == 1) buf[0] = arcAccess(J->A,J->pos[k]);
+    else arcExtract(J->A,J->pos[k],J->len,buf);
+    J->lat[k] = ns()-t;
+  }
+  myfree(buf);
+  return NULL;
+}
+
+static int byValue (const void *a, const void *b)
+{
+  const uint64_t *x = a, *y = b;
+  return *x < *y ? -1 : *x > *y;
+}
+
+// sorts lat[0..m-1] and prints its percentiles in us
+static void percentiles (uint64_t *lat, uint64_t m)
+{
+  double p[] = { 0.5, 0.99, 0.999 };
+  uint k;
+  qsort(lat,m,sizeof(uint64_t),byValue);
+  for (k=0;k<3;k++)
+    printf("  %10.3f",lat[min(m-1,(uint64_t)(p[k]*m))]/1000.0);
+  printf("  %10.3f\n",lat[m-1]/1000.0);
+}
+
+void main (int argc, char **argv)
+{
+  archive A;
+  depthseq D;
+  job *J;
+  pthread_t *th;
+  char *opt,*dfile,*ref;
+  uint64_t threads = 1,queries = 0,len = 0,seed = 1;
+  double s = 1.0,*cdf = NULL,sum;
+  uint64_t *perm = NULL,pages = 0,t,k,j,m,d,nd,total,t0,wall;
+  uint64_t *lat,*cnt;
+  int kind;
+  FILE *f;
+
+  if ((opt = argOption(&argc,argv,"--threads")) != NULL) threads = atol(opt);
+  if ((opt = argOption(&argc,argv,"--queries")) != NULL) queries = atol(opt);
+  if ((opt = argOption(&argc,argv,"--len")) != NULL) len = atol(opt);
+  if ((opt = argOption(&argc,argv,"--zipf")) != NULL) s = atof(opt);
+  if ((opt = argOption(&argc,argv,"--seed")) != NULL) seed = atol(opt);
+  dfile = argOption(&argc,argv,"--depths");
+  ref = argOption(&argc,argv,"--ref");
+
+  for (kind=0;(argc == 3) && (kind<4);kind++)
+    if (!strcmp(argv[2],workloads[kind])) break;
+  if ((argc != 3) || (kind == 4))
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> char|substr|zipf|seq "
+    "[--threads <t>] [--queries <q>]\n"
+    "[--len <len>] [--zipf <s>] [--seed <x>] [--depths <depth_file>]\n"
+    "[--ref <reference>]\n"
+    "Runs <q> queries split among <t> threads (by default, 10^5 queries\n"
+    "or 10^6 bytes, whichever is fewer, and 1 thread), and\n"
+    "prints their throughput and latency percentiles, also by the chain\n"
+    "length of the positions accessed. Each query extracts <len> bytes\n"
+    "char:   at uniformly random positions, 1 byte by default\n"
+    "substr: at uniformly random positions, 64 bytes by default\n"
+    "zipf:   in %i-byte pages whose popularity follows a Zipf law of\n"
+    "        exponent <s> (1 by default), 1 byte by default\n"
+    "seq:    consecutive in each thread, 4096 bytes by default\n"
+    "The chain lengths are computed from the phrases unless given in\n"
+    "<depth_file>, as written with --depths by the variants\n"
+    "A relative parse needs its <reference>, and the queries are on its\n"
+    "target\n\n",
+    argv[0],PAGE);
+    exit(1);
+  }
+  if (len == 0) len = defaultLen[kind];
+  if (queries == 0) queries = max(1,min(100000,1000000/len));
+  if (threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+  if (queries < threads) queries = threads;
+
+  A = arcMap(argv[1]); // packed files are used in place
+  f = fopen(argv[1],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[1]);
+    exit(1);
+  }
+  if (A == NULL) A = arcLoad(f);
+  if (ref != NULL) arcSetReference(A,ref);
+  if (len > A->n-A->r) len = A->n-A->r;
+
+  // the depths, from the phrases if not given
+  if (dfile != NULL)
+  {
+    fclose(f);
+    f = fopen(dfile,"r");
+    if (f == NULL)
+    {
+      fprintf(stderr,"Cannot open %s\n",dfile);
+      exit(1);
+    }
+    D = depthLoad(f);
+    if (depthLength(D) != A->n)
+    {
+      fprintf(stderr,"Error: %s has %li positions, the parse has %li\n",
+              dfile,depthLength(D),A->n);
+      exit(1);
+    }
+  }
+  else
+  {
+    archive L = A;
+    uintData *U;
+    if (A->map != NULL) { rewind(f); L = arcLoad(f); }
+    U = arcDepths(L);
+    D = depthCreate(U,A->n,A->n);
+    myfree(U);
+    if (L != A) arcDestroy(L);
+  }
+  fclose(f);
+
+  fprintf(stderr,"n = %li, z = %li phrases%s, workload %s, %li bytes "
+          "per query, %li threads\n",A->n-A->r,A->z,
+          A->map != NULL ? ", mapped" : "",workloads[kind],len,threads);
+
+  // the zipf distribution over the pages, scattered at random
+  if (kind == 2)
+  {
+    uint64_t x = seed ? seed : 1;
+    pages = (A->n-A->r+PAGE-1)/PAGE;
+    cdf = myalloc(pages*sizeof(double));
+    perm = myalloc(pages*sizeof(uint64_t));
+    sum = 0;
+    for (k=0;k<pages;k++) { sum += 1/pow(k+1,s); cdf[k] = sum; }
+    for (k=0;k<pages;k++) { cdf[k] /= sum; perm[k] = k; }
+    for (k=pages-1;k>0;k--) // Fisher-Yates
+    {
+      j = next(&x) % (k+1);
+      t = perm[k]; perm[k] = perm[j]; perm[j] = t;
+    }
+  }
+
+  J = myalloc(threads*sizeof(job));
+  th = myalloc(threads*sizeof(pthread_t));
+  for (t=0;t<threads;t++)
+  {
+    J[t].A = A; J[t].kind = kind; J[t].len = len;
+    J[t].q = queries/threads + (t < queries%threads);
+    J[t].pos = myalloc(J[t].q*sizeof(uint64_t));
+    J[t].lat = myalloc(J[t].q*sizeof(uint64_t));
+    draw(&J[t],seed+t*0x9E3779B97F4A7C15ULL,cdf,perm,pages);
+  }
+
+  t0 = ns();
+  for (t=0;t<threads;t++) pthread_create(&th[t],NULL,run,&J[t]);
+  for (t=0;t<threads;t++) pthread_join(th[t],NULL);
+  wall = ns()-t0;
+
+  // the depth of each query is the largest one among its positions
+  nd = 0;
+  for (t=0;t<threads;t++)
+    for (k=0;k<J[t].q;k++)
+    {
+      J[t].pos[k] = depthMax(D,J[t].pos[k],J[t].pos[k]+len-1);
+      if (J[t].pos[k]+1 > nd) nd = J[t].pos[k]+1;
+    }
+
+  printf("%li queries in %.3f s: %.0f queries/s, %.2f MB/s\n",queries,
+         wall/1e9,queries/(wall/1e9),queries*len/(wall/1e9)/1048576);
+  printf("latency in us  %10s  %10s  %10s  %10s\n","p50","p99","p999","max");
+  lat = myalloc(queries*sizeof(uint64_t));
+  m = 0;
+  for (t=0;t<threads;t++)
+    for (k=0;k<J[t].q;k++) lat[m++] = J[t].lat[k];
+  printf("all%11s","");
+  percentiles(lat,m);
+
+  // by depth, counting sort
+  cnt = myalloc((nd+1)*sizeof(uint64_t));
+  for (d=0;d<=nd;d++) cnt[d] = 0;
+  for (t=0;t<threads;t++)
+    for (k=0;k<J[t].q;k++) cnt[J[t].pos[k]+1]++;
+  for (d=1;d<=nd;d++) cnt[d] += cnt[d-1];
+  for (t=0;t<threads;t++)
+    for (k=0;k<J[t].q;k++) lat[cnt[J[t].pos[k]]++] = J[t].lat[k];
+  for (d=0,total=0;d<nd;d++)
+  {
+    m = cnt[d]-total;
+    if (m == 0) continue;
+    printf("depth %-4li %3.0f%%",d,100.0*m/queries);
+    percentiles(lat+total,m);
+    total = cnt[d];
+  }
+
+  for (t=0;t<threads;t++) { myfree(J[t].pos); myfree(J[t].lat); }
+  myfree(J); myfree(th); myfree(lat); myfree(cnt);
+  if (cdf != NULL) { myfree(cdf); myfree(perm); }
+  depthDestroy(D);
+  arcDestroy(A);
+  exit(0);
+}
@@ -0,0 +1,265 @@
+#include <string.h>
+#include <time.h>
+
+// measures the core succinct primitives (rank and access on bitvectors,
+// tracking on wavelet matrices, and the two segment structures) under
+// random and sequential access, at doubling sizes and for several
+// bitrank parameters k, in ns per operation and distinct cache lines
+// touched per operation
+
+#include "segm.h"
+#include "memplan.h"
+
+	// segm_greedier.c is compiled for this bench with its names prefixed
+	// by flat (see the Makefile), so that both segment structures can be
+	// linked together
+#undef INCLUDEDsegm
+#define s_segm s_flatsegm
+#define segmCreate flatSegmCreate
+#define segmDestroy flatSegmDestroy
+#define segmSpace flatSegmSpace
+#define segmSpaceFor flatSegmSpaceFor
+#define segmValue flatSegmValue
+#define cappedMax flatCappedMax
+#define segmUpdate flatSegmUpdate
+#include "segm_greedier.h"
+#undef s_segm
+#undef segmCreate
+#undef segmDestroy
+#undef segmSpace
+#undef segmSpaceFor
+#undef segmValue
+#undef cappedMax
+#undef segmUpdate
+
+#define MINTIME 0.25 // seconds measured at most per primitive and pattern
+#define LINEOPS 1000 // operations whose cache lines are counted
+#define LINEBITS 18 // log2 of the slots of the set of lines of an operation
+#define LINEHASH (1<<LINEBITS)
+
+// the primitives, in the order they are measured for each structure
+enum { RANK, ACCESS, TRACKDOWN, TRACKLEFT, TRACKRIGHT,
+       UPDATE, VALUE, CAPPED, FUPDATE, FVALUE, FCAPPED, PRIMS };
+
+char *primName[PRIMS] = { "bitsRank", "bitsAccess", "wmTrackDown",
+  "wmTrackLeftRange", "wmTrackRightRange", "segmUpdate", "segmValue",
+  "cappedMax", "segmUpdate", "segmValue", "cappedMax" };
+
+char *structName[PRIMS] = { "bitvector", "bitvector", "wmatrix", "wmatrix",
+  "wmatrix", "segm", "segm", "segm", "segm_greedier", "segm_greedier",
+  "segm_greedier" };
+
+typedef struct { uint64_t i,j; uint l; uintData v; } query;
+
+bitvector Bv; // the structures under test
+wmatrix M;
+segm S;
+Tsegm F;
+uintData *Map,*D,*FD; // as in greedy_BATLZ, and the data of F
+uint64_t n,fn; // the values of M and S, and of F
+query *Q; // the operations, drawn before timing
+uint64_t q; // their number
+volatile uint64_t sink; // their results, so that they are not optimized out
+
+	// the distinct cache lines touched by the current operation
+
+int lineTrace = 0;
+static uint64_t lineSet[LINEHASH],lineStamp[LINEHASH],stamp,lines;
+
+void lineTouch (void *p)
+{
+  uint64_t l = ((uint64_t)p) >> 6;
+  uint64_t h = (l*0x9E3779B97F4A7C15ULL) >> (64-LINEBITS);
+  while (lineStamp[h] == stamp)
+  {
+    if (lineSet[h] == l) return;
+    h = (h+1) % LINEHASH;
+  }
+  if (lines == LINEHASH/2) return; // saturated, not expected
+  lineStamp[h] = stamp; lineSet[h] = l; lines++;
+}
+
+static double now (void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// xorshift64*
+static uint64_t rnd (uint64_t *x)
+{
+  *x ^= *x >> 12; *x ^= *x << 25; *x ^= *x >> 27;
+  return *x * 0x2545F4914F6CDD1DULL;
+}
+
+// runs operation k of primitive p
+static inline uint64_t run (int p, uint64_t k)
+{
+  query *o = Q+k;
+  int64_t i = o->i, j = o->j;
+  switch (p)
+  {
+    case RANK: return bitsRank(Bv,o->i);
+    case ACCESS: return bitsAccess(Bv,o->i);
+    case TRACKDOWN: return wmTrackDown(M,o->l,o->i);
+    case TRACKLEFT: wmTrackLeftRange(M,o->l,&i,&j); return i+j;
+    case TRACKRIGHT: wmTrackRightRange(M,o->l,&i,&j); return i+j;
+    case UPDATE: D[o->j] = o->v; segmUpdate(S,o->i,o->v); return 0;
+    case VALUE: return segmValue(S,o->i,o->l);
+    case CAPPED: return cappedMax(S,o->l,o->i,o->j,n+1);
+    case FUPDATE: FD[o->i] = o->v; flatSegmUpdate(F,o->i,o->v); return 0;
+    case FVALUE: return flatSegmValue(F,o->i);
+    case FCAPPED: return flatCappedMax(F,o->i,o->j,fn+1);
+  }
+  return 0;
+}
+
+// draws the operations of primitive p, at random positions or at
+// consecutive ones (seq), in the range of its structure
+static void draw (int p, int seq, uint64_t seed)
+{
+  uint64_t k,m,x = seed,h,nl;
+  uint lev;
+  switch (p) // the positions
+  {
+    case RANK: case ACCESS: m = Bv->size; break;
+    case FUPDATE: case FVALUE: case FCAPPED: m = fn; break;
+    default: m = n;
+  }
+  nl = (p >= TRACKDOWN) && (p < FUPDATE) ? M->nlevels : 1;
+  for (k=0;k<q;k++)
+  {
+    query *o = Q+k;
+    o->i = seq ? k % m : rnd(&x) % m;
+    o->l = seq ? (k*nl)/q : rnd(&x) % nl; // sweeping the levels if seq
+    o->j = o->i + rnd(&x) % (m-o->i); // a range i..j
+    o->v = rnd(&x) % m;
+    if (p == UPDATE) o->j = wmAccess(M,o->i); // the data position
+    if ((p == VALUE) || (p == FVALUE)) // a node above leaf i, of level l
+    {
+      lev = p == VALUE ? S->nlevels : F->nlevels;
+      h = rnd(&x) % (lev+1);
+      o->i = (((p == VALUE ? S->first : F->first)+o->i+1) >> h) - 1;
+    }
+  }
+}
+
+// measures primitive p with the operations drawn, reporting ns and cache
+// lines per operation
+static void measure (int p, char *pattern, uint64_t size, uint k)
+{
+  uint64_t i,r,cl = 0,nl = min(q,LINEOPS);
+  char ks[16];
+  double t;
+  lineTrace = 1; // the lines, on the first operations
+  for (i=0;i<nl;i++)
+  {
+    stamp++; lines = 0;
+    sink += run(p,i);
+    cl += lines;
+  }
+  lineTrace = 0;
+  t = now(); // then the time, on up to MINTIME seconds
+  for (i=nl,r=0;i<q;i++,r++)
+  {
+    sink += run(p,i);
+    if (((r & 1023) == 1023) && (now()-t > MINTIME)) { r++; break; }
+  }
+  t = now()-t;
+  if (k) sprintf(ks,"%i",k); else strcpy(ks,"-"); // k does not apply
+  printf("%12li %3s %-14s %-18s %-10s %10.1f %8.2f\n",size,ks,
+         structName[p],primName[p],pattern,r ? t*1e9/r : 0.0,(double)cl/nl);
+}
+
+// measures the primitives of one structure, under both patterns
+static void patterns (int from, int to, uint64_t size, uint k)
+{
+  int p,seq;
+  for (p=from;p<to;p++)
+    for (seq=0;seq<2;seq++)
+    {
+      draw(p,seq,size*31+k*7+p+1);
+      measure(p,seq ? "sequential" : "random",size,k);
+    }
+}
+
+void main (int argc, char **argv)
+{
+  uint64_t minSize = 16*1024,maxSize = 64*1024*1024,size,i,j,t,x = 1;
+  uint ks[16],nk = 0,c;
+  char *opt,*kl,kdef[] = "4";
+
+  q = 1000000;
+  if ((opt = argOption(&argc,argv,"--min-size")) != NULL)
+    minSize = memParse(opt);
+  if ((opt = argOption(&argc,argv,"--max-size")) != NULL)
+    maxSize = memParse(opt);
+  if ((opt = argOption(&argc,argv,"--ops")) != NULL) q = atol(opt);
+  kl = argOption(&argc,argv,"--k");
+  if (kl == NULL) kl = kdef;
+  for (opt=strtok(kl,",");(opt != NULL) && (nk < 16);opt=strtok(NULL,","))
+    if (atoi(opt) > 0) ks[nk++] = atoi(opt);
+
+  if ((argc != 1) || (nk == 0) || (q < LINEOPS) || (minSize > maxSize))
+  {
+    fprintf(stderr,"Usage: %s [--min-size <size>] [--max-size <size>] "
+    "[--ops <q>] [--k <k1,k2,...>]\n"
+    "Measures the primitives on structures of <min-size> (16K by "
+    "default),\n"
+    "4 times that, and so on up to <max-size> (64M by default; sizes are\n"
+    "like 512K or 4G, no suffix is MB), and for each bitrank parameter k\n"
+    "(4 by default). Each primitive runs up to <q> operations (10^6 by\n"
+    "default, at least %i) or %.2f seconds, and the cache lines are\n"
+    "counted on the first %i\n\n",argv[0],LINEOPS,MINTIME,LINEOPS);
+    exit(1);
+  }
+
+  Q = myalloc(q*sizeof(query));
+  printf("%12s %3s %-14s %-18s %-10s %10s %8s\n","size","k","structure",
+         "primitive","pattern","ns/op","lines/op");
+  for (size=minSize;size<=maxSize;size*=4)
+  {
+    for (c=0;c<nk;c++)
+    {
+	// a bitvector of size bytes, of random bits
+      Bv = bitsCreate(size*8);
+      for (i=0;i<size/8;i++) bitsData(Bv)[i] = rnd(&x);
+      bitsRankPreprocess(Bv,ks[c]);
+      patterns(RANK,ACCESS+1,size,ks[c]);
+      bitsDestroy(Bv);
+
+	// a wavelet matrix of about size bytes, over a random permutation
+	// as that of the SA in greedy_BATLZ, and its segm
+      for (n=2;(n*2)*numbits(n*2) <= size*8;n*=2);
+      Map = myalloc(n*sizeof(uintData));
+      for (i=0;i<n;i++) Map[i] = i;
+      for (i=n-1;i>0;i--)
+      {
+        j = rnd(&x) % (i+1);
+        t = Map[i]; Map[i] = Map[j]; Map[j] = t;
+      }
+      M = wmCreate(n,numbits(n),Map,ks[c]); // as greedy_BATLZ, scrambles Map
+      patterns(TRACKDOWN,TRACKRIGHT+1,size,ks[c]);
+      D = myalloc(n*sizeof(uintData));
+      for (i=0;i<n;i++) D[i] = n;
+      S = segmCreate(M,D,Map);
+      patterns(UPDATE,CAPPED+1,size,ks[c]);
+      segmDestroy(S); wmDestroy(M);
+      myfree(D); myfree(Map);
+    }
+
+	// a segm_greedier of about size bytes, 2 bits of directions and 32
+	// of data per value, which does not depend on k
+    fn = max(size*8/34,2);
+    FD = myalloc(fn*sizeof(uintData));
+    for (i=0;i<fn;i++) FD[i] = fn;
+    F = flatSegmCreate(FD,fn);
+    patterns(FUPDATE,FCAPPED+1,size,0);
+    flatSegmDestroy(F);
+    myfree(FD);
+    fflush(stdout);
+  }
+  myfree(Q);
+  exit(0);
+}
@@ -0,0 +1,596 @@
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+
+	// parse that aims at few bits under the cost of the packed format:
+	// each phrase costs gamma(len+1) + delta(distance) + 8 bits. The text
+	// is parsed in windows of B positions, each by a shortest path over
+	// some of the phrases that copy from before the position. For each
+	// position and distance class (the positions whose distance has
+	// the same delta length), the longest admissible phrase is found
+	// with the same wavelet matrix and segments of greedy_BATLZ among
+	// the sources that end before the window, whose chain lengths are
+	// known, and among a few sources closer than that, with the chain
+	// lengths along the shortest path to the position. The phrases left
+	// out, and the chain lengths a window leaves to the next, make it a
+	// heuristic: it is not optimal, even within a window, and a larger
+	// window can give more bits
+
+#include "segm.h"
+#include "verify.h"
+#include "depth.h"
+#include "progress.h"
+
+#define K 4  // space/time tradeoff for bitmaps
+
+#define BLOCK 4096 // default window length
+
+uint MAX;    // max number of copies allowed
+
+byte *T; // null-terminated text
+
+uint64_t n; // text length
+
+uintData *SA, *ISA, *Map; // SA and its inverse, created from outside
+		// Map undoes the scrambling of the wm
+
+uintData *D; // distance to next unusable pos, 0 for unusable pos
+
+uintData *U; // number of uses (length of chain)
+
+wmatrix M; // wmatrix of SA
+
+segm S; // segment structures, one per wm level
+
+uint64_t s; // start of the current window
+
+uint64_t lo0; // sources in lo0..s-1 may also reach into the window
+
+	// shortest path of the current window
+typedef struct
+{
+  uint64_t cost;   // bits to reach this position from the window start
+  uint64_t start;  // start of the last phrase of the path
+  uint64_t source; // its source, and its length
+  uint64_t len;
+} step;
+
+step *P;
+
+	// chain lengths along the shortest path to the position being
+	// relaxed: Wd[x-s] for the positions x of the window before it,
+	// and Cnt[x-lo0] counts the unusable positions in lo0..x-1. Qn[0..Qm-1]
+	// are the ends of the phrases of that path, s first, marked in inQ
+uintData *Wd;
+uint64_t *Cnt;
+uint64_t *Qn,*Tmp,Qm;
+byte *inQ;
+
+#define CANDS 32 // sources checked in and near the window
+
+uint64_t NL[64],NS[64]; // the phrases from them, by distance class
+
+// initializes all the structures, given SA and ISA of length n
+// and maximum allowed chain length
+void initialize (uint64_t n, uint64_t maxChain)
+{
+  uint64_t i;
+  uint depth;
+	// create the data D and U
+  D = myalloc (n*sizeof(uintData));
+  for (i=0;i<n;i++) D[i] = n; // maximum bound for all positions
+  U = myalloc (n*sizeof(uintData));
+	// create wavelet matrix on the SA
+  depth = numbits(n);
+
+  fprintf(stderr,"Creating wavelet matrix... "); fflush(stderr);
+
+  M = wmCreate (n,depth,SA,K);
+
+  fprintf(stderr,"done\n");
+
+  Map = SA; // SA was scrambled by wmCreate
+
+  // create the segments, one per wmatrix level
+
+  fprintf(stderr,"Creating chain structures... "); fflush(stderr);
+
+  S = segmCreate(M,D,Map);
+
+  fprintf(stderr,"done\n");
+
+	// stores the maximum number of copies
+  if (maxChain == 0)
+  {
+    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
+    exit(1);
+  }
+  MAX = maxChain;
+}
+
+#define nomax ((uint64_t)~0)
+
+// bits of gamma(x) and delta(x), x >= 1
+static uint64_t gammaBits (uint64_t x)
+
+{ return 2*numbits(x)-1;
+}
+
+static uint64_t deltaBits (uint64_t x)
+
+{ return gammaBits(numbits(x)) + numbits(x)-1;
+}
+
+// bits of phrase (source,len,char) starting at i
+static uint64_t phraseBits (uint64_t i, uint64_t source, uint64_t len)
+
+{ if (len == 0) return gammaBits(1) + 8;
+  return gammaBits(len+1) + deltaBits(i-source) + 8;
+}
+
+// finds, among SA[sp..ep], a source in text positions lo..hi with
+// D >= val, visiting the wm nodes of that range of values as in a
+// range search, starting at level lev with values a... Leaves in
+// *maxv the one with maximum D
+static int window (segm S, uint lev, uint64_t a, int64_t sp, int64_t ep,
+		   uint64_t lo, uint64_t hi, uintData val, uint64_t *maxv)
+
+{ uint64_t span = ((uint64_t)1) << (S->nlevels-lev);
+  uint64_t v;
+  int64_t nsp,nep;
+
+  if ((sp > ep) || (a > hi) || (a+span-1 < lo)) return 0;
+  if ((lo <= a) && (a+span-1 <= hi)) // the node is inside
+  {
+    if (lev == S->nlevels) v = Map[sp];
+    else v = Map[cappedMax (S,lev,sp,ep,val)];
+    if ((*maxv == nomax) || (D[v] > D[*maxv])) *maxv = v;
+    return D[v] >= val;
+  }
+  nsp = sp; nep = ep;
+  wmTrackLeftRange (S->wm,lev,&nsp,&nep);
+  if (window (S,lev+1,a,nsp,nep,lo,hi,val,maxv)) return 1;
+  wmTrackRightRange (S->wm,lev,&sp,&ep);
+  return window (S,lev+1,a+span/2,sp,ep,lo,hi,val,maxv);
+}
+
+// a source in lo..hi among SA[sp..ep] that can be copied for len chars
+// without reaching the window, or nomax
+static uint64_t admissible (int64_t sp, int64_t ep, uint64_t lo, uint64_t hi,
+			    uint64_t len)
+
+{ uint64_t maxv = nomax;
+  if (len > s) return nomax;
+  if (hi > s-len) hi = s-len; // the copy must end before the window
+  if (lo > hi) return nomax;
+  if (!window (S,0,0,sp,ep,lo,hi,len,&maxv)) return nomax;
+  return maxv;
+}
+
+// SA[sp..ep] corresponds to T[i..i+len-1], extend by 1 char and
+// descend the whole stree edge
+uint64_t restrictRange (int64_t sp, int64_t ep, uint64_t i, uint64_t len,
+		   int64_t *nsp, int64_t *nep)
+{
+  int64_t p,m,om;
+  byte c,c0 = T[i+len];
+  while (sp <= ep)
+  {
+    m = (sp+ep)/2;
+    c = T[SA[m]+len];
+    if (c == c0) break;
+    if (c < c0) sp = m+1;
+    else ep = m-1;
+  }
+  if (sp > ep)
+  {
+    *nsp = sp; *nep = ep; return len;
+  }
+  // char found at m
+  p = om = m;
+  *nsp = sp;
+  while (*nsp < p)
+  {
+    m = (*nsp+p)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nsp = m+1;
+  }
+  p = om;
+  *nep = ep;
+  while (*nep > p)
+  {
+    m = (*nep+p+1)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nep = m-1;
+  }
+  if (*nsp == *nep)
+    return n-SA[*nsp]; // stree leaf
+
+  while (T[SA[*nsp]+len] == T[SA[*nep]+len]) len++;
+
+  return len;
+}
+
+	// suffix tree path of T[i..]: SA range of the edge k is
+	// SA[Esp[k]..Eep[k]], of the lengths Elen[k-1]+1..Elen[k]
+int64_t *Esp,*Eep;
+uint64_t *Elen;
+uint64_t Edges,Emax;
+
+// computes the path of T[i..] up to the leaf of i
+void path (uint64_t i)
+{
+  int64_t sp,ep,nsp,nep;
+  uint64_t len = 0;
+
+  sp = 0; ep = n-1; Edges = 0;
+  while (1)
+  {
+    len = restrictRange (sp,ep,i,len,&nsp,&nep);
+    if (nsp >= nep) break; // only T[i..] is left
+    if (Edges == Emax)
+    {
+      Emax *= 2;
+      Esp = myrealloc (Esp,Emax*sizeof(int64_t));
+      Eep = myrealloc (Eep,Emax*sizeof(int64_t));
+      Elen = myrealloc (Elen,Emax*sizeof(uint64_t));
+    }
+    Esp[Edges] = sp = nsp; Eep[Edges] = ep = nep; Elen[Edges++] = len;
+  }
+}
+
+// longest admissible phrase T[i..] with source in lo..hi, on the path
+uint64_t longest (uint64_t lo, uint64_t hi, uint64_t *source)
+{
+  uint64_t k,v,a,b,t;
+
+  a = 0;
+  for (k=0;k<Edges;k++)
+  {
+    v = admissible (Esp[k],Eep[k],lo,hi,Elen[k]);
+    if (v == nomax) break;
+    *source = v; a = Elen[k]; // the whole edge
+  }
+  if (k == Edges) return a;
+    // the lengths a+1..Elen[k]-1 share the range, binary search on them
+  b = Elen[k]-1;
+  while (a < b)
+  {
+    t = (a+b+1)/2;
+    v = admissible (Esp[k],Eep[k],lo,hi,t);
+    if (v != nomax) { *source = v; a = t; }
+    else b = t-1;
+  }
+  return a;
+}
+
+// chain length of position x < i along the shortest path to i
+static uint64_t depthAt (uint64_t x)
+
+{ return x < s ? U[x] : Wd[x-s];
+}
+
+// makes Wd and Cnt those of the shortest path to i, recomputing them
+// only after the last phrase end it shares with the previous path
+static void setPath (uint64_t i)
+{
+  uint64_t j,k,m,t,x,src;
+
+  m = 0;
+  for (j=i;!inQ[j-s];j=P[j-s].start) Tmp[m++] = j;
+  while (Qn[Qm-1] != j) inQ[Qn[--Qm]-s] = 0;
+  while (m--)
+  { // phrase T[k..j-1], copied from src
+    j = Tmp[m]; k = P[j-s].start; src = P[j-s].source;
+    for (t=0;t<P[j-s].len;t++)
+      Wd[k+t-s] = depthAt(src+t%(k-src))+1;
+    Wd[j-1-s] = 0; // explicit char
+    for (x=k;x<j;x++) Cnt[x+1-lo0] = Cnt[x-lo0] + (Wd[x-s] >= MAX);
+    inQ[j-s] = 1; Qn[Qm++] = j;
+  }
+}
+
+// how many chars, up to len, can be copied from src to i along the
+// shortest path to i, a self-overlapping copy repeating T[src..i-1]
+static uint64_t usable (uint64_t i, uint64_t src, uint64_t len)
+
+{ uint64_t a,b,t;
+  if (Cnt[i-lo0] == Cnt[src-lo0]) return len;
+  a = src; b = i-1; // the first unusable position
+  while (a < b)
+  {
+    t = (a+b)/2;
+    if (Cnt[t+1-lo0] > Cnt[src-lo0]) b = t; else a = t+1;
+  }
+  return min(a-src,len);
+}
+
+// adds to C[*m..cap-1] the sources in lo..hi among SA[sp..ep], the
+// closest first, starting at level lev with values a...
+static void report (uint lev, uint64_t a, int64_t sp, int64_t ep,
+		    uint64_t lo, uint64_t hi, uint64_t *C, uint *m, uint cap)
+
+{ uint64_t span = ((uint64_t)1) << (S->nlevels-lev);
+  int64_t nsp,nep;
+
+  if ((*m == cap) || (sp > ep) || (a > hi) || (a+span-1 < lo)) return;
+  if (lev == S->nlevels) { C[(*m)++] = Map[sp]; return; }
+  nsp = sp; nep = ep;
+  wmTrackRightRange (S->wm,lev,&nsp,&nep);
+  report (lev+1,a+span/2,nsp,nep,lo,hi,C,m,cap);
+  wmTrackLeftRange (S->wm,lev,&sp,&ep);
+  report (lev+1,a,sp,ep,lo,hi,C,m,cap);
+}
+
+// longest phrases T[i..] with source in lo0..i-1 along the shortest path
+// to i, NL[c] copying NS[c] from the distance class c, checking up to
+// CANDS sources from the deepest edge of the path up, the closest first.
+// Those of edge k that are not in edge k+1 match Elen[k] chars
+void nearby (uint64_t i)
+{
+  uint64_t C[CANDS],len;
+  uint m,h,c,d;
+  int64_t k;
+
+  for (d=0;d<64;d++) NL[d] = 0;
+  m = 0;
+  for (k=Edges-1;(k >= 0) && (m < CANDS);k--)
+  {
+    h = m;
+    if (k == Edges-1) report (0,0,Esp[k],Eep[k],lo0,i-1,C,&m,CANDS);
+    else
+    {
+      report (0,0,Eep[k+1]+1,Eep[k],lo0,i-1,C,&m,CANDS);
+      report (0,0,Esp[k],Esp[k+1]-1,lo0,i-1,C,&m,CANDS);
+    }
+    for (c=h;c<m;c++)
+    {
+      len = usable (i,C[c],Elen[k]);
+      d = numbits(i-C[c])-1;
+      if (len > NL[d]) { NL[d] = len; NS[d] = C[c]; }
+    }
+  }
+}
+
+// relaxes the path to i+len+1 with phrase (source,len) from i
+static void relax (uint64_t i, uint64_t source, uint64_t len)
+{
+  uint64_t c = P[i-s].cost + phraseBits(i,source,len);
+  step *p = P + (i+len+1-s);
+  if (c < p->cost)
+  {
+    p->cost = c; p->start = i; p->source = source; p->len = len;
+  }
+}
+
+// relaxes all the paths from i in the window that ends at e
+void relaxFrom (uint64_t i, uint64_t e)
+{
+  uint64_t c,lo,hi,len,best,top,source,t;
+
+  relax (i,0,0); // explicit char
+  path (i);
+  setPath (i);
+  nearby (i);
+  top = longest (0,i-1,&source); // no class gives more
+  for (c=0;c<64;c++) if (NL[c] > top) top = NL[c];
+  best = 0;
+  for (c=0;(best < top) && (((uint64_t)1<<c) <= i);c++)
+  { // distances 2^c..2^(c+1)-1
+    hi = i - ((uint64_t)1<<c);
+    lo = i >= ((uint64_t)2<<c)-1 ? i-((uint64_t)2<<c)+1 : 0;
+    len = lo < s ? longest (lo,hi,&source) : 0;
+    if (NL[c] > len) { len = NL[c]; source = NS[c]; }
+    if (len <= best) continue; // a closer source is as long
+    best = len;
+    if (i+len >= e) len = e-i-1; // the phrase ends at the window end
+    for (t=2;t-2 < len;t<<=1) // longest lengths with each gamma length
+      if (t-2 > 0) relax (i,source,t-2);
+    relax (i,source,len);
+  }
+}
+
+// phrase T[i..j] = T[pi..] and T[j] is explicit
+// update D and U. last unusable position was last (can be -1 at first)
+// returns new value of last
+int64_t copyPhrase (uint64_t i, uint64_t j, uint64_t pi, int64_t last)
+{
+  int64_t k,s;
+  s = pi;
+  for (k = i; k < j; k++)
+	{
+    U[k] = U[s]+1;
+	  s++; if (s == i) s = pi; // for self-overlapping phrases
+	  if (U[k] == MAX) // new unusable position
+	     while (last < k)
+        {
+          last++;
+          D[last] = k-last;
+          segmUpdate(S,ISA[last],D[last]);
+        }
+	}
+
+  U[j] = 0; // explicit char
+
+  return last;
+}
+
+
+bool file_exists (char *filename) {
+  struct stat   buffer;
+  return (stat (filename, &buffer) == 0);
+}
+
+void main (int argc, char **argv)
+{
+  uint64_t z,i,e,k,m,B,bits;
+  int64_t last = -1;
+  struct stat st;
+  FILE *f;
+  char fname[1024];
+  archive V = NULL; // phrases kept for --verify
+  char *depths; // file for --depths
+  char *win; // value of --window
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  progress Prog;
+  uint64_t *phr; // phrase ends of the shortest path of the window
+  char fnameSA[1024];
+
+  if (argFlag(&argc,argv,"--verify")) V = arcCreate();
+  depths = argOption(&argc,argv,"--depths");
+  win = argOption(&argc,argv,"--window");
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
+  B = win != NULL ? atol(win) : BLOCK;
+
+  if ((argc < 2) || (B == 0))
+  {
+    fprintf(stderr,"Usage: %s <filename> [<maxchain>] [--verify] "
+    "[--depths <file>] [--window <B>] [--progress <s>] [--status <file>]\n"
+    "[--status-socket <path>]\n"
+    "There must exist <filename>.sa as well\n"
+          "No maxchain uses infinity and yields the max chain\n"
+    "Heuristically reduces the bits of the packed format, parsing <B>\n"
+    "positions at a time (default %i) by a shortest path over the longest\n"
+    "phrase of each distance class, taken among the sources before the\n"
+    "window and %i closer ones. Not optimal: a larger <B> can give more bits\n"
+    "--verify checks the parse in memory after producing it\n"
+    "--depths writes the chain length of each position to <file>\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],BLOCK,CANDS,PROGEVERY);
+    exit(1);
+  }
+
+  fprintf(stderr,"Reading text and suffix array files... "); fflush(stderr);
+
+  strcpy (fname,argv[1]);
+  strcpy (fnameSA,argv[1]);
+  strcat(fnameSA,".sa");
+  stat(fname,&st);
+  n = st.st_size;
+  f = fopen(fname,"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  T = myalloc(n+1);
+  fread (T,1,n,f);
+  fclose(f);
+  T[n] = 0;
+
+  if (!file_exists(fnameSA))
+  {
+    fprintf(stderr,"File %s does not exist, creating it\n",fnameSA);
+    char cmdbuf[1024];
+    snprintf (cmdbuf, sizeof(cmdbuf), "./gensa %s %s", fname, fnameSA);
+    int ret = system(cmdbuf);
+    if (ret != 0)
+    {
+      fprintf(stderr,"Error creating %s\n",fnameSA);
+      exit(1);
+    }
+  }
+
+  strcat(fname,".sa");
+  f = fopen(fname,"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  SA = myalloc((n+1)*sizeof(uintData));
+  SA[0] = n; // simulate the final \0, kkp does not add it
+  fread (SA+1,sizeof(uintData),n,f);
+  fclose(f);
+  n++;
+
+  ISA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) ISA[SA[i]] = i;
+
+  fprintf(stderr,"done\n");
+
+  initialize(n,argc == 2 ? n : atoi(argv[2]));
+
+	// recover SA after wm construction, to save space
+  SA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) SA[ISA[i]] = i;
+
+  P = myalloc((B+1)*sizeof(step));
+  phr = myalloc(B*sizeof(uint64_t));
+  Wd = myalloc(B*sizeof(uintData));
+  Cnt = myalloc((2*B+1)*sizeof(uint64_t));
+  Qn = myalloc((B+1)*sizeof(uint64_t));
+  Tmp = myalloc((B+1)*sizeof(uint64_t));
+  inQ = myalloc(B+1);
+  memset (inQ,0,B+1);
+  Emax = 64;
+  Esp = myalloc(Emax*sizeof(int64_t));
+  Eep = myalloc(Emax*sizeof(int64_t));
+  Elen = myalloc(Emax*sizeof(uint64_t));
+
+	// parsing
+
+  fprintf(stderr,"Parsing starts, n = %li\n",n);
+
+	// 1st phrase hardcoded to avoid border cases
+
+  fprintf(stderr,"File %s, n = %li, parsed with maxchain = %i, window = %li\n\n", argv[1],n,MAX,B);
+  printf("n = %li\n", n);  // print n
+  printf("(0,0,%d)\n", T[0]);
+  if (V != NULL) arcAdd(V,0,0,T[0]);
+  copyPhrase (0,0,0,last);
+  s = 1; z = 1; bits = phraseBits(0,0,0);
+  Prog = progCreate(n,s,z,prog != NULL ? atof(prog) : PROGEVERY,status,sock);
+
+  while (s < n)
+  {
+    e = min(s+B,n);
+    P[0].cost = 0;
+    for (i=s+1;i<=e;i++) P[i-s].cost = nomax;
+	// the path to s, and the unusable positions before it
+    inQ[0] = 1; Qn[0] = s; Qm = 1;
+    lo0 = s - min(s,B); Cnt[0] = 0;
+    for (i=lo0;i<s;i++) Cnt[i+1-lo0] = Cnt[i-lo0] + (U[i] >= MAX);
+    for (i=s;i<e;i++) relaxFrom (i,e);
+    bits += P[e-s].cost;
+	// the path backwards, then its phrases forwards
+    m = 0;
+    for (i=e;i>s;i=P[i-s].start) phr[m++] = i;
+    while (m--)
+    {
+      k = P[phr[m]-s].start;
+      if (P[phr[m]-s].len == 0) printf("(0,0,%d)\n", T[k]);
+      else printf("(%li,%li,%d)\n", P[phr[m]-s].source, P[phr[m]-s].len,
+                  T[phr[m]-1]);
+      if (V != NULL) arcAdd(V,P[phr[m]-s].source,P[phr[m]-s].len,
+                            T[phr[m]-1]);
+      last = copyPhrase (k,phr[m]-1,P[phr[m]-s].source,last);
+      z++;
+    }
+    while (Qm) inQ[Qn[--Qm]-s] = 0;
+    s = e;
+    progSet(Prog,s,z);
+  }
+  progDestroy(Prog);
+  printf("\nz = %li phrases\n",z);
+  fprintf(stderr,"\n\nz = %li phrases, %li bits\n",z,bits);
+  if (argc == 2)
+  {
+    uint64_t u = 0;
+    for (i=0;i<n;i++) if (U[i] > u) u = U[i];
+    fprintf(stderr,"Maximum chain length = %li\n",u);
+  }
+  fprintf(stderr,"\n");
+  if (depths != NULL) depthStore(depths,U,n,MAX);
+  if ((V != NULL) && !verifyParse(V,T,n,MAX,0)) exit(1);
+  exit(0);
+}
@@ -129,6 +129,17 @@ uint64_t bitsSpace (bitvector B)
       return space;
     }
 
+	// gives the space of n bits preprocessed for rank with parameter k
+
+uint64_t bitsSpaceFor (uint64_t n, uint64_t k)
+
+    { uint64_t space = sizeof(struct s_bitvector)*8/w;
+      space += (n+w-1)/w;
+      space += ((n+k*w-1)/(k*w))/(w/w16);
+      space += (n+(1<<w16)-1)/(1<<w16);
+      return space;
+    }
+
         // gives bit data
 
 extern inline uint64_t *bitsData (bitvector B)
@@ -147,7 +158,8 @@ extern inline uint64_t bitsLength (bitvector B)
 
 extern inline void bitsWriteA (uint64_t *B, uint64_t i, uint v)
 
-    { if (v == 0) B[i/w] &= ~(((uint64_t)1) << (i%w));
+    { touch(&B[i/w]);
+      if (v == 0) B[i/w] &= ~(((uint64_t)1) << (i%w));
       else B[i/w] |= ((uint64_t)1) << (i%w);
     }
 
@@ -160,7 +172,8 @@ extern inline void bitsWrite (bitvector B, uint64_t i, uint v)
 
 extern inline uint bitsAccessA (uint64_t *B, uint64_t i)
 
-    { return (B[i/w] >> (i%w)) & 1;
+    { touch(&B[i/w]);
+      return (B[i/w] >> (i%w)) & 1;
     }
 
 extern inline uint bitsAccess (bitvector B, uint64_t i)
@@ -201,9 +214,11 @@ extern inline uint64_t bitsRank (bitvector B, uint64_t i)
     { uint64_t b,sb;
       uint64_t rank;
       sb = i/(B->k*w);
+      touch(&B->S[i>>w16]); touch(&B->B[sb]);
       rank = B->S[i>>w16] + B->B[sb];
       sb *= B->k;
-      for (b=sb;b<i/w;b++) rank += popcount(B->data[b]);
+      for (b=sb;b<i/w;b++) { touch(&B->data[b]); rank += popcount(B->data[b]); }
+      touch(&B->data[b]);
       return rank + popcount(B->data[b] & (((uint64_t)~0) >> (w-1-(i%w))));
     }
 
@@ -6,6 +6,18 @@
 
 #include "basics.h"
 
+	// in builds with COUNTLINES (only benchprimitives), the primitives
+	// report every word they read or write with touch, so that the
+	// distinct cache lines they use can be counted while lineTrace is
+	// set. Otherwise touch is empty
+#ifdef COUNTLINES
+extern int lineTrace;
+void lineTouch (void *p);
+#define touch(p) do { if (lineTrace) lineTouch(p); } while (0)
+#else
+#define touch(p)
+#endif
+
 typedef struct s_bitvector {
     uint64_t size; // number of bits
     uint64_t* data; // the bits
@@ -38,6 +50,10 @@ bitvector bitsLoad (FILE *file);
 	// gives space of bitvector in w-bit words
 uint64_t bitsSpace (bitvector B);
 
+	// gives the space bitsSpace would give for n bits preprocessed for
+	// rank with parameter k, before creating them
+uint64_t bitsSpaceFor (uint64_t n, uint64_t k);
+
 	// gives bit data
 extern inline uint64_t *bitsData (bitvector B);
 
@@ -0,0 +1,65 @@
+#include <string.h>
+
+// converts a compressed file between the format printed by the variants
+// and the packed one
+
+#include "archive.h"
+
+void main (int argc, char **argv)
+{
+  archive A;
+  uint64_t bytes,bphr = ARCBLOCK;
+  int starts;
+  FILE *f;
+
+  starts = argFlag(&argc,argv,"--starts");
+
+  if ((argc < 3) || (argc > 4) ||
+      (!strcmp(argv[1],"-d") && (argc != 3)))
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> <packed_file> "
+    "[<phrases_per_block>] [--starts]\n"
+    "       %s -d <packed_file>\n"
+    "Packs the phrases of <compressed_file> into <packed_file>, in blocks\n"
+    "of <phrases_per_block> phrases (%i by default) that are decoded\n"
+    "independently, and with --starts also the Elias-Fano set of phrase\n"
+    "starts. With -d, prints <packed_file> as the variants do\n\n",
+    argv[0],argv[0],ARCBLOCK);
+    exit(1);
+  }
+
+  f = fopen(argv[!strcmp(argv[1],"-d") ? 2 : 1],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[!strcmp(argv[1],"-d") ? 2 : 1]);
+    exit(1);
+  }
+  A = arcLoad(f);
+  fclose(f);
+
+  if (!strcmp(argv[1],"-d"))
+  {
+    arcPrint(A,stdout);
+    arcDestroy(A);
+    exit(0);
+  }
+
+  if (argc == 4) bphr = atol(argv[3]);
+  if (bphr == 0)
+  {
+    fprintf(stderr,"<phrases_per_block> must be positive\n");
+    exit(1);
+  }
+  f = fopen(argv[2],"w");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[2]);
+    exit(1);
+  }
+  bytes = arcSave(A,f,bphr,starts);
+  fclose(f);
+  fprintf(stderr,"n = %li, z = %li phrases, packed in %li bytes, "
+          "%.2f bits per phrase\n",A->n,A->z,bytes,bytes*8.0/A->z);
+  arcDestroy(A);
+  exit(0);
+}
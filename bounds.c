@@ -0,0 +1,152 @@
+
+	// supports a map of chain bounds that vary along the text
+
+#include <string.h>
+
+#include "bounds.h"
+
+typedef struct { uint64_t start,end; uint bound; } interval;
+
+static int byStart (const void *a, const void *b)
+
+   { const interval *x = a, *y = b;
+     return x->start < y->start ? -1 : x->start > y->start;
+   }
+
+static int byValue (const void *a, const void *b)
+
+   { const uint *x = a, *y = b;
+     return *x < *y ? -1 : *x > *y;
+   }
+
+	// reads the map of fname for a text of length n, where the positions
+	// not covered have bound dflt
+
+bounds boundsLoad (char *fname, uint64_t n, uint dflt)
+
+   { bounds B;
+     FILE *f;
+     char line[1024];
+     interval *I = NULL;
+     uint64_t m = 0,size = 0,k,p,line_no = 0;
+     uint64_t start,end;
+     uint bound,c;
+     f = fopen(fname,"r");
+     if (f == NULL)
+	{ fprintf(stderr,"Cannot open %s\n",fname);
+	  exit(1);
+	}
+     while (fgets(line,sizeof(line),f) != NULL)
+	{ line_no++;
+	  if ((line[0] == '#') || (strspn(line," \t\n") == strlen(line)))
+	     continue;
+	  if ((sscanf(line,"%li %li %u",&start,&end,&bound) != 3) ||
+	      (start > end) || (bound == 0))
+	     { fprintf(stderr,"Error: %s, line %li: expected start end "
+			      "maxchain, with start <= end and maxchain > 0\n",
+			      fname,line_no);
+	       exit(1);
+	     }
+	  if (end > n) end = n;
+	  if (start >= end) continue;
+	  if (m == size)
+	     { size = size ? 2*size : 16;
+	       I = myrealloc(I,size*sizeof(interval));
+	     }
+	  I[m].start = start; I[m].end = end; I[m].bound = bound; m++;
+	}
+     fclose(f);
+     qsort(I,m,sizeof(interval),byStart);
+     for (k=1;k<m;k++)
+	if (I[k].start < I[k-1].end)
+	   { fprintf(stderr,"Error: %s: intervals [%li,%li) and [%li,%li) "
+			    "overlap\n",fname,I[k-1].start,I[k-1].end,
+			    I[k].start,I[k].end);
+	     exit(1);
+	   }
+	// the intervals, with the gaps filled with dflt
+     B = myalloc(sizeof(struct s_bounds));
+     B->n = n;
+     B->start = myalloc((2*m+2)*sizeof(uint64_t));
+     B->bound = myalloc((2*m+1)*sizeof(uint));
+     B->m = 0; p = 0;
+     for (k=0;k<=m;k++)
+	{ end = k < m ? I[k].start : n;
+	  if (p < end)
+	     { B->start[B->m] = p; B->bound[B->m++] = dflt; }
+	  if (k < m)
+	     { B->start[B->m] = I[k].start; B->bound[B->m++] = I[k].bound;
+	       p = I[k].end;
+	     }
+	}
+     B->start[B->m] = n;
+     if (I != NULL) myfree(I);
+	// the distinct bounds
+     B->value = myalloc(B->m*sizeof(uint));
+     memcpy(B->value,B->bound,B->m*sizeof(uint));
+     qsort(B->value,B->m,sizeof(uint),byValue);
+     B->nb = 0;
+     for (k=0;k<B->m;k++)
+	if ((B->nb == 0) || (B->value[k] != B->value[B->nb-1]))
+	   B->value[B->nb++] = B->value[k];
+     B->cls = myalloc(B->m*sizeof(uint));
+     for (k=0;k<B->m;k++)
+	{ c = 0;
+	  while (B->value[c] != B->bound[k]) c++;
+	  B->cls[k] = c;
+	}
+     return B;
+   }
+
+	// destroys B
+
+void boundsDestroy (bounds B)
+
+   { myfree(B->start); myfree(B->bound); myfree(B->cls);
+     myfree(B->value);
+     myfree(B);
+   }
+
+	// gives the interval that contains text position i
+
+uint64_t boundsFind (bounds B, uint64_t i)
+
+   { uint64_t l = 0, r = B->m-1, k;
+     while (l < r)
+	{ k = (l+r+1)/2;
+	  if (B->start[k] <= i) l = k; else r = k-1;
+	}
+     return l;
+   }
+
+	// gives the bound of text position i
+
+uint boundsAt (bounds B, uint64_t i)
+
+   { return B->bound[boundsFind(B,i)];
+   }
+
+	// gives the largest bound
+
+uint boundsMax (bounds B)
+
+   { return B->value[B->nb-1];
+   }
+
+	// checks that U[0..n-1] respects the bounds
+
+int boundsCheck (bounds B, uintData *U)
+
+   { uint64_t k,i;
+     for (k=0;k<B->m;k++)
+	for (i=B->start[k];i<B->start[k+1];i++)
+	    if (U[i] > B->bound[k])
+	       { fprintf(stderr,"Bounds... wrong: position %li has chain "
+				"length %u, above its bound %u\n",
+				i,U[i],B->bound[k]);
+		 return 0;
+	       }
+     fprintf(stderr,"Bounds... ok, %li intervals, %u distinct bounds\n",
+	     B->m,B->nb);
+     return 1;
+   }
@@ -0,0 +1,47 @@
+
+#ifndef INCLUDEDbounds
+#define INCLUDEDbounds
+
+	// supports a map of chain bounds that vary along the text, read from
+	// a file of lines "start end maxchain", each bounding the chains of
+	// the text positions start..end-1. Lines starting with # are
+	// comments. The positions not covered use a default bound
+
+	// the map is kept as the sorted intervals that cover the text, and
+	// the parsers keep one structure per distinct bound, so this should
+	// be a small number
+
+#include "basics.h"
+
+typedef struct s_bounds {
+    uint64_t n; // text length
+    uint64_t m; // number of intervals
+    uint64_t *start; // interval k is start[k]..start[k+1]-1, start[m] = n
+    uint *bound; // the chain bound of each interval
+    uint *cls; // the index of bound[k] in value
+    uint nb; // number of distinct bounds
+    uint *value; // the distinct bounds, in increasing order
+    } *bounds;
+
+	// reads the map of fname for a text of length n, where the positions
+	// not covered have bound dflt. Exits with an error if the file is
+	// wrong or the intervals overlap
+bounds boundsLoad (char *fname, uint64_t n, uint dflt);
+
+	// destroys B
+void boundsDestroy (bounds B);
+
+	// gives the interval that contains text position i
+uint64_t boundsFind (bounds B, uint64_t i);
+
+	// gives the bound of text position i
+uint boundsAt (bounds B, uint64_t i);
+
+	// gives the largest bound
+uint boundsMax (bounds B);
+
+	// checks that U[0..n-1] respects the bounds, reporting in stderr the
+	// first position that does not. Gives 1 if it is correct, else 0
+int boundsCheck (bounds B, uintData *U);
+
+#endif
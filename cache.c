@@ -0,0 +1,170 @@
+
+	// supports a size-bounded cache of decoded text blocks, shared by
+	// many reader threads
+
+#include <string.h>
+
+#include "cache.h"
+
+#define nokey ((uint64_t)~0)
+
+	// spreads consecutive blocks over different sets
+
+static inline uint64_t hash (uint64_t b)
+
+   { b ^= b >> 33;
+     b *= 0xff51afd7ed558ccdull;
+     b ^= b >> 33;
+     return b;
+   }
+
+	// creates a cache of about bytes bytes for blocks of bsize bytes
+
+blkcache cacheCreate (uint64_t bytes, uint64_t bsize)
+
+   { uint64_t t;
+     uint s;
+     blkcache C = myalloc(sizeof(struct s_blkcache));
+     C->bsize = bsize;
+     C->nsets = bytes / (bsize*CACHEWAYS);
+     if (C->nsets == 0) C->nsets = 1;
+     C->sets = myalloc(C->nsets*sizeof(struct s_cacheset));
+     C->data = myalloc(C->nsets*CACHEWAYS*bsize);
+     for (t=0;t<C->nsets;t++)
+	{ pthread_mutex_init(&C->sets[t].lock,NULL);
+	  for (s=0;s<CACHEWAYS;s++)
+	      { C->sets[t].key[s] = nokey; C->sets[t].ref[s] = 0; }
+	  C->sets[t].hand = 0;
+	  C->sets[t].hits = C->sets[t].misses = 0;
+	}
+     return C;
+   }
+
+	// destroys C
+
+void cacheDestroy (blkcache C)
+
+   { uint64_t t;
+     for (t=0;t<C->nsets;t++) pthread_mutex_destroy(&C->sets[t].lock);
+     myfree(C->sets);
+     myfree(C->data);
+     myfree(C);
+   }
+
+	// gives space of cache in w-bit words
+
+uint64_t cacheSpace (blkcache C)
+
+   { return (C->nsets*sizeof(struct s_cacheset) +
+	     C->nsets*CACHEWAYS*C->bsize + sizeof(struct s_blkcache))/(w/8);
+   }
+
+	// gives block length of C
+
+uint64_t cacheBlock (blkcache C)
+
+   { return C->bsize;
+   }
+
+	// if block b is cached, writes its bytes off..off+len-1 into
+	// data[0..len-1] and returns 1, otherwise returns 0. Counts a hit or
+	// a miss if count
+
+static int lookup (blkcache C, uint64_t b, uint64_t off, uint64_t len,
+		   byte *data, int count)
+
+   { uint64_t t = hash(b) % C->nsets;
+     cacheset set = C->sets+t;
+     uint s;
+     pthread_mutex_lock(&set->lock);
+     for (s=0;s<CACHEWAYS;s++)
+	 if (set->key[s] == b)
+	    { set->ref[s] = 1;
+	      memcpy(data,C->data+(t*CACHEWAYS+s)*C->bsize+off,len);
+	      if (count) set->hits++;
+	      pthread_mutex_unlock(&set->lock);
+	      return 1;
+	    }
+     if (count) set->misses++;
+     pthread_mutex_unlock(&set->lock);
+     return 0;
+   }
+
+	// if block b is cached, writes its byte at offset off into *c and
+	// returns 1, otherwise returns 0. Counts a hit or a miss
+
+int cacheGet (blkcache C, uint64_t b, uint64_t off, byte *c)
+
+   { return lookup(C,b,off,1,c,1);
+   }
+
+	// if block b is cached, writes its bytes off..off+len-1 into
+	// data[0..len-1] and returns 1, otherwise returns 0. Counts nothing
+
+int cachePeek (blkcache C, uint64_t b, uint64_t off, uint64_t len,
+	       byte *data)
+
+   { return lookup(C,b,off,len,data,0);
+   }
+
+	// if block b is cached, copies it into data[0..bsize-1] and returns
+	// 1, otherwise returns 0. Counts a hit or a miss
+
+int cacheRead (blkcache C, uint64_t b, byte *data)
+
+   { uint64_t t = hash(b) % C->nsets;
+     cacheset set = C->sets+t;
+     uint s;
+     pthread_mutex_lock(&set->lock);
+     for (s=0;s<CACHEWAYS;s++)
+	 if (set->key[s] == b)
+	    { set->ref[s] = 1;
+	      memcpy(data,C->data+(t*CACHEWAYS+s)*C->bsize,C->bsize);
+	      set->hits++;
+	      pthread_mutex_unlock(&set->lock);
+	      return 1;
+	    }
+     set->misses++;
+     pthread_mutex_unlock(&set->lock);
+     return 0;
+   }
+
+	// stores data[0..bsize-1] as the contents of block b, evicting
+	// another block of its set if needed (CLOCK: the first slot found
+	// by the hand with its reference bit off)
+
+void cachePut (blkcache C, uint64_t b, byte *data)
+
+   { uint64_t t = hash(b) % C->nsets;
+     cacheset set = C->sets+t;
+     uint s;
+     pthread_mutex_lock(&set->lock);
+     for (s=0;s<CACHEWAYS;s++)
+	 if (set->key[s] == b) break; // another reader put it first
+     if (s == CACHEWAYS)
+	{ while (set->ref[set->hand])
+	     { set->ref[set->hand] = 0;
+	       set->hand = (set->hand+1) % CACHEWAYS;
+	     }
+	  s = set->hand;
+	  set->hand = (set->hand+1) % CACHEWAYS;
+	  set->key[s] = b;
+	  memcpy(C->data+(t*CACHEWAYS+s)*C->bsize,data,C->bsize);
+	}
+     set->ref[s] = 1;
+     pthread_mutex_unlock(&set->lock);
+   }
+
+	// gives total number of hits and misses so far
+
+void cacheStats (blkcache C, uint64_t *hits, uint64_t *misses)
+
+   { uint64_t t;
+     *hits = *misses = 0;
+     for (t=0;t<C->nsets;t++)
+	{ pthread_mutex_lock(&C->sets[t].lock);
+	  *hits += C->sets[t].hits;
+	  *misses += C->sets[t].misses;
+	  pthread_mutex_unlock(&C->sets[t].lock);
+	}
+   }
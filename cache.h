@@ -0,0 +1,67 @@
+
+#ifndef INCLUDEDcache
+#define INCLUDEDcache
+
+	// supports a size-bounded cache of decoded text blocks, shared by
+	// many reader threads
+
+	// the cache is set-associative: a block can only live in the ways of
+	// one set, which is chosen by hashing its number. Each set has its
+	// own lock and CLOCK hand, so readers of different sets never wait
+	// on each other
+
+#include <pthread.h>
+#include "basics.h"
+
+#define CACHEWAYS 8 // slots per set
+
+typedef struct s_cacheset {
+    pthread_mutex_t lock; // protects the whole set
+    uint64_t key[CACHEWAYS]; // block stored in each slot, nokey if empty
+    byte ref[CACHEWAYS]; // CLOCK reference bits
+    uint hand; // CLOCK hand
+    uint64_t hits,misses; // counters, updated under lock
+    } *cacheset;
+
+typedef struct s_blkcache {
+    uint64_t bsize; // block length in bytes
+    uint64_t nsets; // number of sets
+    struct s_cacheset *sets; // the sets
+    byte *data; // block contents, slot s of set t at (t*CACHEWAYS+s)*bsize
+    } *blkcache;
+
+	// creates a cache of about bytes bytes for blocks of bsize bytes
+
+blkcache cacheCreate (uint64_t bytes, uint64_t bsize);
+
+	// destroys C
+void cacheDestroy (blkcache C);
+
+	// gives space of cache in w-bit words
+uint64_t cacheSpace (blkcache C);
+
+	// gives block length of C
+uint64_t cacheBlock (blkcache C);
+
+	// if block b is cached, writes its byte at offset off into *c and
+	// returns 1, otherwise returns 0. Counts a hit or a miss
+int cacheGet (blkcache C, uint64_t b, uint64_t off, byte *c);
+
+	// if block b is cached, writes its bytes off..off+len-1 into
+	// data[0..len-1] and returns 1, otherwise returns 0. Counts nothing,
+	// for lookups that are not queries, such as the sources of a copy
+int cachePeek (blkcache C, uint64_t b, uint64_t off, uint64_t len,
+	       byte *data);
+
+	// if block b is cached, copies it into data[0..bsize-1] and returns
+	// 1, otherwise returns 0. Counts a hit or a miss
+int cacheRead (blkcache C, uint64_t b, byte *data);
+
+	// stores data[0..bsize-1] as the contents of block b, evicting
+	// another block of its set if needed
+void cachePut (blkcache C, uint64_t b, byte *data);
+
+	// gives total number of hits and misses so far
+void cacheStats (blkcache C, uint64_t *hits, uint64_t *misses);
+
+#endif
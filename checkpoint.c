@@ -0,0 +1,278 @@
+
+	// supports periodic checkpoints of a long parse, so that it can be
+	// resumed after being interrupted
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "checkpoint.h"
+
+static char magic[8] = "BATLZCK1";
+
+	// checks that the output is a regular file, giving its size
+
+static uint64_t outputSize (void)
+
+   { struct stat st;
+     if ((fstat(fileno(stdout),&st) != 0) || !S_ISREG(st.st_mode))
+	{ fprintf(stderr,"Error: checkpoints need the output redirected "
+			 "to a file\n");
+	  exit(1);
+	}
+     return st.st_size;
+   }
+
+static double now (void)
+
+   { struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC,&t);
+     return t.tv_sec + t.tv_nsec/1e9;
+   }
+
+	// the seconds between checkpoints given as the value of
+	// --checkpoint-every, or CKPTEVERY if it is NULL
+
+double ckptEvery (char *arg)
+
+   { char *end;
+     double every;
+     if (arg == NULL) return CKPTEVERY;
+     every = strtod(arg,&end);
+     if ((end == arg) || (*end != 0) || !(every > 0))
+	{ fprintf(stderr,"Error: --checkpoint-every needs a positive number "
+			 "of seconds, not %s\n",arg);
+	  exit(1);
+	}
+     return every;
+   }
+
+	// prepares to write a checkpoint on fname every so many seconds
+
+checkpoint ckptCreate (char *fname, double every)
+
+   { checkpoint C = myalloc(sizeof(struct s_checkpoint));
+     outputSize();
+     C->fname = fname;
+     C->every = every;
+     C->next = now() + every;
+     C->writer = 0;
+     C->file = NULL;
+     C->map = NULL;
+     C->size = C->pos = 0;
+     return C;
+   }
+
+	// collects the writer if it finished, giving 1 if so. It waits for
+	// it if wait is set
+
+static int collect (checkpoint C, int wait)
+
+   { int status;
+     pid_t pid;
+     if (C->writer == 0) return 1;
+     pid = waitpid(C->writer,&status,wait ? 0 : WNOHANG);
+     if (pid == 0) return 0; // still writing
+     if ((pid < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+	fprintf(stderr,"Warning: checkpoint %s was not written\n",C->fname);
+     C->writer = 0;
+     return 1;
+   }
+
+	// tells whether a checkpoint is due
+
+int ckptDue (checkpoint C)
+
+   { if (now() < C->next) return 0;
+     return collect(C,0);
+   }
+
+	// the writer gives up on an error
+
+static void fail (checkpoint C, char *tmp)
+
+   { fprintf(stderr,"Error: cannot write checkpoint %s\n",tmp);
+     unlink(tmp);
+     _exit(1);
+   }
+
+	// takes a snapshot, giving 1 in the writer and 0 in the parser
+
+int ckptBegin (checkpoint C)
+
+   { char tmp[1024];
+     int64_t offset;
+     pid_t pid;
+     C->next = now() + C->every;
+     fflush(stdout); // so the writer inherits no pending output
+     offset = ftello(stdout);
+     pid = fork();
+     if (pid < 0)
+	{ fprintf(stderr,"Warning: cannot take a checkpoint snapshot\n");
+	  return 0;
+	}
+     if (pid > 0)
+	{ C->writer = pid;
+	  return 0;
+	}
+	// the writer
+     snprintf(tmp,sizeof(tmp),"%s.tmp",C->fname);
+     C->file = fopen(tmp,"w");
+     if (C->file == NULL) fail(C,tmp);
+     if ((fwrite(magic,1,sizeof(magic),C->file) != sizeof(magic)) ||
+	 (fwrite(&offset,sizeof(int64_t),1,C->file) != 1))
+	fail(C,tmp);
+     return 1;
+   }
+
+	// in the writer, appends a block of the given number of bytes
+
+void ckptWrite (checkpoint C, void *data, uint64_t bytes)
+
+   { char tmp[1024];
+     if ((fwrite(&bytes,sizeof(uint64_t),1,C->file) != 1) ||
+	 (fwrite(data,1,bytes,C->file) != bytes))
+	{ snprintf(tmp,sizeof(tmp),"%s.tmp",C->fname);
+	  fail(C,tmp);
+	}
+   }
+
+	// in the writer, completes the checkpoint and exits
+
+void ckptEnd (checkpoint C)
+
+   { char tmp[1024];
+     snprintf(tmp,sizeof(tmp),"%s.tmp",C->fname);
+     if ((fflush(C->file) != 0) || (fsync(fileno(C->file)) != 0) ||
+	 (fclose(C->file) != 0) || (rename(tmp,C->fname) != 0))
+	fail(C,tmp);
+     _exit(0); // not exit, which would flush the buffers of the parser
+   }
+
+	// waits for the last checkpoint and destroys C
+
+void ckptDestroy (checkpoint C, int complete)
+
+   { collect(C,1);
+     if (complete) unlink(C->fname);
+     myfree(C);
+   }
+
+	// the checkpoint cannot be used
+
+static void damaged (checkpoint C)
+
+   { fprintf(stderr,"Error: checkpoint %s is damaged\n",C->fname);
+     exit(1);
+   }
+
+	// maps the checkpoint fname to resume from it
+
+checkpoint ckptOpen (char *fname)
+
+   { checkpoint C = myalloc(sizeof(struct s_checkpoint));
+     struct stat st;
+     int fd;
+     C->fname = fname;
+     C->writer = 0;
+     C->file = NULL;
+     fd = open(fname,O_RDONLY);
+     if ((fd < 0) || (fstat(fd,&st) != 0))
+	{ fprintf(stderr,"Cannot open %s\n",fname);
+	  exit(1);
+	}
+     C->size = st.st_size;
+     if (C->size < sizeof(magic)+sizeof(int64_t)) damaged(C);
+     C->map = mmap(NULL,C->size,PROT_READ,MAP_PRIVATE,fd,0);
+     close(fd);
+     if (C->map == MAP_FAILED)
+	{ fprintf(stderr,"Cannot map %s\n",fname);
+	  exit(1);
+	}
+     if (memcmp(C->map,magic,sizeof(magic)) != 0) damaged(C);
+     C->pos = sizeof(magic)+sizeof(int64_t);
+     return C;
+   }
+
+	// truncates the output where the checkpoint was taken
+
+void ckptOutput (checkpoint C)
+
+   { int64_t offset;
+     memcpy(&offset,C->map+sizeof(magic),sizeof(int64_t));
+     fflush(stdout);
+     if ((offset < 0) || (outputSize() < (uint64_t)offset))
+	{ fprintf(stderr,"Error: the output must be that of the interrupted "
+			 "run, reopened with >>\n");
+	  exit(1);
+	}
+     if ((ftruncate(fileno(stdout),offset) != 0) ||
+	 (fseeko(stdout,offset,SEEK_SET) != 0))
+	{ fprintf(stderr,"Error: cannot truncate the output\n");
+	  exit(1);
+	}
+   }
+
+	// gives the next block, which must have the given number of bytes
+
+static byte *block (checkpoint C, uint64_t bytes)
+
+   { uint64_t len;
+     byte *data;
+     if (C->pos + sizeof(uint64_t) > C->size) damaged(C);
+     memcpy(&len,C->map+C->pos,sizeof(uint64_t));
+     if ((len != bytes) || (C->pos + sizeof(uint64_t) + len > C->size))
+	damaged(C);
+     data = C->map + C->pos + sizeof(uint64_t);
+     C->pos += sizeof(uint64_t) + len;
+     return data;
+   }
+
+	// reads the next block
+
+void ckptRead (checkpoint C, void *data, uint64_t bytes)
+
+   { memcpy(data,block(C,bytes),bytes);
+   }
+
+	// reads the next block and checks that it is equal to data
+
+void ckptCheck (checkpoint C, void *data, uint64_t bytes)
+
+   { uint64_t len;
+     if (C->pos + sizeof(uint64_t) > C->size) damaged(C);
+     memcpy(&len,C->map+C->pos,sizeof(uint64_t));
+     if ((len != bytes) || (memcmp(data,block(C,bytes),bytes) != 0))
+	{ fprintf(stderr,"Error: checkpoint %s is of a parse with other "
+			 "parameters\n",C->fname);
+	  exit(1);
+	}
+   }
+
+	// gives a hash of data[0..bytes-1] continuing from h, to check
+	// that a parse is resumed on the same input. Reads 8 bytes at a
+	// time, so hashing the text is cheap next to the parse
+
+uint64_t ckptHash (void *data, uint64_t bytes, uint64_t h)
+
+   { byte *p = data;
+     uint64_t x,i;
+     for (i=0;i+sizeof(uint64_t)<=bytes;i+=sizeof(uint64_t))
+	{ memcpy(&x,p+i,sizeof(uint64_t));
+	  h = (h ^ x) * 0x9e3779b97f4a7c15ull;
+	  h ^= h >> 29;
+	}
+     for (;i<bytes;i++) h = (h ^ p[i]) * 0x100000001b3ull;
+     return h ^ bytes;
+   }
+
+	// unmaps the checkpoint and destroys C
+
+void ckptClose (checkpoint C)
+
+   { munmap(C->map,C->size);
+     myfree(C);
+   }
@@ -0,0 +1,85 @@
+
+#ifndef INCLUDEDcheckpoint
+#define INCLUDEDcheckpoint
+
+	// supports periodic checkpoints of a long parse, so that it can be
+	// resumed after being interrupted. A checkpoint is written by a
+	// forked child, which sees a copy-on-write snapshot of the parse
+	// state while the parent goes on parsing. It is written to fname.tmp
+	// and then renamed to fname, so fname always holds a whole one
+
+	// a checkpoint is a sequence of blocks, written with ckptWrite and
+	// read back in the same order with ckptRead. It also records the
+	// offset of the output (stdout) when it was taken, and on resume the
+	// output is truncated there. So the output must be a regular file,
+	// and the resumed run must reopen it without truncating, as in
+	// "greedy_BATLZ ... --resume ckpt >> out"
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "basics.h"
+
+typedef struct s_checkpoint {
+    char *fname; // the checkpoint file
+    double every; // seconds between checkpoints
+    double next; // when the next one is due, on the monotonic clock
+    pid_t writer; // the child writing the last one, 0 if none
+    FILE *file; // in the writer, the file being written
+    byte *map; // on resume, the mapped checkpoint
+    uint64_t size; // its size in bytes
+    uint64_t pos; // the offset of the next block to read
+    } *checkpoint;
+
+#define CKPTEVERY 600 // default seconds between checkpoints
+
+	// the seconds between checkpoints given as the value of
+	// --checkpoint-every, or CKPTEVERY if it is NULL. Exits with an
+	// error unless it is a positive number
+double ckptEvery (char *arg);
+
+	// prepares to write a checkpoint on fname every so many seconds
+checkpoint ckptCreate (char *fname, double every);
+
+	// tells whether a checkpoint is due, that is, the time has come and
+	// the previous one has been written
+int ckptDue (checkpoint C);
+
+	// takes a snapshot. Gives 1 in the writer, which must write the
+	// state with ckptWrite and then call ckptEnd, and 0 in the parser,
+	// also if the snapshot could not be taken
+int ckptBegin (checkpoint C);
+
+	// in the writer, appends a block of the given number of bytes
+void ckptWrite (checkpoint C, void *data, uint64_t bytes);
+
+	// in the writer, completes the checkpoint and exits
+void ckptEnd (checkpoint C);
+
+	// waits for the last checkpoint to be written and destroys C. If
+	// the parse is complete, the checkpoint file is removed
+void ckptDestroy (checkpoint C, int complete);
+
+	// maps the checkpoint fname to resume from it. Exits with an error
+	// if it cannot
+checkpoint ckptOpen (char *fname);
+
+	// truncates the output where the checkpoint was taken, once the
+	// parameters have been checked. Exits with an error if it cannot
+void ckptOutput (checkpoint C);
+
+	// reads the next block, which must have the given number of bytes
+void ckptRead (checkpoint C, void *data, uint64_t bytes);
+
+	// reads the next block and exits with an error if it is not equal
+	// to data, which describes the parameters of the parse
+void ckptCheck (checkpoint C, void *data, uint64_t bytes);
+
+	// gives a hash of data[0..bytes-1] continuing from h (0 to start),
+	// to put the input of the parse, such as the text, in its parameters
+uint64_t ckptHash (void *data, uint64_t bytes, uint64_t h);
+
+	// unmaps the checkpoint and destroys C
+void ckptClose (checkpoint C);
+
+#endif
@@ -0,0 +1,276 @@
+
+	// supports a collection of documents parsed as one text, where each
+	// document is followed by a separator char that occurs nowhere else
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "collection.h"
+
+#define BUFSIZE (1024*1024) // bytes copied at a time
+
+	// writes T[0..n-1] to file cname, escaping with esc the esc and 0
+	// chars of the documents, whose positions are left in X
+
+static void escape (char *cname, byte *T, uint64_t *starts, uint64_t ndocs,
+		    byte esc, uint64_t *X)
+
+   { FILE *out;
+     uint64_t d,j,m;
+     char tname[1024];
+     strcpy(tname,cname);
+     strcat(tname,".tmp");
+     out = fopen(tname,"w");
+     if (out == NULL)
+	{ fprintf(stderr,"Cannot open %s\n",tname);
+	  exit(1);
+	}
+     m = 0;
+     for (d=0;d<ndocs;d++)
+	{ for (j=starts[d];j<starts[d+1]-1;j++)
+	     if ((T[j] == esc) || (T[j] == 0))
+		{ fputc(esc,out); fputc(T[j] ? 1 : 2,out);
+		  X[m++] = j;
+		}
+	     else fputc(T[j],out);
+	  fputc(esc,out); // the separator
+	}
+     if ((fclose(out) != 0) || (rename(tname,cname) != 0))
+	{ fprintf(stderr,"Cannot write %s\n",cname);
+	  exit(1);
+	}
+   }
+
+	// concatenates the documents in files fnames[0..ndocs-1] into file
+	// cname, and writes the document starts to cname.docs. The
+	// documents are read once: the separators and 0s are fixed, or the
+	// chars escaped, afterwards on the mapped concatenation
+
+void colBuild (char *cname, char **fnames, uint64_t ndocs)
+
+   { FILE *in,*out;
+     uint64_t d,i,j,n,m,used[256],*starts,*X,head[2];
+     byte *buf,sep,zero,esc,*T;
+     size_t r;
+     int fd,c;
+     char dname[1024];
+     efset E;
+     out = fopen(cname,"w");
+     if (out == NULL)
+	{ fprintf(stderr,"Cannot open %s\n",cname);
+	  exit(1);
+	}
+     for (c=0;c<256;c++) used[c] = 0;
+     starts = myalloc((ndocs+1)*sizeof(uint64_t));
+     buf = myalloc(BUFSIZE);
+     n = 0;
+     for (d=0;d<ndocs;d++)
+	{ starts[d] = n;
+	  in = fopen(fnames[d],"r");
+	  if (in == NULL)
+	     { fprintf(stderr,"Cannot open %s\n",fnames[d]);
+	       exit(1);
+	     }
+	  while ((r = fread(buf,1,BUFSIZE,in)) > 0)
+	     { for (i=0;i<r;i++) used[buf[i]]++;
+	       fwrite(buf,1,r,out);
+	       n += r;
+	     }
+	  fclose(in);
+	  fputc(0,out); n++; // the separator, fixed later
+	}
+     starts[ndocs] = n;
+     fclose(out);
+     myfree(buf);
+	// the separator, and the char for 0 if needed. If there are not
+	// enough free chars, the least used one escapes itself and 0
+     esc = zero = 0;
+     for (c=1;(c<256) && used[c];c++) { }
+     sep = c;
+     if ((c < 256) && used[0])
+	{ for (c++;(c<256) && used[c];c++) { }
+	  zero = c;
+	}
+     if (c == 256)
+	{ for (c=esc=1;c<256;c++) if (used[c] < used[esc]) esc = c;
+	  sep = esc; zero = 0;
+	}
+     m = esc ? used[esc]+used[0] : 0;
+     X = NULL;
+     if (n > 0)
+	{ fd = open(cname,O_RDWR);
+	  T = mmap(NULL,n,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	  close(fd);
+	  if (T == MAP_FAILED)
+	     { fprintf(stderr,"Cannot map %s\n",cname);
+	       exit(1);
+	     }
+	  if (esc)
+	     { X = myalloc(m*sizeof(uint64_t));
+	       escape(cname,T,starts,ndocs,esc,X);
+	       fprintf(stderr,"No char is free for the separator, %li chars "
+			      "escaped with %i\n",m,esc);
+	     }
+	  else for (d=0;d<ndocs;d++)
+	     { if (zero)
+		  for (j=starts[d];j<starts[d+1]-1;j++)
+		      if (T[j] == 0) T[j] = zero;
+	       T[starts[d+1]-1] = sep;
+	     }
+	  munmap(T,n);
+	}
+     strcpy(dname,cname);
+     strcat(dname,".docs");
+     out = fopen(dname,"w");
+     if (out == NULL)
+	{ fprintf(stderr,"Cannot open %s\n",dname);
+	  exit(1);
+	}
+     head[0] = ndocs;
+     head[1] = sep | (zero << 8) | ((uint64_t)(esc != 0) << 16);
+     fwrite(head,sizeof(uint64_t),2,out);
+     E = efCreate(starts,ndocs,n+1); // n+1 counts the terminator
+     efSave(E,out);
+     efDestroy(E);
+     if (esc)
+	{ E = efCreate(X,m,n+1);
+	  efSave(E,out);
+	  efDestroy(E);
+	  myfree(X);
+	}
+     fclose(out);
+     myfree(starts);
+   }
+
+	// loads the document starts from file, which must be opened for
+	// reading, for the parse A of the concatenation
+
+collection colLoad (FILE *file, archive A)
+
+   { collection C = myalloc(sizeof(struct s_collection));
+     uint64_t head[2],m;
+     if (fread(head,sizeof(uint64_t),2,file) != 2)
+	{ fprintf(stderr,"Error: truncated document file\n");
+	  exit(1);
+	}
+     C->ndocs = head[0];
+     C->sep = head[1] & 0xFF;
+     C->zero = (head[1] >> 8) & 0xFF;
+     C->starts = efLoad(file);
+     C->escaped = (head[1] >> 16) & 1 ? efLoad(file) : NULL;
+     C->A = A;
+     m = C->escaped != NULL ? C->escaped->m : 0;
+     if (C->starts->u+m != A->n)
+	{ fprintf(stderr,"Error: the documents cover %li chars, but the "
+			 "parse %li\n",C->starts->u+m,A->n);
+	  exit(1);
+	}
+     return C;
+   }
+
+	// destroys C, not its archive
+
+void colDestroy (collection C)
+
+   { efDestroy(C->starts);
+     if (C->escaped != NULL) efDestroy(C->escaped);
+     myfree(C);
+   }
+
+	// gives space of C in w-bit words, not counting its archive
+
+uint64_t colSpace (collection C)
+
+   { return sizeof(struct s_collection)/(w/8) + efSpace(C->starts) +
+	    (C->escaped != NULL ? efSpace(C->escaped) : 0);
+   }
+
+	// number of escaped chars before position i
+
+static uint64_t escapes (collection C, uint64_t i)
+
+   { if ((C->escaped == NULL) || (i == 0)) return 0;
+     return efPred(C->escaped,i-1)+1;
+   }
+
+	// text position where document id starts
+
+static uint64_t docStart (collection C, uint64_t id)
+
+   { if (id == C->ndocs) return C->starts->u-1; // the terminator
+     return efAccess(C->starts,id);
+   }
+
+	// gives the length of document id
+
+uint64_t colLength (collection C, uint64_t id)
+
+   { return docStart(C,id+1) - docStart(C,id) - 1;
+   }
+
+	// gives the document that contains position i of the parsed
+	// (encoded) text, or ndocs if it is a separator or the terminator
+
+uint64_t colDocument (collection C, uint64_t i)
+
+   { int64_t d;
+     uint64_t lo,hi,t;
+     if (i >= C->A->n-1) return C->ndocs;
+     if (C->escaped != NULL) // the last decoded position encoded up to i
+	{ lo = i > C->escaped->m ? i-C->escaped->m : 0; hi = i;
+	  while (lo < hi)
+	     { t = (lo+hi+1)/2;
+	       if (t+escapes(C,t) <= i) lo = t; else hi = t-1;
+	     }
+	  i = lo;
+	}
+     d = efPred(C->starts,i);
+     if (i == docStart(C,d+1)-1) return C->ndocs;
+     return d;
+   }
+
+	// writes document[off..off+len-1] into buf, trimming it to the
+	// document, and gives the number of chars written
+
+uint64_t colExtract (collection C, uint64_t id, uint64_t off, uint64_t len,
+		     byte *buf)
+
+   { uint64_t l = colLength(C,id),i,j,k,a,ea,el,x;
+     byte *enc;
+     if (off >= l) return 0;
+     if (len > l-off) len = l-off;
+     a = docStart(C,id)+off;
+     if (C->escaped == NULL)
+	{ arcExtract(C->A,a,len,buf);
+	  if (C->zero)
+	     for (i=0;i<len;i++) if (buf[i] == C->zero) buf[i] = 0;
+	  return len;
+	}
+	// the encoded chars, decoded at the escaped positions
+     k = escapes(C,a);
+     ea = a+k;
+     el = a+len+escapes(C,a+len)-ea;
+     enc = myalloc(el);
+     arcExtract(C->A,ea,el,enc);
+     x = k < C->escaped->m ? efAccess(C->escaped,k) : C->starts->u;
+     for (i=j=0;i<len;i++)
+	{ if (a+i == x)
+	     { buf[i] = enc[j+1] == 1 ? C->sep : 0;
+	       j += 2; k++;
+	       x = k < C->escaped->m ? efAccess(C->escaped,k) : C->starts->u;
+	     }
+	  else buf[i] = enc[j++];
+	}
+     myfree(enc);
+     return len;
+   }
+
+	// writes the whole document id into buf, and gives its length
+
+uint64_t colGetDocument (collection C, uint64_t id, byte *buf)
+
+   { return colExtract(C,id,0,colLength(C,id),buf);
+   }
@@ -0,0 +1,62 @@
+
+#ifndef INCLUDEDcollection
+#define INCLUDEDcollection
+
+	// supports a collection of documents parsed as one text, where each
+	// document is followed by a separator char that occurs nowhere else
+
+	// the variants reserve char 0 for the terminator, so if documents
+	// contain 0s they are replaced by another char that does not occur
+	// in them, and restored on extraction
+
+	// when the documents leave no char free for that, the least used
+	// char esc is the separator, and each esc or 0 inside a document is
+	// written as esc followed by 1 or 2. The (decoded) positions of
+	// those escaped chars are kept in another Elias-Fano set, so the
+	// documents are still accessed by their decoded offsets. Positions
+	// of the collection are decoded ones, except when said otherwise
+
+	// the starts of the documents are kept in an Elias-Fano set, so
+	// millions of small documents take about 2+log(n/d) bits each
+
+#include "archive.h"
+
+typedef struct s_collection {
+    uint64_t ndocs; // number of documents
+    byte sep; // separator char
+    byte zero; // char that stands for 0, 0 if there are no 0s
+    efset starts; // text position of each document
+    efset escaped; // positions of the escaped chars, NULL if none
+    archive A; // the parse of the collection (shared)
+    } *collection;
+
+	// concatenates the documents in files fnames[0..ndocs-1] into file
+	// cname, and writes the document starts to cname.docs
+void colBuild (char *cname, char **fnames, uint64_t ndocs);
+
+	// loads the document starts from file, which must be opened for
+	// reading, for the parse A of the concatenation
+collection colLoad (FILE *file, archive A);
+
+	// destroys C, not its archive
+void colDestroy (collection C);
+
+	// gives space of C in w-bit words, not counting its archive
+uint64_t colSpace (collection C);
+
+	// gives the length of document id
+uint64_t colLength (collection C, uint64_t id);
+
+	// gives the document that contains position i of the parsed
+	// (encoded) text, or ndocs if it is a separator or the terminator
+uint64_t colDocument (collection C, uint64_t i);
+
+	// writes document[off..off+len-1] into buf, trimming it to the
+	// document, and gives the number of chars written
+uint64_t colExtract (collection C, uint64_t id, uint64_t off, uint64_t len,
+		     byte *buf);
+
+	// writes the whole document id into buf, and gives its length
+uint64_t colGetDocument (collection C, uint64_t id, byte *buf);
+
+#endif
@@ -0,0 +1,133 @@
+
+	// supports queries on the chain length (depth) of each text position,
+	// which is what it costs to access it
+
+#include "depth.h"
+
+#define K 4  // space/time tradeoff for bitmaps
+
+	// creates the depths from U[0..n-1], whose values are <= maxchain
+	// U is not modified
+
+depthseq depthCreate (uintData *U, uint64_t n, uint64_t maxchain)
+
+   { uint64_t i;
+     uintData *data,m = 0;
+     depthseq D = myalloc(sizeof(struct s_depthseq));
+     D->maxchain = maxchain;
+     data = myalloc(n*sizeof(uintData)); // wmCreate scrambles it
+     for (i=0;i<n;i++) { data[i] = U[i]; if (U[i] > m) m = U[i]; }
+     D->wm = wmCreate(n,numbits(m),data,K); // maxchain can be n
+     myfree(data);
+     return D;
+   }
+
+	// creates the depths from U[0..n-1] and writes them to file fname,
+	// reporting in stderr
+
+void depthStore (char *fname, uintData *U, uint64_t n, uint64_t maxchain)
+
+   { FILE *f;
+     depthseq D;
+     fprintf(stderr,"Writing depths to %s... ",fname); fflush(stderr);
+     f = fopen(fname,"w");
+     if (f == NULL)
+	{ fprintf(stderr,"Cannot open %s\n",fname);
+	  exit(1);
+	}
+     D = depthCreate(U,n,maxchain);
+     depthSave(D,f);
+     fclose(f);
+     fprintf(stderr,"done, %.3f bits per position\n",
+	     depthSpace(D)*(double)w/n);
+     depthDestroy(D);
+   }
+
+	// destroys D
+
+void depthDestroy (depthseq D)
+
+   { wmDestroy(D->wm);
+     myfree(D);
+   }
+
+	// gives space of depths in w-bit words
+
+uint64_t depthSpace (depthseq D)
+
+   { return wmSpace(D->wm) + sizeof(struct s_depthseq)/(w/8);
+   }
+
+	// writes D to file, which must be opened for writing
+
+void depthSave (depthseq D, FILE *file)
+
+   { fwrite (&D->maxchain,sizeof(uint64_t),1,file);
+     wmSave(D->wm,file);
+   }
+
+	// loads depths from file, which must be opened for reading
+
+depthseq depthLoad (FILE *file)
+
+   { depthseq D = myalloc(sizeof(struct s_depthseq));
+     fread (&D->maxchain,sizeof(uint64_t),1,file);
+     D->wm = wmLoad(file,K);
+     return D;
+   }
+
+	// gives number of positions
+
+uint64_t depthLength (depthseq D)
+
+   { return D->wm->size;
+   }
+
+	// gives the depth of position i
+
+uintData depthAccess (depthseq D, uint64_t i)
+
+   { return wmAccess(D->wm,i);
+   }
+
+	// gives the maximum depth in positions i..j, going to the right
+	// (larger) child whenever it is nonempty
+
+uintData depthMax (depthseq D, uint64_t i, uint64_t j)
+
+   { uint l;
+     int64_t sp = i, ep = j, nsp, nep;
+     uintData v = 0;
+     for (l=0;l<D->wm->nlevels;l++)
+	{ nsp = sp; nep = ep;
+	  wmTrackRightRange(D->wm,l,&nsp,&nep);
+	  if (nsp <= nep) { v = (v << 1) | 1; sp = nsp; ep = nep; }
+	  else { v = v << 1; wmTrackLeftRange(D->wm,l,&sp,&ep); }
+	}
+     return v;
+   }
+
+	// adds to hist[] the depths in rows sp..ep of level l, whose
+	// values start with v
+
+static void histogram (depthseq D, uint l, int64_t sp, int64_t ep,
+		       uintData v, uint64_t *hist)
+
+   { int64_t nsp,nep;
+     if (sp > ep) return;
+     if (l == D->wm->nlevels) { hist[v] += ep-sp+1; return; }
+     nsp = sp; nep = ep;
+     wmTrackLeftRange(D->wm,l,&nsp,&nep);
+     histogram(D,l+1,nsp,nep,v<<1,hist);
+     nsp = sp; nep = ep;
+     wmTrackRightRange(D->wm,l,&nsp,&nep);
+     histogram(D,l+1,nsp,nep,(v<<1)|1,hist);
+   }
+
+	// adds to hist[d] the number of positions in i..j with depth d, for
+	// all d. hist must have room for 2^D->wm->nlevels counters
+
+void depthHistogram (depthseq D, uint64_t i, uint64_t j, uint64_t *hist)
+
+   { histogram(D,0,i,j,0,hist);
+   }
@@ -0,0 +1,53 @@
+
+#ifndef INCLUDEDdepth
+#define INCLUDEDdepth
+
+	// supports queries on the chain length (depth) of each text position,
+	// which is what it costs to access it
+
+	// the depths are at most maxchain, so they are stored in a wavelet
+	// matrix of numbits(maxchain) levels (or fewer if the chains are
+	// shorter), which answers the queries without decompressing
+
+#include "wmatrix.h"
+
+typedef struct s_depthseq {
+    uint64_t maxchain; // the chain bound used in the parse
+    wmatrix wm; // the depths
+    } *depthseq;
+
+	// creates the depths from U[0..n-1], whose values are <= maxchain
+	// U is not modified
+
+depthseq depthCreate (uintData *U, uint64_t n, uint64_t maxchain);
+
+	// creates the depths from U[0..n-1] and writes them to file fname,
+	// reporting in stderr
+void depthStore (char *fname, uintData *U, uint64_t n, uint64_t maxchain);
+
+	// destroys D
+void depthDestroy (depthseq D);
+
+	// gives space of depths in w-bit words
+uint64_t depthSpace (depthseq D);
+
+	// writes D to file, which must be opened for writing
+void depthSave (depthseq D, FILE *file);
+
+	// loads depths from file, which must be opened for reading
+depthseq depthLoad (FILE *file);
+
+	// gives number of positions
+uint64_t depthLength (depthseq D);
+
+	// gives the depth of position i
+uintData depthAccess (depthseq D, uint64_t i);
+
+	// gives the maximum depth in positions i..j
+uintData depthMax (depthseq D, uint64_t i, uint64_t j);
+
+	// adds to hist[d] the number of positions in i..j with depth d, for
+	// all d. hist must have room for 2^D->wm->nlevels counters
+void depthHistogram (depthseq D, uint64_t i, uint64_t j, uint64_t *hist);
+
+#endif
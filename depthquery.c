@@ -0,0 +1,67 @@
+#include <string.h>
+
+// answers chain length (depth) queries on the file written with --depths
+
+#include "depth.h"
+
+static void query (depthseq D, char *q, uint64_t i, uint64_t j)
+{
+  uint64_t *hist,d,nd;
+  if (i >= depthLength(D)) { printf("out of range\n"); return; }
+  if (j >= depthLength(D)) j = depthLength(D)-1;
+  if (!strcmp(q,"at")) printf("%i\n",depthAccess(D,i));
+  else if (i > j) printf("empty range\n");
+  else if (!strcmp(q,"max")) printf("%i\n",depthMax(D,i,j));
+  else if (!strcmp(q,"hist"))
+  {
+    nd = ((uint64_t)1) << D->wm->nlevels;
+    hist = myalloc(nd*sizeof(uint64_t));
+    for (d=0;d<nd;d++) hist[d] = 0;
+    depthHistogram(D,i,j,hist);
+    for (d=0;d<nd;d++) if (hist[d]) printf("%li:%li ",d,hist[d]);
+    printf("\n");
+    myfree(hist);
+  }
+  else printf("unknown query %s\n",q);
+}
+
+void main (int argc, char **argv)
+{
+  depthseq D;
+  uint64_t i,j;
+  char q[16];
+  FILE *f;
+
+  if ((argc != 2) && (argc != 4) && (argc != 5))
+  {
+    fprintf(stderr,"Usage: %s <depth_file> [at <i> | max <i> <j> | "
+    "hist <i> <j>]\n"
+    "Gives the chain length of position i, the maximum one in i..j,\n"
+    "or their histogram in i..j, as depth:count pairs\n"
+    "With no query, reads one query per line from stdin\n\n",argv[0]);
+    exit(1);
+  }
+
+  f = fopen(argv[1],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[1]);
+    exit(1);
+  }
+  D = depthLoad(f);
+  fclose(f);
+  fprintf(stderr,"n = %li, maxchain = %li, %.3f bits per position\n",
+          depthLength(D),D->maxchain,depthSpace(D)*(double)w/depthLength(D));
+
+  if (argc > 2)
+    query(D,argv[2],atol(argv[3]),argc == 5 ? atol(argv[4]) : 0);
+  else while (scanf("%15s %li",q,&i) == 2)
+  {
+    j = 0;
+    if (strcmp(q,"at") && (scanf("%li",&j) != 1)) break;
+    query(D,q,i,j);
+  }
+
+  depthDestroy(D);
+  exit(0);
+}
@@ -0,0 +1,190 @@
+
+	// supports an Elias-Fano encoded set of m sorted values in [0..u-1]
+
+#include <string.h>
+
+#include "efset.h"
+
+#define HEAD 4 // words before the arrays: m, u, l, nh
+
+	// word sizes of the arrays
+
+static uint64_t lowWords (uint64_t m, uint64_t l)
+
+   { return (m*l+w-1)/w + 1; // one more to read across words
+   }
+
+static uint64_t highWords (uint64_t nh)
+
+   { return (nh+w-1)/w;
+   }
+
+static uint64_t selWords (uint64_t count)
+
+   { return (count+EFSAMPLE-1)/EFSAMPLE;
+   }
+
+	// sets the array pointers of E into E->data
+
+static void arrays (efset E)
+
+   { E->low = E->data + HEAD;
+     E->high = E->low + lowWords(E->m,E->l);
+     E->sel1 = E->high + highWords(E->nh);
+     E->sel0 = E->sel1 + selWords(E->m);
+     E->words = E->sel0 + selWords(E->nh-E->m) - E->data;
+   }
+
+	// creates the set of the sorted values v[0..m-1], all < u
+
+efset efCreate (uint64_t *v, uint64_t m, uint64_t u)
+
+   { efset E = myalloc(sizeof(struct s_efset));
+     uint64_t j,i,b,ones,zeros,words;
+     E->m = m; E->u = u; E->l = 0;
+     while ((E->l < w-1) && ((u >> (E->l+1)) >= m)) E->l++;
+     E->nh = m + (u >> E->l) + 1;
+     words = HEAD + lowWords(m,E->l) + highWords(E->nh)
+	     + selWords(m) + selWords(E->nh-m);
+     E->data = myalloc(words*sizeof(uint64_t));
+     for (i=0;i<words;i++) E->data[i] = 0;
+     E->data[0] = m; E->data[1] = u; E->data[2] = E->l; E->data[3] = E->nh;
+     arrays(E);
+     E->owned = 1;
+     for (j=0;j<m;j++)
+	{ for (b=0;b<E->l;b++)
+	     if ((v[j] >> b) & 1) bitsWriteA(E->low,j*E->l+b,1);
+	  bitsWriteA(E->high,(v[j] >> E->l) + j,1);
+	}
+     ones = zeros = 0;
+     for (i=0;i<E->nh;i++)
+	{ if (bitsAccessA(E->high,i))
+	     { if (ones % EFSAMPLE == 0) E->sel1[ones/EFSAMPLE] = i;
+	       ones++;
+	     }
+	  else { if (zeros % EFSAMPLE == 0) E->sel0[zeros/EFSAMPLE] = i;
+		 zeros++;
+	       }
+	}
+     return E;
+   }
+
+	// uses the set stored at data, as written by efSave, without copying
+	// it. Gives the number of words it takes in *words
+
+efset efMap (uint64_t *data, uint64_t *words)
+
+   { efset E = myalloc(sizeof(struct s_efset));
+     E->m = data[0]; E->u = data[1]; E->l = data[2]; E->nh = data[3];
+     E->data = data;
+     E->owned = 0;
+     arrays(E);
+     *words = E->words;
+     return E;
+   }
+
+	// loads E from file, which must be opened for reading
+
+efset efLoad (FILE *file)
+
+   { efset E = myalloc(sizeof(struct s_efset));
+     uint64_t head[HEAD];
+     if (fread(head,sizeof(uint64_t),HEAD,file) != HEAD)
+	{ fprintf(stderr,"Error: truncated Elias-Fano set\n");
+	  exit(1);
+	}
+     E->m = head[0]; E->u = head[1]; E->l = head[2]; E->nh = head[3];
+     E->data = head; // just to compute the size
+     arrays(E);
+     E->data = myalloc(E->words*sizeof(uint64_t));
+     memcpy(E->data,head,HEAD*sizeof(uint64_t));
+     if (fread(E->data+HEAD,sizeof(uint64_t),E->words-HEAD,file)
+	 != E->words-HEAD)
+	{ fprintf(stderr,"Error: truncated Elias-Fano set\n");
+	  exit(1);
+	}
+     arrays(E);
+     E->owned = 1;
+     return E;
+   }
+
+	// destroys E, frees data if it was owned
+
+void efDestroy (efset E)
+
+   { if (E->owned) myfree(E->data);
+     myfree(E);
+   }
+
+	// gives space of E in w-bit words
+
+uint64_t efSpace (efset E)
+
+   { return E->words + sizeof(struct s_efset)/(w/8);
+   }
+
+	// writes E to file, which must be opened for writing
+
+void efSave (efset E, FILE *file)
+
+   { fwrite(E->data,sizeof(uint64_t),E->words,file);
+   }
+
+	// position of the r-th 1 (or 0 if !one) of high, 0-based, scanning
+	// from the sampled position before it
+
+static uint64_t selectBit (efset E, uint64_t r, int one)
+
+   { uint64_t i,x;
+     uint c;
+     i = (one ? E->sel1 : E->sel0)[r/EFSAMPLE];
+     r %= EFSAMPLE;
+     x = (one ? E->high[i/w] : ~E->high[i/w]) >> (i%w); // bit k is i+k
+     c = popcount(x);
+     while (c <= r)
+	{ r -= c;
+	  i = (i/w+1)*w;
+	  x = one ? E->high[i/w] : ~E->high[i/w];
+	  c = popcount(x);
+	}
+     while (r--) x &= x-1;
+     return i + __builtin_ctzll(x);
+   }
+
+	// gives the low bits of the j-th value
+
+static inline uint64_t lowBits (efset E, uint64_t j)
+
+   { uint64_t p = j*E->l;
+     uint64_t x;
+     if (E->l == 0) return 0;
+     x = E->low[p/w] >> (p%w);
+     if (p%w + E->l > w) x |= E->low[p/w+1] << (w-p%w);
+     if (E->l < w) x &= (((uint64_t)1) << E->l)-1;
+     return x;
+   }
+
+	// gives the j-th smallest value, 0-based
+
+uint64_t efAccess (efset E, uint64_t j)
+
+   { return ((selectBit(E,j,1) - j) << E->l) | lowBits(E,j);
+   }
+
+	// gives the number of values <= x, minus 1. That is, the position of
+	// the predecessor of x, or -1 if there is none
+
+int64_t efPred (efset E, uint64_t x)
+
+   { uint64_t h,p,lx;
+     int64_t j;
+     if (x >= E->u) x = E->u-1;
+     h = x >> E->l;
+     lx = x - (h << E->l);
+	// the values with high part h are at high[p..], the 1s before the
+	// h-th 0, and there are p-h values with smaller high part
+     p = h ? selectBit(E,h-1,0)+1 : 0;
+     j = p-h-1;
+     while (bitsAccessA(E->high,p) && (lowBits(E,j+1) <= lx)) { p++; j++; }
+     return j;
+   }
@@ -0,0 +1,57 @@
+
+#ifndef INCLUDEDefset
+#define INCLUDEDefset
+
+	// supports an Elias-Fano encoded set of m sorted values in [0..u-1]
+
+	// each value keeps its l = log(u/m) lowest bits in an array, and its
+	// highest ones in unary in a bitvector of m+u/2^l+1 bits, with
+	// sampled positions of its 1s and 0s to find them in constant time.
+	// All the data lives in one array of words, so it can be saved and
+	// then used in place, from a mapped file
+
+#include "bitvector.h"
+
+#define EFSAMPLE 256 // 1s and 0s between sampled positions
+
+typedef struct s_efset {
+    uint64_t m; // number of values
+    uint64_t u; // universe size
+    uint64_t l; // low bits per value
+    uint64_t nh; // bits of high
+    uint64_t *low; // low bits of the values, m*l
+    uint64_t *high; // the bitvector of high parts
+    uint64_t *sel1; // position of the (k*EFSAMPLE)-th 1
+    uint64_t *sel0; // position of the (k*EFSAMPLE)-th 0
+    uint64_t words; // size of data
+    uint64_t *data; // all of the above
+    int owned; // data is owned (to be freed)
+    } *efset;
+
+	// creates the set of the sorted values v[0..m-1], all < u
+efset efCreate (uint64_t *v, uint64_t m, uint64_t u);
+
+	// uses the set stored at data, as written by efSave, without copying
+	// it. Gives the number of words it takes in *words
+efset efMap (uint64_t *data, uint64_t *words);
+
+	// loads E from file, which must be opened for reading
+efset efLoad (FILE *file);
+
+	// destroys E, frees data if it was owned
+void efDestroy (efset E);
+
+	// gives space of E in w-bit words
+uint64_t efSpace (efset E);
+
+	// writes E to file, which must be opened for writing
+void efSave (efset E, FILE *file);
+
+	// gives the j-th smallest value, 0-based
+uint64_t efAccess (efset E, uint64_t j);
+
+	// gives the number of values <= x, minus 1. That is, the position of
+	// the predecessor of x, or -1 if there is none
+int64_t efPred (efset E, uint64_t x);
+
+#endif
@@ -0,0 +1,151 @@
+
+	// supports writing and reading Elias gamma and delta codes on a
+	// stream of bits, stored highest bit first in each w-bit word
+
+#include "elias.h"
+
+#define TBITS 12 // bits looked up at once when reading gamma codes
+
+	// for each TBITS-bit prefix that starts with a whole gamma code,
+	// its value and its length, otherwise length 0
+
+static struct { uint16_t val; byte len; } table[1<<TBITS];
+static int ready = 0;
+
+	// number of bits of x >= 1
+
+static inline uint bits64 (uint64_t x)
+
+   { return w - __builtin_clzll(x);
+   }
+
+	// creates an empty bitstream, to write on it
+
+bitstream streamCreate (void)
+
+   { bitstream S = myalloc(sizeof(struct s_bitstream));
+     S->size = 1024;
+     S->data = myalloc((S->size+1)*sizeof(uint64_t));
+     S->data[0] = 0;
+     S->pos = 0;
+     return S;
+   }
+
+	// destroys S
+
+void streamDestroy (bitstream S)
+
+   { myfree(S->data);
+     myfree(S);
+   }
+
+	// gives the number of words used by S
+
+uint64_t streamWords (bitstream S)
+
+   { return (S->pos+w-1)/w;
+   }
+
+	// appends the len lowest bits of v, len <= w
+
+void streamWrite (bitstream S, uint64_t v, uint len)
+
+   { uint64_t i = S->pos/w;
+     uint off = S->pos%w;
+     if (len == 0) return;
+     if (len < w) v &= (((uint64_t)1) << len)-1;
+     if (i+1 >= S->size)
+	{ S->size *= 2;
+	  S->data = myrealloc(S->data,(S->size+1)*sizeof(uint64_t));
+	}
+     if (off+len <= w)
+	{ S->data[i] |= v << (w-off-len);
+	  if (off+len == w) S->data[i+1] = 0;
+	}
+     else { S->data[i] |= v >> (off+len-w);
+	    S->data[i+1] = v << (2*w-off-len);
+	  }
+     S->pos += len;
+   }
+
+	// appends gamma(x), x >= 1
+
+void eliasGammaWrite (bitstream S, uint64_t x)
+
+   { uint l = bits64(x);
+     if (l > 1) streamWrite(S,0,l-1);
+     streamWrite(S,x,l);
+   }
+
+	// appends delta(x), x >= 1
+
+void eliasDeltaWrite (bitstream S, uint64_t x)
+
+   { uint l = bits64(x);
+     eliasGammaWrite(S,l);
+     streamWrite(S,x,l-1);
+   }
+
+	// builds the decoding table, must be called before reading
+
+void eliasInit (void)
+
+   { uint64_t p,x;
+     uint l;
+     if (ready) return;
+     for (p=0;p<(1<<TBITS);p++)
+	{ table[p].len = 0;
+	  if (p == 0) continue;
+	  l = bits64(p);  // the code has TBITS-l 0s and then TBITS-l+1 bits
+	  if (2*(TBITS-l)+1 > TBITS) continue;
+	  x = p >> (l-(TBITS-l+1));
+	  table[p].val = x;
+	  table[p].len = 2*(TBITS-l)+1;
+	}
+     ready = 1;
+   }
+
+	// gives the w bits of data starting at bit pos, without advancing
+
+static inline uint64_t peek (uint64_t *data, uint64_t pos)
+
+   { uint64_t i = pos/w;
+     uint off = pos%w;
+     if (off == 0) return data[i];
+     return (data[i] << off) | (data[i+1] >> (w-off));
+   }
+
+	// reads len <= w bits from data at *pos, and advances *pos. data
+	// must have a word after the last one holding bits
+
+uint64_t streamRead (uint64_t *data, uint64_t *pos, uint len)
+
+   { uint64_t v;
+     if (len == 0) return 0;
+     v = peek(data,*pos) >> (w-len);
+     *pos += len;
+     return v;
+   }
+
+	// reads a gamma code from data at *pos, and advances *pos
+
+uint64_t eliasGammaRead (uint64_t *data, uint64_t *pos)
+
+   { uint64_t v = peek(data,*pos);
+     uint z;
+     if (table[v >> (w-TBITS)].len)
+	{ *pos += table[v >> (w-TBITS)].len;
+	  return table[v >> (w-TBITS)].val;
+	}
+     z = __builtin_clzll(v); // < w as the value fits in w bits
+     *pos += z;
+     return streamRead(data,pos,z+1);
+   }
+
+	// reads a delta code from data at *pos, and advances *pos
+
+uint64_t eliasDeltaRead (uint64_t *data, uint64_t *pos)
+
+   { uint l = eliasGammaRead(data,pos);
+     return (((uint64_t)1) << (l-1)) | streamRead(data,pos,l-1);
+   }
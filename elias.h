@@ -0,0 +1,51 @@
+
+#ifndef INCLUDEDelias
+#define INCLUDEDelias
+
+	// supports writing and reading Elias gamma and delta codes on a
+	// stream of bits, stored highest bit first in each w-bit word
+
+	// gamma(x), x >= 1, is numbits(x)-1 0s followed by x in numbits(x)
+	// bits; delta(x) is gamma(numbits(x)) followed by x without its
+	// highest bit. Short gamma codes are read with a single table lookup
+
+#include "basics.h"
+
+typedef struct s_bitstream {
+    uint64_t size; // allocated words, one more is kept for reading
+    uint64_t pos; // bits written
+    uint64_t *data; // the bits
+    } *bitstream;
+
+	// creates an empty bitstream, to write on it
+bitstream streamCreate (void);
+
+	// destroys S
+void streamDestroy (bitstream S);
+
+	// gives the number of words used by S
+uint64_t streamWords (bitstream S);
+
+	// appends the len lowest bits of v, len <= w
+void streamWrite (bitstream S, uint64_t v, uint len);
+
+	// appends gamma(x), x >= 1
+void eliasGammaWrite (bitstream S, uint64_t x);
+
+	// appends delta(x), x >= 1
+void eliasDeltaWrite (bitstream S, uint64_t x);
+
+	// builds the decoding table, must be called before reading
+void eliasInit (void);
+
+	// reads len <= w bits from data at *pos, and advances *pos. data
+	// must have a word after the last one holding bits
+uint64_t streamRead (uint64_t *data, uint64_t *pos, uint len);
+
+	// reads a gamma code from data at *pos, and advances *pos
+uint64_t eliasGammaRead (uint64_t *data, uint64_t *pos);
+
+	// reads a delta code from data at *pos, and advances *pos
+uint64_t eliasDeltaRead (uint64_t *data, uint64_t *pos);
+
+#endif
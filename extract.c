@@ -0,0 +1,86 @@
+#include <string.h>
+
+// extracts substrings of a compressed file without decompressing it,
+// optionally through a cache of decoded blocks
+
+#include "archive.h"
+
+#define BLOCK 4096 // default cache block length
+
+void main (int argc, char **argv)
+{
+  archive A;
+  blkcache C = NULL;
+  uint64_t from,len,q = 0;
+  byte *buf;
+  char *ref;
+  FILE *f;
+
+  ref = argOption(&argc,argv,"--ref");
+
+  if (argc < 4)
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> <from> <len> "
+    "[<cache_KB> [<block>]] [--ref <reference>]\n"
+    "Prints T[from..from+len-1] to stdout\n"
+    "A relative parse needs its <reference>, and T is its target\n"
+    "If <from> is -, reads pairs <from> <len> from stdin instead\n"
+    "<cache_KB> > 0 keeps that many KB of decoded <block>-byte blocks\n\n",
+    argv[0]);
+    exit(1);
+  }
+
+  A = arcMap(argv[1]); // packed files are used in place
+  if (A == NULL)
+  {
+    f = fopen(argv[1],"r");
+    if (f == NULL)
+    {
+      fprintf(stderr,"Cannot open %s\n",argv[1]);
+      exit(1);
+    }
+    A = arcLoad(f);
+    fclose(f);
+  }
+  fprintf(stderr,"n = %li, z = %li phrases%s\n",A->n-A->r,A->z,
+          A->map != NULL ? ", mapped" : "");
+  if (ref != NULL) arcSetReference(A,ref);
+
+  if ((argc > 4) && (atoi(argv[4]) > 0))
+  {
+    C = cacheCreate((uint64_t)atoi(argv[4])*1024,
+                    argc > 5 ? atoi(argv[5]) : BLOCK);
+    arcSetCache(A,C);
+  }
+
+  if (strcmp(argv[2],"-"))
+  {
+    from = atol(argv[2]); len = atol(argv[3]);
+  }
+  else if (scanf("%li %li",&from,&len) != 2) from = A->n;
+  from += A->r; // the positions are in the target
+
+  while (from < A->n)
+  {
+    len = min(len,A->n-from);
+    buf = myalloc(len+1);
+    arcExtract(A,from,len,buf);
+    fwrite(buf,1,len,stdout);
+    myfree(buf);
+    q++;
+    if (strcmp(argv[2],"-")) break;
+    if (scanf("%li %li",&from,&len) != 2) break;
+    from += A->r;
+  }
+
+  fprintf(stderr,"%li queries\n",q);
+  if (C != NULL)
+  {
+    uint64_t hits,misses;
+    cacheStats(C,&hits,&misses);
+    fprintf(stderr,"cache: %li hits, %li misses\n",hits,misses);
+    cacheDestroy(C);
+  }
+  arcDestroy(A);
+  exit(0);
+}
@@ -0,0 +1,85 @@
+#include <string.h>
+
+// extracts documents, or parts of them, from a compressed collection
+
+#include "collection.h"
+
+// prints document[off..off+len-1], or the whole document if len is 0
+static void query (collection C, uint64_t id, uint64_t off, uint64_t len)
+{
+  byte *buf;
+  if (id >= C->ndocs)
+  {
+    fprintf(stderr,"There is no document %li\n",id);
+    return;
+  }
+  if (len == 0)
+  {
+    off = 0; len = colLength(C,id);
+  }
+  buf = myalloc(len+1);
+  len = colExtract(C,id,off,len,buf);
+  fwrite(buf,1,len,stdout);
+  myfree(buf);
+}
+
+void main (int argc, char **argv)
+{
+  archive A;
+  collection C;
+  uint64_t id,off,len,q = 0;
+  char line[1024];
+  FILE *f;
+
+  if ((argc != 4) && (argc != 6))
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> <docs_file> <id> "
+    "[<off> <len>]\n"
+    "Prints document <id>, or its chars <off>..<off>+<len>-1, to stdout\n"
+    "If <id> is -, reads lines <id> [<off> <len>] from stdin instead\n\n",
+    argv[0]);
+    exit(1);
+  }
+
+  A = arcMap(argv[1]); // packed files are used in place
+  if (A == NULL)
+  {
+    f = fopen(argv[1],"r");
+    if (f == NULL)
+    {
+      fprintf(stderr,"Cannot open %s\n",argv[1]);
+      exit(1);
+    }
+    A = arcLoad(f);
+    fclose(f);
+  }
+  f = fopen(argv[2],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[2]);
+    exit(1);
+  }
+  C = colLoad(f,A);
+  fclose(f);
+  fprintf(stderr,"%li documents, n = %li, z = %li phrases\n",
+          C->ndocs,A->n,A->z);
+
+  if (strcmp(argv[3],"-"))
+  {
+    query(C,atol(argv[3]),argc == 6 ? atol(argv[4]) : 0,
+          argc == 6 ? atol(argv[5]) : 0);
+    q++;
+  }
+  else while (fgets(line,sizeof(line),stdin) != NULL)
+  {
+    off = len = 0;
+    if (sscanf(line,"%li %li %li",&id,&off,&len) < 1) continue;
+    query(C,id,off,len);
+    q++;
+  }
+
+  fprintf(stderr,"%li queries\n",q);
+  colDestroy(C);
+  arcDestroy(A);
+  exit(0);
+}
@@ -72,6 +72,11 @@ of (1) points only to (2).
 #include "stdio.h"
 #include "string.h"
 #include "suffix_tree.h"
+#include "verify.h"
+#include "depth.h"
+#include "perfstat.h"
+#include "trace.h"
+#include "progress.h"
 
 DBL_WORD    ST_ERROR;
 
@@ -92,9 +97,22 @@ typedef enum LAST_POS_TYPE {last_char_in_edge, other_char} LAST_POS_TYPE;
 DBL_WORD counter;
 /* Used for statistic measures of space. */
 DBL_WORD heap;
+/* Hardware counters per stage, for --perf. NULL if not counting. */
+perfstat Perf = NULL;
+/* Per-phrase trace, for --trace. NULL if not tracing. */
+trace Trace = NULL;
+/* The work of the current phrase, added up once per search call. */
+tracerec Tr;
+/* Progress reports, NULL if not reporting, and the values of --progress,
+   --status and --status-socket. */
+progress Prog = NULL;
+char *progEvery = NULL, *progStatus = NULL, *progSock = NULL;
 /* Used to mark the node that has no suffix link yet. By Ukkonen, it will have
    one by the end of the current phase. */
 NODE*    suffixless;
+/* Annotations per node, one per distinct chain bound. Set before
+   ST_CreateTree. */
+unsigned int annotations = 1;
 
 typedef struct SUFFIXTREEPATH
 {
@@ -137,8 +155,8 @@ typedef struct SUFFIXTREEPOS
 
 NODE* create_node(NODE* father, DBL_WORD start, DBL_WORD end, DBL_WORD position)
 {
-   /*Allocate a node.*/
-   NODE* node   = (NODE*)malloc(sizeof(NODE));
+   /*Allocate a node, with its annotations.*/
+   NODE* node   = (NODE*)malloc(sizeof(NODE)+annotations*sizeof(BLZA));
    if(node == 0)
    {
       printf("\nOut of memory.\n");
@@ -146,7 +164,7 @@ NODE* create_node(NODE* father, DBL_WORD start, DBL_WORD end, DBL_WORD position)
    }
 
 #ifdef STATISTICS
-   heap+=sizeof(NODE);
+   heap+=sizeof(NODE)+annotations*sizeof(BLZA);
 #endif
 
    /* Initialize node fields. For detailed description of the fields see
@@ -530,6 +548,78 @@ NODE* trace_string(
    return node;
 }
 
+/******************************************************************************/
+/*
+   useClass :
+   Makes the annotations r of the nodes, with their bound and D, those used
+   by the search and the updates. As in greedy_BATLZ, a phrase is searched
+   with the annotations of the bound of its first position, and cut before
+   a position with a tighter bound.
+*/
+
+void useClass(SUFFIX_TREE* tree, unsigned int r)
+{
+   tree->cls = r;
+   tree->bound = tree->Cb[r];
+   tree->D = tree->Db[r];
+}
+
+/* The chain bound of text position textPos, counted from 1, and the
+   annotations of that bound */
+unsigned int boundOf(SUFFIX_TREE* tree, DBL_WORD textPos)
+{
+   return tree->bounds != NULL ? boundsAt(tree->bounds, textPos-1) : tree->COST;
+}
+
+unsigned int classOf(SUFFIX_TREE* tree, DBL_WORD textPos)
+{
+   return tree->bounds != NULL ? tree->bounds->cls[boundsFind(tree->bounds, textPos-1)] : 0;
+}
+
+/******************************************************************************/
+/*
+   findRecent :
+   Goes on with the search of ST_FindSubstring from node, with j chars of W
+   matched, when the best source of node is out of the window. Each node is
+   followed with its most recent occurrence, the closest to W, which is
+   copied as long as its costs are below the bound. A node has no more recent
+   occurrence than its father, so the search ends at the first node whose
+   occurrence is out of the window. Gives the longest of best and the
+   phrases found.
+*/
+
+MATCH findRecent(SUFFIX_TREE* tree, NODE* node, unsigned char* W, DBL_WORD P,
+                 DBL_WORD j, MATCH best)
+{
+   DBL_WORD k, node_label_end, src, len;
+   DBL_WORD textPos = W - tree->tree_string;
+   while(node != 0)
+   {
+      if(node->sons == NULL)
+         src = node->annot[tree->cls].minMax != -1 ? node->path_position : 0;
+      else src = node->annot[tree->cls].recentPos;
+      if(src == 0 || src + tree->maxDist < textPos) return best;
+      k = node->edge_label_start;
+      node_label_end = get_node_label_end(tree,node);
+      while(j<P && k<=node_label_end && tree->tree_string[k] == W[j])
+      {
+         j++;
+         k++;
+      }
+      /* Self-overlapping copies take their costs periodically */
+      for(len = 0; len < j; len++)
+         if(tree->costArray[src + len % (textPos-src)] >= tree->bound) break;
+      if(len > best.length)
+      {
+         best.length = len;
+         best.pos = src;
+      }
+      if(j == P || k <= node_label_end) return best;
+      node = find_son(tree, node, W[j]);
+   }
+   return best;
+}
+
 /******************************************************************************/
 /*
    ST_FindSubstring :
@@ -551,24 +641,31 @@ MATCH ST_FindSubstring(
    MATCH currentMatch;
    currentMatch.length = 0;
    currentMatch.pos = 0;
+   useClass(tree, classOf(tree, W - tree->tree_string));
 
    /* Scan nodes down from the root untill a leaf is reached or the substring is
       found */
    while(node!=0)
    {
-      if(node->annot.optimisticMinMax == -1)
+      if(node->annot[tree->cls].optimisticMinMax == -1)
       {
       	return currentMatch;
       }
-      if(node->annot.optimisticMinMax == tree->COST)
+      /* The best source is too far back, go on with the closest ones */
+      if(tree->maxDist != 0 &&
+         node->annot[tree->cls].optimisticTextPos + tree->maxDist < (DBL_WORD)(W - tree->tree_string))
+      {
+      	return findRecent(tree, node, W, P, j, currentMatch);
+      }
+      if(node->annot[tree->cls].optimisticMinMax == tree->bound)
       {
       	// if(node->sons != NULL) return currentMatch;
          // if(tree->D[node->annot.optimisticTextPos] != -1){
             // fprintf(stderr,"node->annot.optimisticMinMax = %i, tree->D[node->annot.optimisticMinMax] = %i\n",node->annot.optimisticMinMax,tree->D[node->annot.optimisticTextPos]);
-         if(tree->D[node->annot.optimisticTextPos] > currentMatch.length)
+         if(tree->D[node->annot[tree->cls].optimisticTextPos] > currentMatch.length)
          {
-            currentMatch.length = tree->D[node->annot.optimisticTextPos];
-            currentMatch.pos = node->annot.optimisticTextPos;
+            currentMatch.length = tree->D[node->annot[tree->cls].optimisticTextPos];
+            currentMatch.pos = node->annot[tree->cls].optimisticTextPos;
          }
          return currentMatch;
          // }
@@ -600,9 +697,9 @@ MATCH ST_FindSubstring(
       // }
       
       currentMatch.length = j;
-      if(node->annot.optimisticTextPos != 0)
+      if(node->annot[tree->cls].optimisticTextPos != 0)
       {
-      	currentMatch.pos = node->annot.optimisticTextPos;
+      	currentMatch.pos = node->annot[tree->cls].optimisticTextPos;
       }
       else
       {
@@ -649,7 +746,7 @@ NODE *getMinMaxOfChildren(NODE *node, SUFFIX_TREE *tree)
       //  }
       //  else
       //  {
-         if(resultSon->annot.optimisticMinMax > currentSon->annot.optimisticMinMax || (resultSon->annot.optimisticMinMax == currentSon->annot.optimisticMinMax && tree->D[resultSon->annot.optimisticTextPos] < tree->D[currentSon->annot.optimisticTextPos]))
+         if(resultSon->annot[tree->cls].optimisticMinMax > currentSon->annot[tree->cls].optimisticMinMax || (resultSon->annot[tree->cls].optimisticMinMax == currentSon->annot[tree->cls].optimisticMinMax && tree->D[resultSon->annot[tree->cls].optimisticTextPos] < tree->D[currentSon->annot[tree->cls].optimisticTextPos]))
          {
             resultSon = currentSon;
          }
@@ -670,6 +767,16 @@ NODE *getMinMaxOfChildren(NODE *node, SUFFIX_TREE *tree)
    return resultSon;
 }
 
+/* Whether copying len chars from a or from b leaves the same chain lengths,
+   so that the rest of the parse, and z, do not depend on the choice */
+static int sameDepths(unsigned int a, unsigned int b, unsigned int len, SUFFIX_TREE* tree)
+{
+   unsigned int k;
+   for(k = 0; k < len; k++)
+      if(tree->costArray[a+k] != tree->costArray[b+k]) return 0;
+   return 1;
+}
+
 void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int len, unsigned int minMaxOfRange, unsigned int distToC, SUFFIX_TREE* tree)
 {
    NODE * leaf = tree->inversePointers[textPos];
@@ -678,84 +785,97 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
    // 	if(leaf->annot.distToC > distToC)
    // 	   leaf->annot.distToC = distToC;
    // }
-   if(minMaxOfRange > leaf->annot.minMax || leaf->annot.minMax == -1)
+   if(minMaxOfRange > leaf->annot[tree->cls].minMax || leaf->annot[tree->cls].minMax == -1)
    {
-	   leaf->annot.minMax = minMaxOfRange;
-	   leaf->annot.optimisticMinMax = minMaxOfRange;
+	   leaf->annot[tree->cls].minMax = minMaxOfRange;
+	   leaf->annot[tree->cls].optimisticMinMax = minMaxOfRange;
    }
    NODE *parent = leaf->father;
+   unsigned int ancestors = 0;
    while(parent != NULL && (int)parent->strDepth > len)
    {
+      ancestors++;
    	NODE *newMinMaxHolder = getMinMaxOfChildren(parent, tree);
    	
-   	unsigned int oldOptimisticMinMax = parent->annot.optimisticMinMax; 
+   	unsigned int oldOptimisticMinMax = parent->annot[tree->cls].optimisticMinMax; 
    	if(textPos + parent->strDepth - 1 <= finalPos)
    	{ 
-         unsigned cost = tree->costArray[cappedMax(tree->segm,textPos,textPos+parent->strDepth-1,tree->COST)];
+         if(textPos > parent->annot[tree->cls].recentPos) parent->annot[tree->cls].recentPos = textPos;
+         unsigned cost = tree->costArray[cappedMax(tree->segm,textPos,textPos+parent->strDepth-1,tree->bound)];
+         /* Costs from a looser bound saturate the tighter ones */
+         if(cost > tree->bound) cost = tree->bound;
+         /* A source that fell out of the window is replaced by any other */
+         int stale = tree->maxDist != 0 && parent->annot[tree->cls].textPos + tree->maxDist <= finalPos;
+         /* Among equally good sources, the one closer to the phrase, if it
+            leaves the same chain lengths */
+         int closer = tree->closest && textPos > parent->annot[tree->cls].textPos;
 // antes, usaca leaf->annot.optimisticMinMax como cost para decidir si asignarlo
 // y luego asignaba el cappedMax
-         if(parent->annot.minMax == tree->COST)
+         if(parent->annot[tree->cls].minMax == tree->bound)
          {
-            if(cost < tree->COST)
+            if(cost < tree->bound)
             {
-               parent->annot.minMax = cost;
-               parent->annot.textPos = textPos;
+               parent->annot[tree->cls].minMax = cost;
+               parent->annot[tree->cls].textPos = textPos;
             }
             else
             {  
-               if(tree->D[textPos] != -1 && (tree->D[textPos] > tree->D[parent->annot.textPos]))
+               if(tree->D[textPos] != -1 && (tree->D[textPos] > tree->D[parent->annot[tree->cls].textPos] ||
+                   (closer && sameDepths(textPos, parent->annot[tree->cls].textPos, parent->strDepth, tree))))
                {
-                  parent->annot.minMax = cost;
-                  parent->annot.textPos = textPos;
+                  parent->annot[tree->cls].minMax = cost;
+                  parent->annot[tree->cls].textPos = textPos;
                }
             }  
          }
          else 
    	   {
-		      if(cost < parent->annot.minMax)
+		      if(cost < parent->annot[tree->cls].minMax || (stale && cost < tree->bound) ||
+                  (closer && cost == parent->annot[tree->cls].minMax &&
+                   sameDepths(textPos, parent->annot[tree->cls].textPos, parent->strDepth, tree)))
             {
                // fprintf(stderr, "cost = %i, parent->annot.minMax = %i\n",cost,parent->annot.minMax);
-               parent->annot.minMax = cost;
-               parent->annot.textPos = textPos;
+               parent->annot[tree->cls].minMax = cost;
+               parent->annot[tree->cls].textPos = textPos;
             }
    	   }
    	}
 
-      if(parent->annot.optimisticMinMax == -1)
+      if(parent->annot[tree->cls].optimisticMinMax == -1)
       {
-         parent->annot.optimisticMinMax = minMaxOfRange;
-         parent->annot.optimisticTextPos = textPos; 
+         parent->annot[tree->cls].optimisticMinMax = minMaxOfRange;
+         parent->annot[tree->cls].optimisticTextPos = textPos; 
       }
       else 
       {
-         if(parent->annot.optimisticMinMax == tree->COST)
+         if(parent->annot[tree->cls].optimisticMinMax == tree->bound)
          {
-            if(newMinMaxHolder->annot.optimisticMinMax == tree->COST)
+            if(newMinMaxHolder->annot[tree->cls].optimisticMinMax == tree->bound)
             {
-               if(tree->D[newMinMaxHolder->annot.optimisticTextPos] > tree->D[parent->annot.optimisticTextPos])
+               if(tree->D[newMinMaxHolder->annot[tree->cls].optimisticTextPos] > tree->D[parent->annot[tree->cls].optimisticTextPos])
                {
-                  parent->annot.optimisticMinMax = newMinMaxHolder->annot.optimisticMinMax;
-                  parent->annot.optimisticTextPos = newMinMaxHolder->annot.optimisticTextPos;
+                  parent->annot[tree->cls].optimisticMinMax = newMinMaxHolder->annot[tree->cls].optimisticMinMax;
+                  parent->annot[tree->cls].optimisticTextPos = newMinMaxHolder->annot[tree->cls].optimisticTextPos;
                }
                else
                {
-                  parent->annot.optimisticMinMax = parent->annot.minMax;
-                  parent->annot.optimisticTextPos = parent->annot.textPos;
+                  parent->annot[tree->cls].optimisticMinMax = parent->annot[tree->cls].minMax;
+                  parent->annot[tree->cls].optimisticTextPos = parent->annot[tree->cls].textPos;
                }
             }
             else
             {
                // fprintf(stderr,"ERROR %d vs %d\n", parent->annot.optimisticMinMax, newMinMaxHolder->annot.optimisticMinMax);
-               parent->annot.optimisticMinMax = newMinMaxHolder->annot.optimisticMinMax;
-               parent->annot.optimisticTextPos = newMinMaxHolder->annot.optimisticTextPos;
+               parent->annot[tree->cls].optimisticMinMax = newMinMaxHolder->annot[tree->cls].optimisticMinMax;
+               parent->annot[tree->cls].optimisticTextPos = newMinMaxHolder->annot[tree->cls].optimisticTextPos;
             }
          }
          else
          {
-            if(newMinMaxHolder->annot.optimisticMinMax < parent->annot.minMax)
+            if(newMinMaxHolder->annot[tree->cls].optimisticMinMax < parent->annot[tree->cls].minMax)
             {
-               parent->annot.optimisticMinMax = newMinMaxHolder->annot.optimisticMinMax;
-               parent->annot.optimisticTextPos = newMinMaxHolder->annot.optimisticTextPos;
+               parent->annot[tree->cls].optimisticMinMax = newMinMaxHolder->annot[tree->cls].optimisticMinMax;
+               parent->annot[tree->cls].optimisticTextPos = newMinMaxHolder->annot[tree->cls].optimisticTextPos;
             
             }
             else
@@ -765,8 +885,8 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
                //    fprintf(stderr,"ERROR: newMinMaxHolder->annot.optimisticMinMax = %i, parent->annot.minMax = %i\n",newMinMaxHolder->annot.optimisticMinMax,parent->annot.minMax);
                //    exit(1);
                // }
-               parent->annot.optimisticMinMax = parent->annot.minMax;
-               parent->annot.optimisticTextPos = parent->annot.textPos; 
+               parent->annot[tree->cls].optimisticMinMax = parent->annot[tree->cls].minMax;
+               parent->annot[tree->cls].optimisticTextPos = parent->annot[tree->cls].textPos; 
             
             }
          }
@@ -782,7 +902,7 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
    	// 	parent->annot.optimisticTextPos = parent->annot.textPos; 
    	// }
 
-	   int newOptimisticMinMax = parent->annot.optimisticMinMax;
+	   int newOptimisticMinMax = parent->annot[tree->cls].optimisticMinMax;
    	parent = parent->father;
       // if(parent == NULL || (tree->D[parent->annot.optimisticTextPos] > tree->D[newMinMaxHolder->annot.optimisticTextPos] && (newOptimisticMinMax >= parent->annot.minMax && (oldOptimisticMinMax == newOptimisticMinMax)))) return;
 	   // if(parent == NULL || (newOptimisticMinMax >= parent->annot.minMax && (oldOptimisticMinMax == newOptimisticMinMax) && (textPos + parent->strDepth - 1 <= finalPos-len))){
@@ -796,51 +916,266 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
 	// version que no funcionaba:
 	// if(parent == NULL || (leaf->annot.optimisticMinMax >= parent->annot.minMax && (oldOptimisticMinMax == newOptimisticMinMax))) return;
    }  
+   Tr.ancestors += ancestors;
 }
 
 
 void propagateAnnotation(unsigned int textPos, unsigned int len, SUFFIX_TREE* tree)
 {
-   unsigned int currentMinMaxOfRange = 0, distToC = 0, i;
-   for(i = textPos+len; i > 0; i--)
+   unsigned int currentMinMaxOfRange, distToC = 0, i, r;
+   for(r = 0; r < annotations; r++)
    {
-      if(currentMinMaxOfRange < tree->costArray[i])
+      useClass(tree, r);
+      currentMinMaxOfRange = 0;
+      for(i = textPos+len; i > 0; i--)
       {
-      	currentMinMaxOfRange = tree->costArray[i];
+         if(currentMinMaxOfRange < tree->costArray[i])
+         {
+            currentMinMaxOfRange = tree->costArray[i];
+         }
+         if(tree->maxStrDepth[i] < textPos) break;
+         changeAnnotationFromLeaf(i, textPos+len, (int)textPos-i,
+            currentMinMaxOfRange < tree->bound ? currentMinMaxOfRange : tree->bound, distToC, tree);
       }
-      if(tree->maxStrDepth[i] < textPos) break;
-      changeAnnotationFromLeaf(i, textPos+len, (int)textPos-i, currentMinMaxOfRange, distToC, tree);
    }
   // fprintf(stderr,"%i ",textPos-i); fflush(stderr);
 }
 
 
-int parseBLZ(SUFFIX_TREE *tree)
+#ifdef PREFIXSUM
+/* Whether position textPos can get the given cost without exceeding the
+   budget of its region. The budget is also paced along the region, with
+   a slack of PACE positions, so that the first phrases do not use it all */
+#define PACE 128
+int withinBudget(SUFFIX_TREE* tree, unsigned int textPos, unsigned int cost)
+{
+   DBL_WORD regionStart = (textPos-1) / tree->region * tree->region + 1;
+   DBL_WORD regionLength = tree->length+1 - regionStart;
+   if(regionLength > tree->region) regionLength = tree->region;
+   double limit = tree->avg * (textPos-regionStart+1+PACE);
+   if(limit > tree->avg * regionLength) limit = tree->avg * regionLength;
+   return tree->prefixSumCostArray[textPos] - tree->prefixSumCostArray[regionStart] + cost <= limit;
+}
+
+/* Reports the mean, 99th percentile and maximum costs, and the largest
+   mean cost of a region */
+void reportCosts(SUFFIX_TREE* tree)
+{
+   DBL_WORD i, p, n = tree->length, *count = calloc(tree->COST+1, sizeof(DBL_WORD));
+   double worst = 0, mean;
+   for(i = 1; i <= n; i++) count[tree->costArray[i]]++;
+   for(i = 1; i <= n; i += tree->region)
+   {
+      p = i+tree->region <= n+1 ? i+tree->region : n+1;
+      mean = (double)(tree->prefixSumCostArray[p] - tree->prefixSumCostArray[i]) / (p-i);
+      if(mean > worst) worst = mean;
+   }
+   for(i = 0, p = count[0]; p*100 < n*99; p += count[++i]);
+   fprintf(stderr,"Mean cost %.3f, 99th percentile %lu, ", (double)tree->prefixSumCostArray[n+1] / n, i);
+   for(i = tree->COST; count[i] == 0; i--);
+   fprintf(stderr,"max %lu, worst region mean %.3f\n", i, worst);
+   free(count);
+}
+#endif
+
+/******************************************************************************/
+/*
+   Checkpoints :
+   The parse state before textPos is the number z of phrases, the last
+   position with each bound as cost, the cost and D arrays with the segm
+   over the costs, and the annotations of the nodes. These are kept in DFS
+   order, in chunks of CKPTNODES, as the tree is built again on resume.
+*/
+
+#define CKPTNODES 65536
+
+static BLZA ckptBuffer[CKPTNODES];
+static DBL_WORD ckptFill, ckptNext, ckptLeft;
+
+DBL_WORD countNodes(NODE *node)
+{
+   DBL_WORD count = 0;
+   while(node != 0)
+   {
+      count += 1 + countNodes(node->sons);
+      node = node->right_sibling;
+   }
+   return count;
+}
+
+/* Saves (or restores) the annotations of node, its sons and its right
+   siblings through the chunk buffer */
+void ckptAnnotations(NODE *node, checkpoint C, int save)
+{
+   unsigned int r;
+   while(node != 0)
+   {
+      for(r = 0; r < annotations; r++)
+      {
+         if(save)
+         {
+            ckptBuffer[ckptFill++] = node->annot[r];
+            if(ckptFill == CKPTNODES)
+            {
+               ckptWrite(C, ckptBuffer, ckptFill*sizeof(BLZA));
+               ckptFill = 0;
+            }
+         }
+         else
+         {
+            if(ckptNext == ckptFill)
+            {
+               ckptFill = ckptLeft < CKPTNODES ? ckptLeft : CKPTNODES;
+               ckptRead(C, ckptBuffer, ckptFill*sizeof(BLZA));
+               ckptLeft -= ckptFill;
+               ckptNext = 0;
+            }
+            node->annot[r] = ckptBuffer[ckptNext++];
+         }
+      }
+      ckptAnnotations(node->sons, C, save);
+      node = node->right_sibling;
+   }
+}
+
+/* The parameters a checkpoint must match to be resumed: those of the
+   command line, the bounds (and the budget of avgcost) and the text, the
+   last two hashed */
+#define NPAR (7+HOPCLASSES)
+
+void ckptParameters(SUFFIX_TREE *tree, DBL_WORD *par)
+{
+   int c;
+   par[0] = tree->length; par[1] = tree->COST; par[2] = tree->maxDist;
+   par[3] = tree->closest; par[4] = countNodes(tree->root);
+   par[5] = ckptHash(tree->tree_string+1, tree->length, 0);
+   par[6] = 0;
+   if(tree->bounds != NULL)
+      par[6] = ckptHash(tree->bounds->bound, tree->bounds->m*sizeof(uint),
+                        ckptHash(tree->bounds->start, (tree->bounds->m+1)*sizeof(uint64_t), 0));
+#ifdef PREFIXSUM
+   par[6] = ckptHash(&tree->avg, sizeof(double),
+                     ckptHash(&tree->region, sizeof(uint64_t), par[6]));
+#endif
+   for(c = 0; c < HOPCLASSES; c++)
+      par[7+c] = tree->hops != NULL ? tree->hops->weight[c] : 0;
+}
+
+/* In the writer of C, saves the state and exits */
+void saveState(SUFFIX_TREE *tree, checkpoint C, unsigned int textPos, int z)
+{
+   DBL_WORD par[NPAR];
+   unsigned int r;
+   ckptParameters(tree, par);
+   ckptWrite(C, par, sizeof(par));
+   ckptWrite(C, &textPos, sizeof(unsigned int));
+   ckptWrite(C, &z, sizeof(int));
+   ckptWrite(C, tree->lastC, annotations*sizeof(unsigned int));
+   ckptWrite(C, tree->costArray, (tree->length+1)*sizeof(unsigned int));
+   for(r = 0; r < annotations; r++)
+      ckptWrite(C, tree->Db[r], (tree->length+1)*sizeof(unsigned int));
+   ckptWrite(C, tree->segm->dirs, ((2*tree->segm->size+w-2)/w)*sizeof(uint64_t));
+#ifdef PREFIXSUM
+   ckptWrite(C, tree->prefixSumCostArray, (tree->length+2)*sizeof(uint64_t));
+#endif
+   ckptFill = 0;
+   ckptAnnotations(tree->root, C, 1);
+   if(ckptFill > 0) ckptWrite(C, ckptBuffer, ckptFill*sizeof(BLZA));
+   ckptEnd(C);
+}
+
+/* Restores the state saved by saveState */
+void loadState(SUFFIX_TREE *tree, checkpoint C, unsigned int *textPos, int *z)
+{
+   DBL_WORD par[NPAR];
+   unsigned int r;
+   ckptParameters(tree, par);
+   ckptCheck(C, par, sizeof(par));
+   ckptOutput(C);
+   ckptRead(C, textPos, sizeof(unsigned int));
+   ckptRead(C, z, sizeof(int));
+   ckptRead(C, tree->lastC, annotations*sizeof(unsigned int));
+   ckptRead(C, tree->costArray, (tree->length+1)*sizeof(unsigned int));
+   for(r = 0; r < annotations; r++)
+      ckptRead(C, tree->Db[r], (tree->length+1)*sizeof(unsigned int));
+   ckptRead(C, tree->segm->dirs, ((2*tree->segm->size+w-2)/w)*sizeof(uint64_t));
+#ifdef PREFIXSUM
+   ckptRead(C, tree->prefixSumCostArray, (tree->length+2)*sizeof(uint64_t));
+#endif
+   ckptFill = ckptNext = 0;
+   ckptLeft = par[4]*annotations;
+   ckptAnnotations(tree->root, C, 0);
+}
+
+/* The phrase at textPos, of length len and copied from pos, was parsed
+   with the work in Tr: puts it in the trace, with text positions from 0,
+   and starts counting the next one. The depth of the source is the
+   largest cost among the positions copied before textPos. */
+void tracePhrase(SUFFIX_TREE *tree, unsigned int textPos, unsigned int len, unsigned int pos)
+{
+   unsigned int k;
+   Tr.pos = textPos-1;
+   Tr.len = len;
+   Tr.source = len > 0 ? pos-1 : 0;
+   Tr.depth = 0;
+   for(k = pos; len > 0 && k < pos+len && k < textPos; k++)
+      if(tree->costArray[k] > Tr.depth) Tr.depth = tree->costArray[k];
+   tracePut(Trace, &Tr);
+   Tr.checks = Tr.probes = Tr.updates = Tr.ancestors = 0;
+}
+
+int parseBLZ(SUFFIX_TREE *tree, checkpoint C, checkpoint R)
 {
    unsigned int textPos = 1;
    int z = 0;
-   unsigned int positionOfPreviousC = 0;
-   printf("n = %d\n",tree->length);
+   unsigned int r;
+   if(R != NULL)
+      loadState(tree, R, &textPos, &z);
+   else printf("n = %d\n",tree->length);
+   Prog = progCreate(tree->length, textPos-1, z,
+                     progEvery != NULL ? atof(progEvery) : PROGEVERY,
+                     progStatus, progSock);
    while(textPos <= tree->length)
    {
+      if(C != NULL && ckptDue(C) && ckptBegin(C))
+         saveState(tree, C, textPos, z);
       MATCH currentPhrase = ST_FindSubstring(tree, (unsigned char*)tree->tree_string + textPos, tree->length);
       z++;
       unsigned int k = 0, i;
-   if (textPos/1024/1024 != (textPos+currentPhrase.length+1)/1024/1024)
-   {  
-      fprintf(stderr,"%i MB\n",(textPos+currentPhrase.length+1)/1024/1024); }
+      /* Each hop costs the weight of its distance, 1 without hop costs */
+      unsigned int wt = 1;
+      if(tree->hops != NULL && currentPhrase.length > 0)
+         wt = hopWeight(tree->hops, textPos - currentPhrase.pos);
       for(i = 0; i < currentPhrase.length; i++)
       {
-      	tree->costArray[textPos+i] = tree->costArray[currentPhrase.pos + k] + 1;
-         if(tree->costArray[textPos+i] == tree->COST)
+         /* The phrase is cut before a position with a tighter bound, or
+            where a heavy hop would exceed it */
+         if((tree->bounds != NULL || wt > 1) &&
+            tree->costArray[currentPhrase.pos + k] + wt > boundOf(tree, textPos+i))
+         {
+            currentPhrase.length = i;
+            break;
+         }
+#ifdef PREFIXSUM
+         /* The phrase is cut where its region would exceed the budget */
+         if(!withinBudget(tree, textPos+i, tree->costArray[currentPhrase.pos + k] + wt))
+         {
+            currentPhrase.length = i;
+            break;
+         }
+         tree->prefixSumCostArray[textPos+i+1] = tree->prefixSumCostArray[textPos+i] + tree->costArray[currentPhrase.pos + k] + wt;
+#endif
+      	tree->costArray[textPos+i] = tree->costArray[currentPhrase.pos + k] + wt;
+         /* The position is unusable for the bounds up to its cost */
+         for(r = 0; r < annotations && tree->costArray[textPos+i] >= tree->Cb[r]; r++)
          {
             int currentPos;
-            tree->D[textPos+i] = 0;
-            for(currentPos = textPos+i-1; currentPos > positionOfPreviousC; currentPos--)
+            tree->Db[r][textPos+i] = 0;
+            for(currentPos = textPos+i-1; currentPos > tree->lastC[r]; currentPos--)
             {
-               tree->D[currentPos] = tree->D[currentPos+1] + 1;
+               tree->Db[r][currentPos] = tree->Db[r][currentPos+1] + 1;
             }  
-            positionOfPreviousC = textPos+i;
+            tree->lastC[r] = textPos+i;
          }
          // printf("costArray[%i] = %i\n", textPos+i, tree->costArray[textPos+i]);
          segmUpdate(tree->segm,textPos+i,tree->costArray[textPos+i]);
@@ -850,9 +1185,15 @@ int parseBLZ(SUFFIX_TREE *tree)
       	if(currentPhrase.pos + k == textPos) k = 0;
       }
       tree->costArray[textPos+currentPhrase.length] = 0;
+#ifdef PREFIXSUM
+      tree->prefixSumCostArray[textPos+currentPhrase.length+1] = tree->prefixSumCostArray[textPos+currentPhrase.length];
+#endif
 
       segmUpdate(tree->segm,textPos+currentPhrase.length,0);
+      Tr.updates += currentPhrase.length+1; // one per position
       propagateAnnotation(textPos, currentPhrase.length, tree);
+      if(Trace != NULL)
+         tracePhrase(tree, textPos, currentPhrase.length, currentPhrase.pos);
       
       // // check if generated phrase is correct: tree->string[textPos..textPos+currentPhrase.length-1] == tree->string[currentPhrase.pos..currentPhrase.pos+currentPhrase.length-1]
       // // if not, print error message and exit
@@ -864,10 +1205,15 @@ int parseBLZ(SUFFIX_TREE *tree)
       // }
 
       textPos = textPos+currentPhrase.length+1;
+      progSet(Prog, textPos-1, z);
       printf("(%d,%d,%d)\n", currentPhrase.pos-1, currentPhrase.length, (unsigned)tree->tree_string[textPos-1]);
+      if(tree->phrases != NULL)
+         arcAdd(tree->phrases, currentPhrase.pos-1, currentPhrase.length, tree->tree_string[textPos-1]);
 
    }
+   progDestroy(Prog);
    printf("\n\nz = %i phrases\n",z);
+   fflush(stdout);
    // unsigned int j;
    // for(j = 1; j < textPos; j++)
    // {
@@ -1175,26 +1521,25 @@ void SPA(
 
 
 unsigned dfsForInversePointers(NODE * node, SUFFIX_TREE *tree, unsigned int depth)
-{ unsigned num = 0;
-	node->annot.minMax = -1;
-	node->annot.optimisticMinMax = -1;
+{ unsigned num = 0, r;
+	for(r = 0; r < annotations; r++)
+	{
+		node->annot[r].minMax = -1;
+		node->annot[r].optimisticMinMax = -1;
+		node->annot[r].recentPos = 0;
+		node->annot[r].textPos = node->sons == NULL ? node->path_position : 0;
+		node->annot[r].optimisticTextPos = node->annot[r].textPos;
+	}
 	// node->annot.distToC = -1;
-#ifdef PREFIXSUM
-   node->annot.totalCost = -1;
-#endif
 	node->strDepth = depth;
 	if(node->sons == NULL)
 	{
 		tree->inversePointers[node->path_position] = node;
 		tree->maxStrDepth[node->path_position] = node->path_position + node->father->strDepth - 1;
-   		node->annot.optimisticTextPos = node->path_position;
-   		node->annot.textPos = node->path_position;
    		num++;
 	}
 	else
 	{
-		node->annot.textPos = 0;
-		node->annot.optimisticTextPos = 0;
 		NODE *currentChild = node->sons;
 		while(currentChild != NULL)
 		{
@@ -1247,18 +1592,26 @@ SUFFIX_TREE* ST_CreateTree(unsigned char* str, DBL_WORD length)
    }
    heap+=sizeof(SUFFIX_TREE);
    tree->inversePointers = malloc(sizeof(NODE *) * (length + 2));
-   tree->costArray = malloc(sizeof(unsigned int) * (length + 2));
+   tree->costArray = malloc(sizeof(*tree->costArray) * (length + 2));
    tree->maxStrDepth = malloc(sizeof(unsigned int) * (length + 2));
 #ifdef PREFIXSUM
-   tree->prefixSumCostArray = malloc(sizeof(unsigned int) * (length + 2));
+   tree->prefixSumCostArray = malloc(sizeof(uint64_t) * (length + 3));
    tree->prefixSumCostArray[0] = 0;
    tree->prefixSumCostArray[1] = 0;
-   tree->prefixSumCostArray[2] = 0;
+   tree->region = length+1;
+   tree->avg = length+1;
 #endif
    { int i;
      for (i=0;i<=length+1;i++) tree->costArray[i] = length+1;
    }
+   perfStage(Perf,"segmCreate");
    tree->segm = segmCreate(tree->costArray,length+1);
+   perfStage(Perf,"ST_CreateTree");
+   tree->phrases = NULL;
+   tree->maxDist = 0;
+   tree->closest = 0;
+   tree->bounds = NULL;
+   tree->hops = NULL;
 
    /* Calculating string length (with an ending $ sign) */
    tree->length         = length+1;
@@ -1303,7 +1656,7 @@ SUFFIX_TREE* ST_CreateTree(unsigned char* str, DBL_WORD length)
    if (nn != tree->length) 
 	fprintf(stderr,"text length = %i, suffix tree leaves = %i\n",tree->length,nn);
    else fprintf(stderr,"dfs matches\n");
-   unsigned int i;
+   unsigned int i, r;
    for(i = 2; i <= tree->length; i++)
    {
    	if(tree->maxStrDepth[i-1] > tree->maxStrDepth[i])
@@ -1311,11 +1664,18 @@ SUFFIX_TREE* ST_CreateTree(unsigned char* str, DBL_WORD length)
    }
 
 
-   /* Initialize D array to -1 */
-   tree->D = malloc(sizeof(int) * (tree->length + 1));
-   for(i = 0; i <= tree->length; i++)
+   /* Initialize the D arrays to -1, their bounds are set with COST */
+   tree->Db = malloc(sizeof(unsigned int *) * annotations);
+   tree->Cb = malloc(sizeof(unsigned int) * annotations);
+   tree->lastC = malloc(sizeof(unsigned int) * annotations);
+   for(r = 0; r < annotations; r++)
    {
-   	tree->D[i] = -1;
+      tree->Db[r] = malloc(sizeof(int) * (tree->length + 1));
+      for(i = 0; i <= tree->length; i++)
+      {
+      	tree->Db[r][i] = -1;
+      }
+      tree->lastC[r] = 0;
    }
    return tree;
 }
@@ -1512,6 +1872,29 @@ DBL_WORD ST_SelfTest(SUFFIX_TREE* tree)
 
 
 
+/******************************************************************************/
+/*
+   estimate :
+   Estimates the memory of parsing a text of length len, with the suffix
+   tree at its largest: 2 nodes per position, each with a malloc header
+   and nb annotations, one per distinct chain bound.
+*/
+
+memplan estimate(DBL_WORD len, unsigned int nb)
+{
+   memplan P = memCreate("suffix tree");
+   DBL_WORD n = len+1; /* with the final $ */
+   memAdd(P, "text", n, MEMBUILD|MEMPARSE);
+   memAdd(P, "suffix tree nodes", 2*n*(((sizeof(NODE)+nb*sizeof(BLZA)+8+15)/16)*16), MEMBUILD|MEMPARSE);
+   memAdd(P, "leaf pointers", (n+1)*sizeof(NODE*), MEMBUILD|MEMPARSE);
+   memAdd(P, "costs, maximum depths and D", (2+nb)*(n+1)*sizeof(unsigned int), MEMBUILD|MEMPARSE);
+   memAdd(P, "chain structure", segmSpaceFor(n)*sizeof(uint64_t), MEMBUILD|MEMPARSE);
+#ifdef PREFIXSUM
+   memAdd(P, "cost prefix sums", (n+2)*sizeof(uint64_t), MEMBUILD|MEMPARSE);
+#endif
+   return P;
+}
+
 int main(int argc, char* argv[])
 {
 	SUFFIX_TREE* tree;
@@ -1519,8 +1902,44 @@ int main(int argc, char* argv[])
 	FILE* file = 0;
 	DBL_WORD i,z,len = 0;
 
+	int verify = argFlag(&argc,argv,"--verify");
+	char *depths = argOption(&argc,argv,"--depths");
+	char *dist = argOption(&argc,argv,"--max-distance");
+#ifdef PREFIXSUM
+	char *region = argOption(&argc,argv,"--region");
+#endif
+	int closest = argFlag(&argc,argv,"--closest");
+	char *map = argOption(&argc,argv,"--bounds");
+	char *hops = argOption(&argc,argv,"--hop-cost");
+	char *ckpt = argOption(&argc,argv,"--checkpoint");
+	char *every = argOption(&argc,argv,"--checkpoint-every");
+	char *resume = argOption(&argc,argv,"--resume");
+	checkpoint C = NULL, R = NULL;
+	bounds B = NULL;
+	char *mem = argOption(&argc,argv,"--mem-limit");
+	if(argFlag(&argc,argv,"--perf")) Perf = perfCreate();
+	char *tfile = argOption(&argc,argv,"--trace");
+	progEvery = argOption(&argc,argv,"--progress");
+	progStatus = argOption(&argc,argv,"--status");
+	progSock = argOption(&argc,argv,"--status-socket");
+	int est = argFlag(&argc,argv,"--estimate");
+	uint64_t limit = mem != NULL ? memParse(mem) : 0;
+	memplan P;
+
+#ifdef PREFIXSUM
+	if(argc < 4) {
+	   fprintf(stderr,"Usage: %s <filename> <maxc> <avg> [--region <R>] [--verify] [--depths <file>] [--max-distance <W>] [--closest] [--bounds <file>] [--hop-cost <w0,w1,w2,w3>] [--checkpoint <file>] [--checkpoint-every <s>] [--resume <file>] [--mem-limit <size>] [--perf] [--trace <file>] [--progress <s>] [--status <file>] [--status-socket <path>] [--estimate]\n"
+	      "The mean cost of each <R> positions (the whole text by default) is at most <avg>\n",argv[0]); 
+	   exit(1);
+	}
+#else
 	if(argc < 3) {
-	   fprintf(stderr,"Usage: %s <filename> <maxc>\n",argv[0]); 
+	   fprintf(stderr,"Usage: %s <filename> <maxc> [--verify] [--depths <file>] [--max-distance <W>] [--closest] [--bounds <file>] [--hop-cost <w0,w1,w2,w3>] [--checkpoint <file>] [--checkpoint-every <s>] [--resume <file>] [--mem-limit <size>] [--perf] [--trace <file>] [--progress <s>] [--status <file>] [--status-socket <path>] [--estimate]\n",argv[0]); 
+	   exit(1);
+	}
+#endif
+	if(verify && resume != NULL) {
+	   fprintf(stderr,"--verify cannot check a resumed parse\n");
 	   exit(1);
 	}
    filename = argv[1];
@@ -1535,6 +1954,29 @@ int main(int argc, char* argv[])
    fseek(file, 0, SEEK_END);
    len = ftell(file);
    fseek(file, 0, SEEK_SET);
+   /* The bounds are read first, as each node is allocated with one
+      annotation per distinct bound */
+   if(map != NULL)
+   {
+      B = boundsLoad(map, len+1, atoi(argv[2]));
+      annotations = B->nb;
+   }
+   P = estimate(len, annotations);
+   memReport(P);
+   if(est)
+   {
+      printf("peak = %lu\n", memPeak(P));
+      exit(0);
+   }
+   if(limit != 0 && memPeak(P) > limit)
+   {
+      fprintf(stderr,"Error: the suffix tree needs %.1f MB, above the limit of %.1f MB; "
+                     "greedy_BATLZ --mem-limit can parse in less\n",
+              memPeak(P)/1048576.0, limit/1048576.0);
+      exit(1);
+   }
+   memDestroy(P);
+   perfStage(Perf,"text load");
    str = (unsigned char*)malloc((len+1)*sizeof(unsigned char));
    if(str == 0)
    {
@@ -1555,9 +1997,26 @@ int main(int argc, char* argv[])
    str[len] = 0;
 
 	fprintf(stderr,"Constructing tree...\n");
+	perfStage(Perf,"ST_CreateTree");
 	tree = ST_CreateTree(str,len); // it appends the 0 anyway
+	perfStage(Perf,NULL);
 	fprintf(stderr,"Parsing...\n");
    tree->COST = atoi(argv[2]);
+   if(dist != NULL) tree->maxDist = atol(dist);
+   tree->closest = closest;
+   if(map != NULL)
+   {
+      tree->bounds = B;
+      tree->COST = boundsMax(tree->bounds);
+   }
+   for(i = 0; i < annotations; i++)
+      tree->Cb[i] = tree->bounds != NULL ? tree->bounds->value[i] : tree->COST;
+   useClass(tree, 0);
+   if(hops != NULL) tree->hops = hopParse(hops);
+#ifdef PREFIXSUM
+   if(region != NULL) tree->region = atol(region);
+   tree->avg = atof(argv[3]);
+#endif
 	char *filename_cost = (char*)malloc(strlen(filename)+45);
 	strcpy(filename_cost,filename);
 	char *strCost = (char *)malloc(sizeof(char)*10);
@@ -1566,8 +2025,26 @@ int main(int argc, char* argv[])
 	strcat(filename_cost,strCost);
 	strcat(filename_cost,".cost");
 	fprintf(stderr, "filename_cost: %s\n",filename_cost);
-	z = parseBLZ(tree);
+	if(verify) tree->phrases = arcCreate();
+	if(ckpt != NULL) C = ckptCreate(ckpt, ckptEvery(every));
+	if(resume != NULL) R = ckptOpen(resume);
+	if(tfile != NULL) Trace = traceCreate(tfile, len, tree->COST);
+	perfStage(Perf,"parse");
+	z = parseBLZ(tree, C, R);
+	perfStage(Perf,"output");
+	if(Trace != NULL) traceDestroy(Trace);
+	fflush(stdout);
+	if(R != NULL) ckptClose(R);
+	if(C != NULL) ckptDestroy(C, 1); // the parse is complete
 	fprintf(stderr,"%i phrases\n",z);
+#ifdef PREFIXSUM
+	reportCosts(tree);
+#endif
+	if(depths != NULL) depthStore(depths,tree->costArray+1,tree->length,tree->COST);
+	perfReport(Perf,len);
+	if(verify && !verifyParse(tree->phrases,str,len+1,hops != NULL ? len+1 : tree->COST,0)) exit(1);
+	if(verify && hops != NULL && !hopCheck(tree->phrases,tree->hops,tree->bounds,tree->COST)) exit(1);
+	if(verify && hops == NULL && map != NULL && !boundsCheck(tree->bounds,tree->costArray+1)) exit(1);
 	
    free(str);
    free(filename_cost);
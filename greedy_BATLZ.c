@@ -9,11 +9,24 @@
 	// change uintA to uint64_t to handle longer texts
 
 #include "segm.h"
+#include "verify.h"
+#include "depth.h"
+#include "bounds.h"
+#include "hopcost.h"
+#include "checkpoint.h"
+#include "memplan.h"
+#include "perfstat.h"
+#include "trace.h"
+#include "progress.h"
 
 #define K 4  // space/time tradeoff for bitmaps
 
 uint MAX;    // max number of copies allowed
 
+uint64_t W = 0; // max distance from a phrase to its source, 0 for none
+
+bool closest = false; // choose the rightmost source among the equivalent
+
 byte *T; // null-terminated text 
 
 uint64_t n; // text length
@@ -30,43 +43,223 @@ wmatrix M; // wmatrix of SA
 
 segm S; // segment structures, one per wm level
 
+bounds B = NULL; // chain bounds along the text, NULL to use MAX everywhere
+
+hopcost H = NULL; // hop weights by distance, NULL to count hops
+
+perfstat Perf = NULL; // hardware counters per stage, NULL if not counting
+
+trace Trace = NULL; // per-phrase trace, NULL if not tracing
+
+progress Prog = NULL; // progress reports, NULL if not reporting
+
+tracerec Tr; // the work of the current phrase, added up per search call
+
+	// with B or H, a source p can be copied with weight w into a
+	// position bounded by b iff U[p] < b-w+1. There is a D and S for
+	// each distinct such threshold thr[0..nthr-1], with the last position
+	// that is unusable for it. D and S point to those of the search
+uint nthr, *thr;
+uintData **Db;
+segm *Sb;
+int64_t *lastb;
+
+// the structures for copying with weight wt into a position bounded by b,
+// or -1 if there are none
+static int structure (uint b, uint wt)
+
+{ uint r;
+  if (b < wt) return -1;
+  for (r=0;r<nthr;r++)
+    if (thr[r] == b-wt+1) return r;
+  return -1;
+}
+
+// the memory plans, from the fastest to the leanest. From PLANMAP on,
+// Map is computed from the wm instead of stored. From PLANISA on, also
+// ISA, and the wm is built streaming SA from its file, which is read
+// again if needed. With PLANSA, also SA
+#define PLANFULL 0
+#define PLANMAP 1
+#define PLANISA 2
+#define PLANSA 3
+#define PLANS 4
+
+char *planName[PLANS] = { "full", "no Map", "no Map and ISA",
+                          "no Map, ISA and SA" };
+
+// the values of Map, SA and ISA, computed when the plan drops them
+static inline uintData mapAt (uint64_t p)
+{
+  return Map != NULL ? Map[p] : wmPermValue(M,p);
+}
+
+static inline uintData saAt (uint64_t m)
+{
+  return SA != NULL ? SA[m] : wmAccess(M,m);
+}
+
+static inline uintData isaAt (uint64_t k)
+{
+  return ISA != NULL ? ISA[k] : wmPermLocate(M,k);
+}
 
-// initializes all the structures, given SA and ISA of length n
-// and maximum allowed chain length
-void initialize (uint64_t n, uint64_t maxChain)
+// stores the maximum chain length and, with B or H, the thresholds
+void thresholds (uint64_t maxChain)
+{
+  if (maxChain == 0)
+  { 
+    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
+    exit(1);
+  }
+  MAX = maxChain;
+  if ((B != NULL) || (H != NULL))
+  {
+    uint r,c,t,b,wt;
+    uint nb = B != NULL ? B->nb : 1;
+    uint nw = H != NULL ? HOPCLASSES : 1;
+    thr = myalloc (nb*nw*sizeof(uint));
+    nthr = 0;
+    for (r=0;r<nb;r++)
+      for (c=0;c<nw;c++)
+      {
+        b = B != NULL ? B->value[r] : MAX;
+        wt = H != NULL ? H->weight[c] : 1;
+        if ((b < wt) || (structure(b,wt) >= 0)) continue; // none or there
+        for (t=nthr++;(t>0) && (thr[t-1] > b-wt+1);t--) thr[t] = thr[t-1];
+        thr[t] = b-wt+1;
+      }
+  }
+}
+
+// the structures r of D and S, which are Db[r] and Sb[r] with B or H
+static uint structures (void)
+{
+  return ((B != NULL) || (H != NULL)) ? max(nthr,1) : 1;
+}
+
+// estimates the memory of plan p for a text of length n
+memplan estimate (uint p, uint64_t n)
+{
+  memplan P = memCreate(planName[p]);
+  uint depth = numbits(n);
+  uint ns = structures();
+
+  memAdd (P,"text",n,MEMBUILD|MEMPARSE);
+  memAdd (P,"wavelet matrix",wmSpaceFor(n,depth,K)*sizeof(uint64_t),
+          MEMBUILD|MEMPARSE);
+  if (p < PLANISA)
+  {
+    memAdd (P,"SA",n*sizeof(uintData),MEMBUILD|MEMPARSE);
+    memAdd (P,"ISA",n*sizeof(uintData),MEMBUILD|MEMPARSE);
+    memAdd (P,"wavelet matrix construction",n*sizeof(uintData),MEMBUILD);
+  }
+  else
+  {
+    memAdd (P,"wavelet matrix streaming",
+            3*min(WMCHUNK,n)*sizeof(uintData),MEMBUILD);
+    if (p == PLANISA) memAdd (P,"SA",n*sizeof(uintData),MEMPARSE);
+  }
+  if (p == PLANFULL) memAdd (P,"Map",n*sizeof(uintData),MEMPARSE);
+  memAdd (P,"D and U",2*n*sizeof(uintData),MEMPARSE);
+  if (ns > 1) memAdd (P,"D of the other thresholds",
+                      (ns-1)*n*sizeof(uintData),MEMPARSE);
+  memAdd (P,"chain structures",ns*segmSpaceFor(n,depth)*sizeof(uint64_t),
+          MEMPARSE);
+  return P;
+}
+
+// reads SA from fname, for a text of length n with the final \0
+uintData *readSA (char *fname, uint64_t n)
+{
+  FILE *f;
+  uintData *sa = myalloc(n*sizeof(uintData));
+  f = fopen(fname,"r");
+  if (f == NULL)
+  { 
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  sa[0] = n-1; // simulate the final \0, kkp does not add it
+  fread (sa+1,sizeof(uintData),n-1,f);
+  fclose(f);
+  return sa;
+}
+
+// initializes all the structures for a text of length n, under plan,
+// given SA and ISA below PLANISA or else the file fnameSA
+void initialize (uint64_t n, uint plan, char *fnameSA)
 { 
   uint64_t i;
   uint depth;
-	// create the data D and U
-  D = myalloc (n*sizeof(uintData));
-  for (i=0;i<n;i++) D[i] = n; // maximum bound for all positions
-  U = myalloc (n*sizeof(uintData));
+  uintData first = n-1; // the final \0, the first suffix
+  FILE *f;
 	// create wavelet matrix on the SA
   depth = numbits(n);
 
   fprintf(stderr,"Creating wavelet matrix... "); fflush(stderr);
 
-  M = wmCreate (n,depth,SA,K);
+  perfStage(Perf,"wmCreate");
+  if (plan < PLANISA)
+  {
+    M = wmCreate (n,depth,SA,K);
+    if (plan == PLANFULL)
+    {
+      Map = SA; // SA was scrambled by wmCreate
+      SA = myalloc(n*sizeof(uintData));
+    }
+    else Map = NULL;
+	// recover SA after wm construction, to save space
+    for (i=0;i<n;i++) SA[ISA[i]] = i; 
+  }
+  else
+  {
+    f = fopen(fnameSA,"r");
+    if (f == NULL)
+    { 
+      fprintf(stderr,"Cannot open %s\n",fnameSA);
+      exit(1);
+    }
+    M = wmCreateStream (n,depth,&first,1,f,K);
+    fclose(f);
+    Map = ISA = NULL;
+    perfStage(Perf,"SA load");
+    SA = plan == PLANISA ? readSA(fnameSA,n) : NULL;
+  }
 
   fprintf(stderr,"done\n");
 
-  Map = SA; // SA was scrambled by wmCreate
+	// create the data D and U
+  D = myalloc (n*sizeof(uintData));
+  for (i=0;i<n;i++) D[i] = n; // maximum bound for all positions
+  U = myalloc (n*sizeof(uintData));
 
   // create the segments, one per wmatrix level 
 
   fprintf(stderr,"Creating chain structures... "); fflush(stderr);
 
+  perfStage(Perf,"segmCreate");
   S = segmCreate(M,D,Map); 
 
   fprintf(stderr,"done\n");
 
-	// stores the maximum number of copies
-  if (maxChain == 0)
-  { 
-    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
-    exit(1);
+  if ((B != NULL) || (H != NULL))
+  {
+    uint r;
+    Db = myalloc (max(nthr,1)*sizeof(uintData*));
+    Sb = myalloc (max(nthr,1)*sizeof(segm));
+    lastb = myalloc (max(nthr,1)*sizeof(int64_t));
+    Db[0] = D; Sb[0] = S; lastb[0] = -1;
+    for (r=1;r<nthr;r++)
+    {
+      Db[r] = myalloc (n*sizeof(uintData));
+      for (i=0;i<n;i++) Db[r][i] = n;
+      Sb[r] = segmCreate(M,Db[r],Map);
+      lastb[r] = -1;
+    }
+    if (B != NULL) MAX = boundsMax(B);
   }
-  MAX = maxChain;
+  perfStage(Perf,NULL);
 }
 
 #define nomax ((uint64_t)~0)
@@ -92,8 +285,8 @@ static uint64_t check (segm S, int64_t i, int64_t sp, int64_t ep,
       if (nsp <= nep)
       { 
         v = cappedMax (S,lev+1,nsp,nep,val);
-        v = Map[v];
-        if (D[v] >= val) return v;
+        v = mapAt(v);
+        if (D[v] >= val) { Tr.checks += lev+1; return v; }
         if ((maxv == nomax) || (D[v] > D[maxv])) maxv = v;
       }
       i -= (1<<p);
@@ -106,9 +299,106 @@ static uint64_t check (segm S, int64_t i, int64_t sp, int64_t ep,
     lev++;
   }
 
+  Tr.checks += lev; // one iteration per level
+  return maxv;
+}
+
+
+// the same as check, but restricted to sources in the text positions
+// lo..hi, a 2d range: finds the wm nodes whose values are inside the
+// range, starting at level lev with values a.., as in a range search
+static int window (segm S, uint lev, uint64_t a, int64_t sp, int64_t ep,
+		   uint64_t lo, uint64_t hi, uintData val, uint64_t *maxv,
+		   uint *visits)
+
+{ uint64_t span = ((uint64_t)1) << (S->nlevels-lev);
+  uint64_t v;
+  int64_t nsp,nep;
+
+  (*visits)++;
+  if ((sp > ep) || (a > hi) || (a+span-1 < lo)) return 0;
+  if ((lo <= a) && (a+span-1 <= hi)) // the node is inside
+  {
+    if (lev == S->nlevels) v = mapAt(sp);
+    else v = mapAt(cappedMax (S,lev,sp,ep,val));
+    if ((*maxv == nomax) || (D[v] > D[*maxv])) *maxv = v;
+    return D[v] >= val;
+  }
+  nsp = sp; nep = ep;
+  wmTrackLeftRange (S->wm,lev,&nsp,&nep);
+  if (window (S,lev+1,a,nsp,nep,lo,hi,val,maxv,visits)) return 1;
+  wmTrackRightRange (S->wm,lev,&sp,&ep);
+  return window (S,lev+1,a+span/2,sp,ep,lo,hi,val,maxv,visits);
+}
+
+// finds the longest admissible phrase T[i..] with source in T[lo..hi]
+static uint64_t checkWindow (segm S, uint64_t lo, uint64_t hi,
+			     int64_t sp, int64_t ep, uintData val)
+
+{ uint64_t maxv = nomax;
+  uint visits = 0;
+  window (S,0,0,sp,ep,lo,hi,val,&maxv,&visits);
+  Tr.checks += visits;
   return maxv;
 }
 
+// finds the rightmost source in lo..hi among SA[sp..ep] that allows a
+// phrase of length len, starting at level lev with values a.., or nomax
+static uint64_t rightmost (segm S, uint lev, uint64_t a, int64_t sp,
+			   int64_t ep, uint64_t lo, uint64_t hi, uintData len,
+			   uint *visits)
+
+{ uint64_t span = ((uint64_t)1) << (S->nlevels-lev);
+  uint64_t v;
+  int64_t nsp,nep;
+
+  (*visits)++;
+  if ((sp > ep) || (a > hi) || (a+span-1 < lo)) return nomax;
+  if ((lo <= a) && (a+span-1 <= hi)) // inside, discard it if no source
+  {
+    if (lev == S->nlevels) v = mapAt(sp);
+    else v = mapAt(cappedMax (S,lev,sp,ep,len));
+    if (D[v] < len) return nomax;
+    if (lev == S->nlevels) return v;
+  }
+  nsp = sp; nep = ep;
+  wmTrackRightRange (S->wm,lev,&nsp,&nep);
+  v = rightmost (S,lev+1,a+span/2,nsp,nep,lo,hi,len,visits);
+  if (v != nomax) return v;
+  wmTrackLeftRange (S->wm,lev,&sp,&ep);
+  return rightmost (S,lev+1,a,sp,ep,lo,hi,len,visits);
+}
+
+// whether copying T[i..i+len-1] from v leaves the same chain lengths as
+// copying it from s. Self-overlapping copies are periodic
+static bool sameDepths (uint64_t i, uint64_t v, uint64_t s, uint64_t len)
+
+{ uint64_t k;
+  for (k=0;k<len;k++)
+    if (U[v+k%(i-v)] != U[s+k%(i-s)]) return false;
+  return true;
+}
+
+// the rightmost source in lo..hi among SA[sp..ep] that allows the phrase
+// T[i..i+len-1] found from s and leaves the same chain lengths, so that
+// the rest of the parse, and z, are the same as from s. The admissible
+// sources right of s are tried from the right until one qualifies, or s
+// itself is reached
+static uint64_t nearest (uint64_t i, int64_t sp, int64_t ep, uint64_t lo,
+			 uint64_t hi, uintData len, uint64_t s)
+
+{ uint visits = 0;
+  uint64_t v;
+  while (1)
+  { 
+    v = rightmost (S,0,0,sp,ep,lo,hi,len,&visits);
+    if ((v == nomax) || (v <= s)) break;
+    if (sameDepths (i,v,s,len)) { s = v; break; }
+    hi = v-1;
+  }
+  Tr.checks += visits;
+  return s;
+}
 
 // SA[sp..ep] corresponds to T[i..i+len-1], extend by 1 char and 
 // descend the whole stree edge
@@ -117,16 +407,19 @@ uint64_t restrictRange (int64_t sp, int64_t ep, uint64_t i, uint64_t len,
 { 
   int64_t p,m,om;
   byte c,c0 = T[i+len];
+  uint probes = 0;
   while (sp <= ep)
   { 
+    probes++;
     m = (sp+ep)/2;
-    c = T[SA[m]+len];
+    c = T[saAt(m)+len];
     if (c == c0) break; 
     if (c < c0) sp = m+1; 
     else ep = m-1;
   }
   if (sp > ep) 
   { 
+    Tr.probes += probes;
     *nsp = sp; *nep = ep; return len; 
   }
   // char found at m
@@ -134,27 +427,31 @@ uint64_t restrictRange (int64_t sp, int64_t ep, uint64_t i, uint64_t len,
   *nsp = sp;
   while (*nsp < p)
   { 
+    probes++;
     m = (*nsp+p)/2;
-    c = T[SA[m]+len];
+    c = T[saAt(m)+len];
     if (c == c0) p = m; else *nsp = m+1;
   }
   p = om;
   *nep = ep;
   while (*nep > p)
   { 
+    probes++;
     m = (*nep+p+1)/2;
-    c = T[SA[m]+len];
+    c = T[saAt(m)+len];
     if (c == c0) p = m; else *nep = m-1;
   }
+  Tr.probes += probes;
   if (*nsp == *nep) 
-    return n-SA[*nsp]; // stree leaf
+    return n-saAt(*nsp); // stree leaf
   
-  while (T[SA[*nsp]+len] == T[SA[*nep]+len]) len++;
+  while (T[saAt(*nsp)+len] == T[saAt(*nep)+len]) len++;
 
   return len; 
 }
 
-uint64_t nextPhrase (uint64_t i, uint64_t *source)
+// longest admissible phrase T[i..] with source in T[lo..hi]
+uint64_t nextPhrase (uint64_t i, uint64_t lo, uint64_t hi, uint64_t *source)
 { 
   uint64_t n = S->size; // text length
   int64_t sp,ep,nsp,nep;
@@ -166,16 +463,71 @@ uint64_t nextPhrase (uint64_t i, uint64_t *source)
   { 
     l = restrictRange (sp,ep,i,len,&nsp,&nep);
     if (nsp > nep) break; // cannot be extended even to len
-    maxl = check (S,i-1,nsp,nep,l);
+    if (lo > 0) maxl = checkWindow (S,lo,hi,nsp,nep,l);
+    else maxl = check (S,hi,nsp,nep,l);
     if ((maxl == nomax) || (D[maxl] <= len)) break; // has no points 
     *source = maxl; len = D[*source];
     sp = nsp; ep = nep; 
     if (len < l) break; // cannot be extended beyond l
     len = l;
   }
+  if (closest && (len > 0)) // the same phrase from the closest source
+    *source = nearest (i,sp,ep,lo,hi,len,*source);
   return len;
 }
 
+// longest admissible phrase T[i..] with source in T[lo..i-1], where the
+// bound of T[i] is b. With H, each distance class is searched with the
+// structures of its weight, and ties go to the lighter and nearer one
+uint64_t longestPhrase (uint64_t i, uint b, uint64_t lo, uint64_t *source)
+{
+  uint c,wt;
+  int r;
+  uint64_t len,l,s,from,to;
+
+  if ((B == NULL) && (H == NULL)) return nextPhrase (i,lo,i-1,source);
+  if (H == NULL)
+  {
+    r = structure (b,1);
+    D = Db[r]; S = Sb[r];
+    return nextPhrase (i,lo,i-1,source);
+  }
+  len = 0; wt = 0;
+  for (c=0;c<HOPCLASSES;c++) // on ties, the lighter and then the nearest
+  {
+    if (hopDistance(c) > i) continue;
+    r = structure (b,H->weight[c]);
+    if (r < 0) continue;
+    to = i-hopDistance(c);
+    from = hopDistance(c+1)-1 < i ? i-(hopDistance(c+1)-1) : 0;
+    if (from < lo) from = lo;
+    if (from > to) continue;
+    D = Db[r]; S = Sb[r];
+    l = nextPhrase (i,from,to,&s);
+    if ((l > len) || ((l == len) && (H->weight[c] < wt)))
+    {
+      len = l; *source = s; wt = H->weight[c];
+    }
+  }
+  return len;
+}
+
+
+// position k got chain length u: with B or H, it is unusable for all
+// the thresholds up to u
+void unusable (int64_t k, uintData u)
+{
+  uint r,updates = 0;
+  for (r=0;(r<nthr) && (thr[r] <= u);r++)
+    while (lastb[r] < k)
+    {
+      lastb[r]++;
+      Db[r][lastb[r]] = k-lastb[r];
+      segmUpdate(Sb[r],isaAt(lastb[r]),Db[r][lastb[r]]);
+      updates++;
+    }
+  Tr.updates += updates;
+}
 
 // phrase T[i..j] = T[pi..] and T[j] is explicit
 // update D and U. last unusable position was last (can be -1 at first)
@@ -183,28 +535,225 @@ uint64_t nextPhrase (uint64_t i, uint64_t *source)
 int64_t copyPhrase (uint64_t i, uint64_t j, uint64_t pi, int64_t last)
 { 
   int64_t k,s;
+  uint wt = (H != NULL) && (j > i) ? hopWeight(H,i-pi) : 1;
+  uint updates = 0;
   s = pi;
   for (k = i; k < j; k++) 
 	{ 
-    U[k] = U[s]+1;
+    U[k] = U[s]+wt;
 	  s++; if (s == i) s = pi; // for self-overlapping phrases
-	  if (U[k] == MAX) // new unusable position
+	  if ((B != NULL) || (H != NULL)) unusable (k,U[k]);
+	  else if (U[k] == MAX) // new unusable position
 	     while (last < k)
         { 
           last++;
           D[last] = k-last;
-          segmUpdate(S,ISA[last],D[last]);
+          segmUpdate(S,isaAt(last),D[last]);
+          updates++;
         }
-    if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
 	}
 
-  if (k % (1024*1024) == 0) fprintf(stderr,"%li MB\n",k/1024/1024);
-
   U[j] = 0; // explicit char
+  Tr.updates += updates;
 
   return last;
 }
 
+// the parameters a checkpoint must match to be resumed: those of the
+// command line, the bounds and the text, the last two hashed
+#define NPAR (7+HOPCLASSES)
+
+static void parameters (uint64_t *par)
+{
+  uint c;
+  par[0] = n; par[1] = MAX; par[2] = W; par[3] = closest; par[4] = nthr;
+  par[5] = ckptHash (T,n,0);
+  par[6] = 0;
+  if (B != NULL)
+    par[6] = ckptHash (B->bound,B->m*sizeof(uint),
+                       ckptHash (B->start,(B->m+1)*sizeof(uint64_t),0));
+  for (c=0;c<HOPCLASSES;c++) par[7+c] = H != NULL ? H->weight[c] : 0;
+}
+
+// writes the parse state before T[i] to C, in the writer: z phrases so
+// far, the last unusable position, U, and D and S (each of Db and Sb)
+void saveState (checkpoint C, uint64_t i, uint64_t z, int64_t last)
+{
+  uint64_t par[NPAR];
+  uint r,l;
+  segm Sr;
+
+  parameters (par);
+  ckptWrite (C,par,sizeof(par));
+  ckptWrite (C,&i,sizeof(uint64_t));
+  ckptWrite (C,&z,sizeof(uint64_t));
+  ckptWrite (C,&last,sizeof(int64_t));
+  ckptWrite (C,U,n*sizeof(uintData));
+  for (r=0;r<structures();r++)
+  {
+    Sr = (B != NULL) || (H != NULL) ? Sb[r] : S;
+    ckptWrite (C,Sr->data,n*sizeof(uintData));
+    for (l=0;l<Sr->nlevels;l++)
+      ckptWrite (C,Sr->dirs[l],((2*Sr->size+w-2)/w)*sizeof(uint64_t));
+    if ((B != NULL) || (H != NULL)) ckptWrite (C,&lastb[r],sizeof(int64_t));
+  }
+  ckptEnd (C);
+}
+
+// reads the parse state saved by saveState
+void loadState (checkpoint C, uint64_t *i, uint64_t *z, int64_t *last)
+{
+  uint64_t par[NPAR];
+  uint r,l;
+  segm Sr;
+
+  parameters (par);
+  ckptCheck (C,par,sizeof(par));
+  ckptOutput (C);
+  ckptRead (C,i,sizeof(uint64_t));
+  ckptRead (C,z,sizeof(uint64_t));
+  ckptRead (C,last,sizeof(int64_t));
+  ckptRead (C,U,n*sizeof(uintData));
+  for (r=0;r<structures();r++)
+  {
+    Sr = (B != NULL) || (H != NULL) ? Sb[r] : S;
+    ckptRead (C,Sr->data,n*sizeof(uintData));
+    for (l=0;l<Sr->nlevels;l++)
+      ckptRead (C,Sr->dirs[l],((2*Sr->size+w-2)/w)*sizeof(uint64_t));
+    if ((B != NULL) || (H != NULL)) ckptRead (C,&lastb[r],sizeof(int64_t));
+  }
+}
+
+// phrase T[i..i+len] = T[source..] was parsed and copied with the work in
+// Tr: puts it in the trace and starts counting the next one. The depth of
+// the source is the largest chain length of the positions copied, before
+// T[i]
+static void tracePhrase (uint64_t i, uint64_t len, uint64_t source)
+{
+  uint64_t k;
+  Tr.pos = i; Tr.len = len; Tr.source = len ? source : 0; Tr.depth = 0;
+  for (k=source;(k<source+len) && (k<i);k++)
+    if (U[k] > Tr.depth) Tr.depth = U[k];
+  tracePut(Trace,&Tr);
+  Tr.checks = Tr.probes = Tr.updates = Tr.ancestors = 0;
+}
+
+// parses T[i..] after z phrases, with last unusable position last, and
+// gives the number of phrases. They are printed unless quiet and added
+// to A unless NULL, and checkpoints are taken in C unless NULL. With
+// Trace, the work of each phrase is traced
+uint64_t parse (uint64_t i, uint64_t z, int64_t last, checkpoint C,
+                archive A, bool quiet)
+{
+  uint64_t len,source,r = 0,k;
+
+  if (i == 0) // 1st phrase hardcoded to avoid border cases
+  {
+    if (!quiet) printf("(0,0,%d)\n", T[0]);
+    if (A != NULL) arcAdd(A,0,0,T[0]);
+    last = copyPhrase (0,0,0,last);
+    if (Trace != NULL) tracePhrase (0,0,0);
+    i = 1; z = 1;
+  }
+
+  while (i < n)
+  { 
+    if ((C != NULL) && ckptDue(C) && ckptBegin(C)) saveState(C,i,z,last);
+    if (B != NULL) r = boundsFind(B,i);
+    len = longestPhrase(i,B != NULL ? B->bound[r] : MAX,
+                        W && (i > W) ? i-W : 0,&source);
+    if (B != NULL) // cut it before a tighter bound
+      for (k=r+1;(k<B->m) && (B->start[k]<i+len);k++)
+        if (B->bound[k] < B->bound[r])
+        {
+          len = B->start[k]-i;
+          break;
+        }
+    if (!quiet)
+    {
+      if(len == 0) printf("(0,0,%d)\n", T[i]);
+      else printf("(%d,%d,%d)\n", source, len, T[i+len]);
+    }
+    if (A != NULL) arcAdd(A,source,len,T[i+len]);
+    last = copyPhrase (i,i+len,source,last);
+    if (Trace != NULL) tracePhrase (i,len,source);
+    i += len+1;
+    z++;
+    progSet(Prog,i,z);
+  }
+  return z;
+}
+
+#define LATQUERIES 100000 // extractions timed for each maxchain
+#define LATSEED 1 // of their positions, the same for all maxchains
+
+// parses again with maxchain mc, into a new archive, and measures it:
+// gives its largest chain length in top and its extraction time with
+// queries of len bytes in lat, in us per byte. Reports it in stderr and
+// in curve unless NULL
+archive probe (uint64_t mc, uint64_t len, FILE *curve, uint64_t *top,
+               double *lat)
+{
+  archive A = arcCreate();
+  uint64_t i,bytes;
+  FILE *f;
+
+  perfStage(Perf,"segmCreate");
+  for (i=0;i<n;i++) D[i] = n;
+  segmDestroy(S);
+  S = segmCreate(M,D,Map);
+  thresholds(mc);
+  perfStage(Perf,"parse");
+  parse(0,0,-1,NULL,A,true);
+  perfStage(Perf,"latency");
+  *top = 0;
+  for (i=0;i<n;i++) if (U[i] > *top) *top = U[i];
+  *lat = arcLatency(A,len,LATQUERIES,LATSEED);
+  f = tmpfile();
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot create a temporary file\n");
+    exit(1);
+  }
+  bytes = arcSave(A,f,ARCBLOCK,0);
+  fclose(f);
+  fprintf(stderr,"maxchain %li: %li phrases, %li bytes packed, "
+          "%.4f us per byte\n",mc,A->z,bytes,*lat);
+  if (curve != NULL)
+    fprintf(curve,"%li\t%li\t%li\t%.4f\n",mc,A->z,bytes,*lat);
+  perfStage(Perf,NULL);
+  return A;
+}
+
+// finds the largest maxchain up to maxChain whose parse extracts queries
+// of len bytes in at most target us per byte, doubling maxchain while it
+// does and then bisecting, as the time grows with maxchain. Gives the
+// parse and its maxchain in chosen, or NULL if not even maxchain 1 does
+archive autoChain (uint64_t maxChain, double target, uint64_t len,
+                   FILE *curve, uint64_t *chosen)
+{
+  archive A,best = NULL;
+  uint64_t lo = 0,hi = maxChain+1,mc,top;
+  double lat;
+
+  while (hi-lo > 1)
+  {
+    if (hi > maxChain) mc = lo ? min(2*lo,maxChain) : 1;
+    else mc = lo+(hi-lo)/2;
+    A = probe(mc,len,curve,&top,&lat);
+    if (lat > target)
+    {
+      arcDestroy(A);
+      hi = mc;
+      continue;
+    }
+    if (best != NULL) arcDestroy(best);
+    best = A; lo = mc;
+    if (top < mc) break; // larger maxchains give the same parse
+  }
+  *chosen = lo;
+  return best;
+}
 
 bool file_exists (char *filename) {
   struct stat   buffer;   
@@ -213,39 +762,167 @@ bool file_exists (char *filename) {
 
 void main (int argc, char **argv)
 {
-  uint64_t z,i,len,source;
+  uint64_t z,i;
   int64_t last = -1;
   struct stat st;
   FILE *f;
   char fname[1024];
+  archive V = NULL; // phrases kept for --verify
+  char *depths; // file for --depths
+  char *dist; // value of --max-distance
+  char *map; // file for --bounds
+  char *hops; // value of --hop-cost
+  char *ckpt; // file for --checkpoint
+  char *every; // value of --checkpoint-every
+  char *resume; // file for --resume
+  char *mem; // value of --mem-limit
+  uint64_t limit = 0; // bytes of --mem-limit, 0 for none
+  char *latency; // value of --latency
+  char *qlen; // value of --query-len
+  char *curve; // file for --curve
+  char *tfile; // file for --trace
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  int est; // --estimate
+  archive A; // the parse chosen by --latency
+  memplan P;
+  uint plan;
+  checkpoint C = NULL; // for --checkpoint, NULL if none
+  checkpoint R = NULL; // for --resume, NULL if none
+  uint64_t maxc;
   char fnameSA[1024];
 
+  if (argFlag(&argc,argv,"--verify")) V = arcCreate();
+  depths = argOption(&argc,argv,"--depths");
+  dist = argOption(&argc,argv,"--max-distance");
+  if (dist != NULL) W = atol(dist);
+  closest = argFlag(&argc,argv,"--closest");
+  map = argOption(&argc,argv,"--bounds");
+  hops = argOption(&argc,argv,"--hop-cost");
+  if (hops != NULL) H = hopParse(hops);
+  ckpt = argOption(&argc,argv,"--checkpoint");
+  every = argOption(&argc,argv,"--checkpoint-every");
+  resume = argOption(&argc,argv,"--resume");
+  mem = argOption(&argc,argv,"--mem-limit");
+  if (mem != NULL) limit = memParse(mem);
+  if (argFlag(&argc,argv,"--perf")) Perf = perfCreate();
+  latency = argOption(&argc,argv,"--latency");
+  qlen = argOption(&argc,argv,"--query-len");
+  curve = argOption(&argc,argv,"--curve");
+  tfile = argOption(&argc,argv,"--trace");
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
+  est = argFlag(&argc,argv,"--estimate");
+  if ((latency != NULL) && ((map != NULL) || (H != NULL) ||
+                            (ckpt != NULL) || (resume != NULL) ||
+                            (tfile != NULL)))
+  {
+    fprintf(stderr,"--latency cannot be combined with --bounds, "
+            "--hop-cost, --checkpoint, --resume or --trace\n");
+    exit(1);
+  }
+  if ((resume != NULL) && (V != NULL))
+  {
+    fprintf(stderr,"--verify cannot check a resumed parse\n");
+    exit(1);
+  }
+
   if (argc < 2)
   { 
-    fprintf(stderr,"Usage: %s <filename> [<maxchain>]\n"
+    fprintf(stderr,"Usage: %s <filename> [<maxchain>] [--verify] "
+    "[--depths <file>] [--max-distance <W>] [--closest] [--bounds <file>]\n"
+    "[--hop-cost <w0,w1,w2,w3>] [--checkpoint <file>] "
+    "[--checkpoint-every <s>] [--resume <file>] [--mem-limit <size>]\n"
+    "[--latency <us> [--query-len <len>] [--curve <file>]] [--perf]\n"
+    "[--trace <file>] [--progress <s>] [--status <file>] "
+    "[--status-socket <path>] [--estimate]\n"
     "There must exist <filename>.sa as well\n"
           "No maxchain uses infinity and yields the max chain\n"
-    "Redirect output to save/discard tuples\n\n",argv[0]);
+    "--verify checks the parse in memory after producing it\n"
+    "--depths writes the chain length of each position to <file>\n"
+    "--max-distance copies each phrase from at most <W> positions back\n"
+    "--closest copies each phrase from its closest source among those\n"
+    "  leaving the same chain lengths, so z does not change\n"
+    "--bounds reads lines <start> <end> <maxchain> from <file>, bounding\n"
+    "  the chains of T[start..end-1]; maxchain bounds the rest\n"
+    "--hop-cost makes a hop cost w0..w3 for distances < 64, < 4096,\n"
+    "  < 2MB and beyond, instead of 1, and maxchain bounds the cost\n"
+    "--checkpoint saves the parse state to <file> every <s> seconds\n"
+    "  (600 by default), and --resume continues from it. The output\n"
+    "  must go to a file, reopened with >> when resuming\n"
+    "--mem-limit uses the fastest plan whose estimated memory fits in\n"
+    "  <size> (like 512M or 8G), computing Map, ISA and SA from the\n"
+    "  wavelet matrix as needed, or fails at once if none fits\n"
+    "--latency outputs the parse of the largest maxchain (up to the given\n"
+    "  one) that extracts random substrings of <len> bytes (1 by default)\n"
+    "  in at most <us> microseconds per byte, and --curve writes the\n"
+    "  phrases, packed bytes and latency of each maxchain tried to <file>\n"
+    "--perf reports cycles, instructions, cache, TLB and branch misses and\n"
+    "  page faults of each stage, where the hardware and kernel allow\n"
+    "--trace writes the work of each phrase to <file>, see tracestat\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "--estimate prints the peak memory of the plan the run would use, in\n"
+    "  bytes, as peak = <bytes>, without reading the text\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],PROGEVERY);
     exit(1);
   }
 
   fprintf(stderr,"Reading text and suffix array files... "); fflush(stderr);
 
+  perfStage(Perf,"text load");
+
   strcpy (fname,argv[1]);
   strcpy (fnameSA,argv[1]);
   strcat(fnameSA,".sa");
-  stat(fname,&st);
-  n = st.st_size;
+  if (stat(fname,&st) != 0)
+  { 
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  n = st.st_size+1; // with the final \0
+
+  maxc = argc == 2 ? n : atoi(argv[2]);
+  if (map != NULL) B = boundsLoad(map,n,maxc);
+  thresholds(maxc);
+
+	// the fastest plan that fits in the limit, if any, chosen before
+	// reading the text so that --estimate and a failure cost nothing
+  for (plan=0;plan<PLANS;plan++)
+  {
+    P = estimate(plan,n);
+    if ((limit == 0) || (memPeak(P) <= limit)) break;
+    if (plan+1 < PLANS) memDestroy(P);
+  }
+  if (plan == PLANS)
+  {
+    fprintf(stderr,"\n");
+    memReport(P);
+    fprintf(stderr,"Error: the leanest plan needs %.1f MB, above the limit "
+            "of %.1f MB\n",memPeak(P)/1048576.0,limit/1048576.0);
+    exit(1);
+  }
+  if (est)
+  {
+    fprintf(stderr,"\n");
+    memReport(P);
+    printf("peak = %li\n",memPeak(P));
+    exit(0);
+  }
+
   f = fopen(fname,"r");
   if (f == NULL)
   { 
     fprintf(stderr,"Cannot open %s\n",fname);
     exit(1);
   }
-  T = myalloc(n+1);
-  fread (T,1,n,f);
+  T = myalloc(n);
+  fread (T,1,n-1,f);
   fclose(f);
-  T[n] = 0; 
+  T[n-1] = 0; 
 
   if (!file_exists(fnameSA)) 
   {
@@ -260,53 +937,85 @@ void main (int argc, char **argv)
     }
   }
 
-  strcat(fname,".sa");
-  f = fopen(fname,"r");
-  if (f == NULL)
-  { 
-    fprintf(stderr,"Cannot open %s\n",fname);
-    exit(1);
+  if (plan < PLANISA)
+  {
+    perfStage(Perf,"SA load");
+    SA = readSA(fnameSA,n);
+    ISA = myalloc(n*sizeof(uintData));
+    for (i=0;i<n;i++) ISA[SA[i]] = i;
   }
-  SA = myalloc((n+1)*sizeof(uintData));
-  SA[0] = n; // simulate the final \0, kkp does not add it
-  fread (SA+1,sizeof(uintData),n,f);
-  fclose(f);
-  n++;
-
-  ISA = myalloc(n*sizeof(uintData));
-  for (i=0;i<n;i++) ISA[SA[i]] = i;
 
+  perfStage(Perf,NULL);
   fprintf(stderr,"done\n");
 
-  initialize(n,argc == 2 ? n : atoi(argv[2]));
-
-	// recover SA after wm construction, to save space
-  SA = myalloc(n*sizeof(uintData));
-  for (i=0;i<n;i++) SA[ISA[i]] = i; 
+  memReport(P);
+  memDestroy(P);
+  initialize(n,plan,fnameSA);
 
 	// parsing
 
   fprintf(stderr,"Parsing starts, n = %li\n",n); 
 
-	// 1st phrase hardcoded to avoid border cases
-
-  fprintf(stderr,"File %s, n = %li, parsed with maxchain = %i\n\n", argv[1],n,MAX);
   // printf ("(%i = '%c')\n",T[0],T[0]);
-  printf("n = %d\n", n);  // print n
-  printf("(0,0,%d)\n", T[0]);
-  copyPhrase (0,0,0,last);
-  i = 1; z = 1;
-  
-  while (i < n)
-  { 
-    len = nextPhrase(i,&source);
-    if(len == 0) printf("(0,0,%d)\n", T[i]);
-    else printf("(%d,%d,%d)\n", source, len, T[i+len]);
-    last = copyPhrase (i,i+len,source,last);
-    i += len+1;
-    z++;
+  if (latency != NULL) // the parse of the chosen maxchain, not printed
+  {
+    FILE *cf = NULL;
+    if (curve != NULL)
+    {
+      cf = fopen(curve,"w");
+      if (cf == NULL)
+      { 
+        fprintf(stderr,"Cannot open %s\n",curve);
+        exit(1);
+      }
+      fprintf(cf,"# maxchain\tphrases\tpacked_bytes\tus_per_byte\n");
+    }
+    A = autoChain(maxc,atof(latency),qlen != NULL ? atol(qlen) : 1,cf,&maxc);
+    perfStage(Perf,"output");
+    if (cf != NULL) fclose(cf);
+    if (A == NULL)
+    {
+      fprintf(stderr,"Error: even maxchain 1 is slower than %s us per "
+              "byte\n",latency);
+      exit(1);
+    }
+    fprintf(stderr,"File %s, n = %li, chosen maxchain = %li\n\n",
+            argv[1],n,maxc);
+    MAX = maxc; z = A->z;
+    arcPrint(A,stdout);
+    myfree(U); U = arcDepths(A); // of the chosen parse
+    if (V != NULL) { arcDestroy(V); V = A; }
+  }
+  else
+  {
+    fprintf(stderr,"File %s, n = %li, parsed with maxchain = %i\n\n",
+            argv[1],n,MAX);
+    if (ckpt != NULL)
+      C = ckptCreate(ckpt,ckptEvery(every));
+    if (resume != NULL) // the output and the state from the checkpoint
+    {
+      R = ckptOpen(resume);
+      loadState(R,&i,&z,&last);
+      ckptClose(R);
+      fprintf(stderr,"Resuming from %s at position %li\n",resume,i);
+    }
+    else
+    {
+      printf("n = %d\n", n);  // print n
+      i = 0; z = 0;
+    }
+    if (tfile != NULL) Trace = traceCreate(tfile,n-1,MAX);
+    Prog = progCreate(n,i,z,prog != NULL ? atof(prog) : PROGEVERY,status,
+                      sock);
+    perfStage(Perf,"parse");
+    z = parse(i,z,last,C,V,false);
+    perfStage(Perf,"output");
+    progDestroy(Prog);
+    if (Trace != NULL) traceDestroy(Trace);
   }
   printf("\nz = %li phrases\n",z);
+  fflush(stdout);
+  if (C != NULL) ckptDestroy(C,1); // the parse is complete
   fprintf(stderr,"\n\nz = %li phrases\n",z);
   if (argc == 2)
   { 
@@ -315,5 +1024,10 @@ void main (int argc, char **argv)
     fprintf(stderr,"Maximum chain length = %li\n",u);
   }
   fprintf(stderr,"\n");
+  if (depths != NULL) depthStore(depths,U,n,MAX);
+  perfReport(Perf,n-1);
+  if ((V != NULL) && !verifyParse(V,T,n,H != NULL ? n : MAX,0)) exit(1);
+  if ((V != NULL) && (H != NULL) && !hopCheck(V,H,B,MAX)) exit(1);
+  if ((V != NULL) && (H == NULL) && (B != NULL) && !boundsCheck(B,U)) exit(1);
   exit(0);
 }
@@ -0,0 +1,93 @@
+
+	// supports a chain cost where each hop costs a weight that depends
+	// on its distance
+
+#include "hopcost.h"
+
+static uint64_t first[HOPCLASSES+1] =
+   { 1, HOPLINE, HOPPAGE, HOPHUGE, ~(uint64_t)0 };
+
+	// reads the weights of the classes from "w0,w1,w2,w3"
+
+hopcost hopParse (char *spec)
+
+   { hopcost H = myalloc(sizeof(struct s_hopcost));
+     int c;
+     if ((sscanf(spec,"%u,%u,%u,%u",&H->weight[0],&H->weight[1],&H->weight[2],
+		 &H->weight[3]) != HOPCLASSES))
+	{ fprintf(stderr,"Error: hop weights must be w0,w1,w2,w3 for "
+			 "distances < %i, < %i, < %i and beyond\n",
+			 HOPLINE,HOPPAGE,HOPHUGE);
+	  exit(1);
+	}
+     for (c=0;c<HOPCLASSES;c++)
+	if (H->weight[c] == 0)
+	   { fprintf(stderr,"Error: hop weights must be at least 1\n");
+	     exit(1);
+	   }
+     return H;
+   }
+
+	// destroys H
+
+void hopDestroy (hopcost H)
+
+   { myfree(H);
+   }
+
+	// gives the smallest distance of class c
+
+uint64_t hopDistance (uint c)
+
+   { return first[c];
+   }
+
+	// gives the weight of a hop of distance d >= 1
+
+uint hopWeight (hopcost H, uint64_t d)
+
+   { uint c = 0;
+     while (d >= first[c+1]) c++;
+     return H->weight[c];
+   }
+
+	// gives the cost of each position of the text parsed by A
+
+uintData *hopCosts (archive A, hopcost H)
+
+   { uint64_t j,p,t,s;
+     uint wt = 0;
+     uintData *C = myalloc(A->n*sizeof(uintData));
+     for (p=0;p<A->r;p++) C[p] = 0;
+     for (j=0;j<A->z;j++)
+	{ p = A->start[j]; s = A->source[j];
+	  if (A->len[j]) wt = hopWeight(H,p-s);
+	  for (t=0;t<A->len[j];t++)
+	      C[p+t] = C[s + t % (p-s)] + wt;
+	  C[p+A->len[j]] = 0;
+	}
+     return C;
+   }
+
+	// checks that the costs of A are at most the bounds of B, or at most
+	// maxcost if B is NULL
+
+int hopCheck (archive A, hopcost H, bounds B, uint64_t maxcost)
+
+   { uintData *C = hopCosts(A,H);
+     uint64_t p,u = 0;
+     int ok = 1;
+     fprintf(stderr,"Costs... "); fflush(stderr);
+     for (p=0;p<A->n;p++)
+	{ if (C[p] > u) u = C[p];
+	  if (C[p] > (B != NULL ? boundsAt(B,p) : maxcost))
+	     { fprintf(stderr,"wrong: cost %u > %u at T[%li]\n",C[p],
+		       B != NULL ? boundsAt(B,p) : (uint)maxcost,p);
+	       ok = 0;
+	       break;
+	     }
+	}
+     if (ok) fprintf(stderr,"ok, max cost %li\n",u);
+     myfree(C);
+     return ok;
+   }
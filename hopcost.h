@@ -0,0 +1,48 @@
+
+#ifndef INCLUDEDhopcost
+#define INCLUDEDhopcost
+
+	// supports a chain cost where each hop costs a weight that depends
+	// on its distance, instead of 1: a hop within a cache line is about
+	// free, but one beyond a page or a huge page is a fault on a mapped
+	// archive. The cost of a copied position is that of its source plus
+	// the weight of the distance from the phrase to its source
+
+	// the distances are split in HOPCLASSES classes, and the weights are
+	// given as "w0,w1,w2,w3", all of them >= 1 so that chains are still
+	// bounded
+
+#include "archive.h"
+#include "bounds.h"
+
+#define HOPCLASSES 4
+#define HOPLINE 64 // the first distance of each class beyond the first
+#define HOPPAGE 4096
+#define HOPHUGE (2*1024*1024)
+
+typedef struct s_hopcost {
+    uint weight[HOPCLASSES]; // the weight of each class
+    } *hopcost;
+
+	// reads the weights of the classes from "w0,w1,w2,w3". Exits with
+	// an error if spec is wrong
+hopcost hopParse (char *spec);
+
+	// destroys H
+void hopDestroy (hopcost H);
+
+	// gives the smallest distance of class c, so class c covers the
+	// distances hopDistance(c)..hopDistance(c+1)-1, for c < HOPCLASSES
+uint64_t hopDistance (uint c);
+
+	// gives the weight of a hop of distance d >= 1
+uint hopWeight (hopcost H, uint64_t d);
+
+	// gives the cost of each position of the text parsed by A
+uintData *hopCosts (archive A, hopcost H);
+
+	// checks that the costs of A are at most the bounds of B, or at most
+	// maxcost if B is NULL, reporting in stderr. Gives 1 if so, else 0
+int hopCheck (archive A, hopcost H, bounds B, uint64_t maxcost);
+
+#endif
@@ -0,0 +1,284 @@
+
+	// supports counting and locating patterns on a BAT-LZ parse
+
+#include <string.h>
+
+#include "lzindex.h"
+
+#define K 4 // space/time tradeoff for bitmaps
+
+static byte *sT; // text and archive, for the sorting comparisons
+static archive sA;
+
+	// explicit position of phrase j
+
+static inline uint64_t explicit (archive A, uint64_t j)
+
+   { return A->start[j] + A->len[j];
+   }
+
+	// compares T[..e] read backwards, shorter first
+
+static int xcmp (const void *a, const void *b)
+
+   { int64_t e1 = explicit(sA,*(uintData*)a);
+     int64_t e2 = explicit(sA,*(uintData*)b);
+     while ((e1 >= 0) && (e2 >= 0))
+	{ if (sT[e1] != sT[e2]) return sT[e1] < sT[e2] ? -1 : 1;
+	  e1--; e2--;
+	}
+     if (e1 >= 0) return 1;
+     if (e2 >= 0) return -1;
+     return 0;
+   }
+
+	// compares T[e+1..], shorter first
+
+static int ycmp (const void *a, const void *b)
+
+   { uint64_t e1 = explicit(sA,*(uintData*)a)+1;
+     uint64_t e2 = explicit(sA,*(uintData*)b)+1;
+     while ((e1 < sA->n) && (e2 < sA->n))
+	{ if (sT[e1] != sT[e2]) return sT[e1] < sT[e2] ? -1 : 1;
+	  e1++; e2++;
+	}
+     if (e1 < sA->n) return 1;
+     if (e2 < sA->n) return -1;
+     return 0;
+   }
+
+static int scmp (const void *a, const void *b)
+
+   { uint64_t s1 = sA->source[*(uintData*)a];
+     uint64_t s2 = sA->source[*(uintData*)b];
+     return s1 < s2 ? -1 : s1 > s2;
+   }
+
+	// builds the index of A, which must be kept
+	// the text is decompressed once to sort the explicit chars
+
+lzindex idxCreate (archive A)
+
+   { uint64_t i,j;
+     uintData *data,*yrank;
+     lzindex I = myalloc(sizeof(struct s_lzindex));
+     I->A = A;
+     I->z = A->z;
+     sT = myalloc(A->n);
+     arcExtract(A,0,A->n,sT);
+     sA = A;
+	// the two orders of the explicit chars
+     I->xorder = myalloc(I->z*sizeof(uintData));
+     I->yorder = myalloc(I->z*sizeof(uintData));
+     for (j=0;j<I->z;j++) I->xorder[j] = I->yorder[j] = j;
+     qsort(I->xorder,I->z,sizeof(uintData),xcmp);
+     qsort(I->yorder,I->z,sizeof(uintData),ycmp);
+     myfree(sT);
+	// the grid
+     yrank = myalloc(I->z*sizeof(uintData));
+     for (i=0;i<I->z;i++) yrank[I->yorder[i]] = i;
+     data = myalloc(I->z*sizeof(uintData));
+     for (i=0;i<I->z;i++) data[i] = yrank[I->xorder[i]];
+     myfree(yrank);
+     I->grid = wmCreate(I->z,numbits(I->z-1),data,K);
+     myfree(data);
+	// the sources, with a max tree of their ends
+     I->nsrc = 0;
+     for (j=0;j<I->z;j++) if (A->len[j]) I->nsrc++;
+     I->sorder = myalloc(I->nsrc*sizeof(uintData));
+     I->sources = myalloc(I->nsrc*sizeof(uint64_t));
+     i = 0;
+     for (j=0;j<I->z;j++) if (A->len[j]) I->sorder[i++] = j;
+     qsort(I->sorder,I->nsrc,sizeof(uintData),scmp);
+     for (i=0;i<I->nsrc;i++) I->sources[i] = A->source[I->sorder[i]];
+     I->top = 1;
+     while (I->top < I->nsrc) I->top *= 2;
+     I->maxend = myalloc(2*I->top*sizeof(uint64_t));
+     for (i=0;i<I->top;i++)
+	{ if (i < I->nsrc)
+	     { j = I->sorder[i]; I->maxend[I->top+i] = A->source[j]+A->len[j]; }
+	  else I->maxend[I->top+i] = 0;
+	}
+     for (i=I->top-1;i>0;i--)
+	I->maxend[i] = max(I->maxend[2*i],I->maxend[2*i+1]);
+     return I;
+   }
+
+	// destroys I, not its archive
+
+void idxDestroy (lzindex I)
+
+   { myfree(I->xorder);
+     myfree(I->yorder);
+     wmDestroy(I->grid);
+     myfree(I->sorder);
+     myfree(I->sources);
+     myfree(I->maxend);
+     myfree(I);
+   }
+
+	// gives space of index in w-bit words, not counting its archive
+
+uint64_t idxSpace (lzindex I)
+
+   { return (sizeof(struct s_lzindex) + 2*I->z*sizeof(uintData) +
+	     I->nsrc*(sizeof(uintData)+sizeof(uint64_t)) +
+	     2*I->top*sizeof(uint64_t))/(w/8) + wmSpace(I->grid);
+   }
+
+	// compares T[..e] backwards with P[0..k] backwards, 0 if the latter
+	// is a prefix of the former. buf has room for k+1 chars
+
+static int xsearch (lzindex I, uint64_t j, byte *P, uint64_t k, byte *buf)
+
+   { uint64_t e = explicit(I->A,j);
+     uint64_t l = min(k+1,e+1);
+     uint64_t t;
+     arcExtract(I->A,e+1-l,l,buf);
+     for (t=0;t<l;t++)
+	 if (buf[l-1-t] != P[k-t]) return buf[l-1-t] < P[k-t] ? -1 : 1;
+     return l < k+1 ? -1 : 0;
+   }
+
+	// compares T[e+1..] with Q[0..m-1], 0 if the latter is a prefix of the
+	// former. buf has room for m chars
+
+static int ysearch (lzindex I, uint64_t j, byte *Q, uint64_t m, byte *buf)
+
+   { uint64_t e = explicit(I->A,j)+1;
+     uint64_t l = min(m,I->A->n-e);
+     uint64_t t;
+     arcExtract(I->A,e,l,buf);
+     for (t=0;t<l;t++)
+	 if (buf[t] != Q[t]) return buf[t] < Q[t] ? -1 : 1;
+     return l < m ? -1 : 0;
+   }
+
+	// range [*sp,*ep] of order[] whose strings have the pattern as
+	// a prefix, empty if *sp > *ep
+
+static void range (lzindex I, uintData *order, int x, byte *P, uint64_t m,
+		   byte *buf, int64_t *sp, int64_t *ep)
+
+   { int64_t l,r,c;
+     l = 0; r = I->z; // first with cmp >= 0
+     while (l < r)
+	{ c = (l+r)/2;
+	  if ((x ? xsearch(I,order[c],P,m-1,buf)
+		 : ysearch(I,order[c],P,m,buf)) < 0) l = c+1;
+	  else r = c;
+	}
+     *sp = l;
+     r = I->z; // first with cmp > 0
+     while (l < r)
+	{ c = (l+r)/2;
+	  if ((x ? xsearch(I,order[c],P,m-1,buf)
+		 : ysearch(I,order[c],P,m,buf)) <= 0) l = c+1;
+	  else r = c;
+	}
+     *ep = l-1;
+   }
+
+	// a growing list of occurrences
+
+typedef struct {
+    uint64_t *occ;
+    uint64_t size,n;
+    } occlist;
+
+static void addOcc (occlist *L, uint64_t p)
+
+   { if (L->n == L->size)
+	{ L->size *= 2;
+	  L->occ = myrealloc(L->occ,L->size*sizeof(uint64_t));
+	}
+     L->occ[L->n++] = p;
+   }
+
+	// reports the points in grid rows [sp,ep] of level l, whose values
+	// are lo..lo+2^(levels-l)-1, with value in [y1,y2]. Those whose
+	// phrase has copied length >= k are primary occurrences at e-k
+
+static void primary (lzindex I, uint l, int64_t sp, int64_t ep, uint64_t lo,
+		     uint64_t y1, uint64_t y2, uint64_t k, occlist *L)
+
+   { uint64_t span,j;
+     int64_t nsp,nep;
+     wmatrix M = I->grid;
+     span = ((uint64_t)1) << (M->nlevels-l);
+     if ((sp > ep) || (lo+span-1 < y1) || (lo > y2)) return;
+     if (l == M->nlevels)
+	{ j = I->yorder[lo];
+	  if (I->A->len[j] >= k) addOcc(L,explicit(I->A,j)-k);
+	  return;
+	}
+     nsp = sp; nep = ep;
+     wmTrackLeftRange(M,l,&nsp,&nep);
+     primary(I,l+1,nsp,nep,lo,y1,y2,k,L);
+     nsp = sp; nep = ep;
+     wmTrackRightRange(M,l,&nsp,&nep);
+     primary(I,l+1,nsp,nep,lo+span/2,y1,y2,k,L);
+   }
+
+	// reports the copies of T[p..p+m-1]: phrases among the first r in
+	// source order, under node, whose source ends at p+m or later
+
+static void secondary (lzindex I, uint64_t node, uint64_t from, uint64_t span,
+		       uint64_t r, uint64_t p, uint64_t m, occlist *L)
+
+   { uint64_t j;
+     if ((from >= r) || (I->maxend[node] < p+m)) return;
+     if (span == 1)
+	{ j = I->sorder[from];
+	  addOcc(L,I->A->start[j] + (p - I->A->source[j]));
+	  return;
+	}
+     secondary(I,2*node,from,span/2,r,p,m,L);
+     secondary(I,2*node+1,from+span/2,span/2,r,p,m,L);
+   }
+
+	// gives the number of occurrences of P[0..m-1] and allocates and
+	// writes their text positions in *occ, in no particular order
+
+uint64_t idxLocate (lzindex I, byte *P, uint64_t m, uint64_t **occ)
+
+   { occlist L;
+     uint64_t k,i,l,r,c;
+     int64_t xsp,xep,ysp,yep;
+     byte *buf;
+     L.size = 16; L.n = 0;
+     L.occ = myalloc(L.size*sizeof(uint64_t));
+     if (m == 0) { *occ = L.occ; return 0; }
+     buf = myalloc(m);
+	// primary occurrences, one split of P per char
+     for (k=0;k<m;k++)
+	{ range(I,I->xorder,1,P,k+1,buf,&xsp,&xep);
+	  if (xsp > xep) continue;
+	  if (k+1 < m) range(I,I->yorder,0,P+k+1,m-k-1,buf,&ysp,&yep);
+	  else { ysp = 0; yep = I->z-1; }
+	  if (ysp > yep) continue;
+	  primary(I,0,xsp,xep,0,ysp,yep,k,&L);
+	}
+     myfree(buf);
+	// secondary occurrences, from the sources that cover each one
+     for (i=0;i<L.n;i++)
+	{ l = 0; r = I->nsrc; // first source > occ
+	  while (l < r)
+	     { c = (l+r)/2;
+	       if (I->sources[c] <= L.occ[i]) l = c+1; else r = c;
+	     }
+	  secondary(I,1,0,I->top,l,L.occ[i],m,&L);
+	}
+     *occ = L.occ;
+     return L.n;
+   }
+
+	// gives the number of occurrences of P[0..m-1]
+
+uint64_t idxCount (lzindex I, byte *P, uint64_t m)
+
+   { uint64_t *occ;
+     uint64_t c = idxLocate(I,P,m,&occ);
+     myfree(occ);
+     return c;
+   }
@@ -0,0 +1,51 @@
+
+#ifndef INCLUDEDlzindex
+#define INCLUDEDlzindex
+
+	// supports counting and locating patterns on a BAT-LZ parse
+
+	// an occurrence of P is primary if it contains an explicit char; its
+	// leftmost one, at some e = start+len, splits P into a suffix of
+	// T[..e] and a prefix of T[e+1..]. The explicit chars are sorted by
+	// reversed prefix (x) and by following suffix (y), and the points
+	// (x,y) are a permutation stored in a wavelet matrix, where each
+	// split is a 2d range query. The rest of the occurrences are inside
+	// a copy, so they are found from the occurrences of their sources
+
+	// the sorted orders are searched binary, extracting the strings from
+	// the archive, which costs at most maxchain hops per char
+
+#include "archive.h"
+#include "wmatrix.h"
+
+typedef struct s_lzindex {
+    archive A; // the parse, pointed to
+    uint64_t z; // number of explicit chars (= phrases)
+    uintData *xorder; // phrases sorted by reversed text up to their char
+    uintData *yorder; // phrases sorted by text after their char
+    wmatrix grid; // y rank of the phrase at each x rank
+    uint64_t nsrc; // number of phrases with a copy
+    uintData *sorder; // phrases with a copy, sorted by source
+    uint64_t *sources; // sorted sources, for binary search
+    uint64_t top; // leaves in the max tree, a power of 2
+    uint64_t *maxend; // max tree of source+len over sorder
+    } *lzindex;
+
+	// builds the index of A, which must be kept
+
+lzindex idxCreate (archive A);
+
+	// destroys I, not its archive
+void idxDestroy (lzindex I);
+
+	// gives space of index in w-bit words, not counting its archive
+uint64_t idxSpace (lzindex I);
+
+	// gives the number of occurrences of P[0..m-1]
+uint64_t idxCount (lzindex I, byte *P, uint64_t m);
+
+	// gives the number of occurrences of P[0..m-1] and allocates and
+	// writes their text positions in *occ, in no particular order
+uint64_t idxLocate (lzindex I, byte *P, uint64_t m, uint64_t **occ);
+
+#endif
@@ -0,0 +1,91 @@
+
+	// supports estimating the memory of a run before allocating it
+
+#include "memplan.h"
+
+	// creates an empty plan
+
+memplan memCreate (char *name)
+
+   { memplan P = myalloc(sizeof(struct s_memplan));
+     P->name = name;
+     P->m = 0;
+     return P;
+   }
+
+	// destroys P
+
+void memDestroy (memplan P)
+
+   { myfree(P);
+   }
+
+	// adds an item to P
+
+void memAdd (memplan P, char *what, uint64_t bytes, uint phases)
+
+   { if (P->m == MEMITEMS)
+	{ fprintf(stderr,"Error: more than %i items in memory plan %s\n",
+		  MEMITEMS,P->name);
+	  exit(1);
+	}
+     P->what[P->m] = what;
+     P->bytes[P->m] = bytes;
+     P->phases[P->m] = phases;
+     P->m++;
+   }
+
+	// gives the total of P in the given phase
+
+static uint64_t total (memplan P, uint phase)
+
+   { uint64_t t = 0;
+     uint i;
+     for (i=0;i<P->m;i++)
+	if (P->phases[i] & phase) t += P->bytes[i];
+     return t;
+   }
+
+	// gives the peak bytes of P
+
+uint64_t memPeak (memplan P)
+
+   { return max(total(P,MEMBUILD),total(P,MEMPARSE));
+   }
+
+	// writes P to stderr
+
+void memReport (memplan P)
+
+   { uint i;
+     fprintf(stderr,"Memory plan %s: peak %.1f MB (building %.1f MB, "
+		    "parsing %.1f MB)\n",P->name,memPeak(P)/1048576.0,
+	     total(P,MEMBUILD)/1048576.0,total(P,MEMPARSE)/1048576.0);
+     for (i=0;i<P->m;i++)
+	fprintf(stderr,"  %10.1f MB  %s%s\n",P->bytes[i]/1048576.0,P->what[i],
+		P->phases[i] == MEMBUILD ? " (building)" :
+		P->phases[i] == MEMPARSE ? " (parsing)" : "");
+   }
+
+	// reads a size like 512M or 8G
+
+uint64_t memParse (char *s)
+
+   { char *end;
+     double v = strtod(s,&end);
+     uint64_t unit = 1024*1024;
+     if ((end != s) && (*end != 0) && (end[1] == 0))
+	switch (*end)
+	   { case 'K': case 'k': unit = 1024; end++; break;
+	     case 'M': case 'm': unit = 1024*1024; end++; break;
+	     case 'G': case 'g': unit = 1024*1024*1024; end++; break;
+	     case 'T': case 't': unit = ((uint64_t)1024)*1024*1024*1024;
+			       end++; break;
+	   }
+     if ((end == s) || (*end != 0) || (v <= 0))
+	{ fprintf(stderr,"Error: memory limit %s should be like 512M or "
+			 "8G\n",s);
+	  exit(1);
+	}
+     return v*unit;
+   }
@@ -0,0 +1,45 @@
+
+#ifndef INCLUDEDmemplan
+#define INCLUDEDmemplan
+
+	// supports estimating the memory of a run before allocating it, so
+	// that it can choose a leaner plan, or fail at once, when it would
+	// not fit in a given limit. A plan is a list of items, each live
+	// while building the structures, while parsing, or both, and its
+	// peak is the largest total of either phase
+
+#include "basics.h"
+
+#define MEMITEMS 16
+
+#define MEMBUILD 1 // the phases where an item is live
+#define MEMPARSE 2
+
+typedef struct s_memplan {
+    char *name; // of the plan
+    uint m; // number of items
+    char *what[MEMITEMS]; // description of each item
+    uint64_t bytes[MEMITEMS]; // its size
+    uint phases[MEMITEMS]; // the phases where it is live
+    } *memplan;
+
+	// creates an empty plan
+memplan memCreate (char *name);
+
+	// destroys P
+void memDestroy (memplan P);
+
+	// adds an item of the given bytes to P, live in the given phases
+void memAdd (memplan P, char *what, uint64_t bytes, uint phases);
+
+	// gives the peak bytes of P
+uint64_t memPeak (memplan P);
+
+	// writes P, with its items, to stderr
+void memReport (memplan P);
+
+	// reads a size like 512M or 8G (K, M, G and T are powers of 1024,
+	// and no suffix means M). Exits with an error if s is wrong
+uint64_t memParse (char *s);
+
+#endif
@@ -72,6 +72,11 @@ of (1) points only to (2).
 #include "stdio.h"
 #include "string.h"
 #include "suffix_tree.h"
+#include "verify.h"
+#include "depth.h"
+#include "perfstat.h"
+#include "trace.h"
+#include "progress.h"
 
 DBL_WORD    ST_ERROR;
 
@@ -92,6 +97,16 @@ typedef enum LAST_POS_TYPE {last_char_in_edge, other_char} LAST_POS_TYPE;
 DBL_WORD counter;
 /* Used for statistic measures of space. */
 DBL_WORD heap;
+/* Hardware counters per stage, for --perf. NULL if not counting. */
+perfstat Perf = NULL;
+/* Per-phrase trace, for --trace. NULL if not tracing. */
+trace Trace = NULL;
+/* The work of the current phrase, added up once per search call. */
+tracerec Tr;
+/* Progress reports, NULL if not reporting, and the values of --progress,
+   --status and --status-socket. */
+progress Prog = NULL;
+char *progEvery = NULL, *progStatus = NULL, *progSock = NULL;
 /* Used to mark the node that has no suffix link yet. By Ukkonen, it will have
    one by the end of the current phase. */
 NODE*    suffixless;
@@ -137,8 +152,8 @@ typedef struct SUFFIXTREEPOS
 
 NODE* create_node(NODE* father, DBL_WORD start, DBL_WORD end, DBL_WORD position)
 {
-   /*Allocate a node.*/
-   NODE* node   = (NODE*)malloc(sizeof(NODE));
+   /*Allocate a node, with its annotation.*/
+   NODE* node   = (NODE*)malloc(sizeof(NODE)+sizeof(BLZA));
    if(node == 0)
    {
       printf("\nOut of memory.\n");
@@ -146,7 +161,7 @@ NODE* create_node(NODE* father, DBL_WORD start, DBL_WORD end, DBL_WORD position)
    }
 
 #ifdef STATISTICS
-   heap+=sizeof(NODE);
+   heap+=sizeof(NODE)+sizeof(BLZA);
 #endif
 
    /* Initialize node fields. For detailed description of the fields see
@@ -530,6 +545,63 @@ NODE* trace_string(
    return node;
 }
 
+/******************************************************************************/
+/*
+   boundOf :
+   The chain bound of text position textPos, counted from 1: that of the
+   bounds map, or COST without one.
+*/
+
+unsigned int boundOf(SUFFIX_TREE* tree, DBL_WORD textPos)
+{
+   return tree->bounds != NULL ? boundsAt(tree->bounds, textPos-1) : tree->COST;
+}
+
+/******************************************************************************/
+/*
+   findRecent :
+   Goes on with the search of ST_FindSubstring from node, with j chars of W
+   matched, when the best source of node is out of the window. Each node is
+   followed with its most recent occurrence, the closest to W, which is
+   copied as long as its costs are below the bound of W. A node has no
+   more recent occurrence than its father, so the search ends at the first
+   node whose occurrence is out of the window. Gives the longest of best
+   and the phrases found.
+*/
+
+MATCH findRecent(SUFFIX_TREE* tree, NODE* node, unsigned char* W, DBL_WORD P,
+                 DBL_WORD j, MATCH best)
+{
+   DBL_WORD k, node_label_end, src, len;
+   DBL_WORD textPos = W - tree->tree_string;
+   unsigned int bound = boundOf(tree, textPos);
+   while(node != 0)
+   {
+      if(node->sons == NULL)
+         src = node->annot[0].minMax != -1 ? node->path_position : 0;
+      else src = node->annot[0].recentPos;
+      if(src == 0 || src + tree->maxDist < textPos) return best;
+      k = node->edge_label_start;
+      node_label_end = get_node_label_end(tree,node);
+      while(j<P && k<=node_label_end && tree->tree_string[k] == W[j])
+      {
+         j++;
+         k++;
+      }
+      /* Self-overlapping copies take their costs periodically */
+      for(len = 0; len < j; len++)
+         if(tree->costArray[src + len % (textPos-src)] >= bound) break;
+      if(len > best.length)
+      {
+         best.length = len;
+         best.pos = src;
+      }
+      if(j == P || k <= node_label_end) return best;
+      node = find_son(tree, node, W[j]);
+   }
+   return best;
+}
+
 /******************************************************************************/
 /*
    ST_FindSubstring :
@@ -551,16 +623,25 @@ MATCH ST_FindSubstring(
    MATCH currentMatch;
    currentMatch.length = 0;
    currentMatch.pos = 0;
+   /* The annotations keep the exact minimum of the maximum costs below
+      COST, so a tighter bound at W only stops the search earlier */
+   unsigned int bound = boundOf(tree, W - tree->tree_string);
 
    /* Scan nodes down from the root untill a leaf is reached or the substring is
       found */
    while(node!=0)
    {
-      if(node->annot.optimisticMinMax == -1)
+      if(node->annot[0].optimisticMinMax == -1)
       {
       	return currentMatch;
       }
-      if(node->annot.optimisticMinMax == tree->COST)
+      /* The best source is too far back, go on with the closest ones */
+      if(tree->maxDist != 0 &&
+         node->annot[0].optimisticTextPos + tree->maxDist < (DBL_WORD)(W - tree->tree_string))
+      {
+      	return findRecent(tree, node, W, P, j, currentMatch);
+      }
+      if(node->annot[0].optimisticMinMax >= bound)
       {
       	if(node->sons != NULL) return currentMatch;
       }
@@ -586,9 +667,9 @@ MATCH ST_FindSubstring(
       // }
       
       currentMatch.length = j;
-      if(node->annot.optimisticTextPos != 0)
+      if(node->annot[0].optimisticTextPos != 0)
       {
-      	currentMatch.pos = node->annot.optimisticTextPos;
+      	currentMatch.pos = node->annot[0].optimisticTextPos;
       }
       else
       {
@@ -620,7 +701,7 @@ NODE *getMinMaxOfChildren(NODE *node)
    NODE* currentSon = node->sons;
    while(currentSon != NULL)
    {
-       if(resultSon->annot.optimisticMinMax > currentSon->annot.optimisticMinMax)
+       if(resultSon->annot[0].optimisticMinMax > currentSon->annot[0].optimisticMinMax)
        {
            resultSon = currentSon;
        }
@@ -629,6 +710,16 @@ NODE *getMinMaxOfChildren(NODE *node)
    return resultSon;
 }
 
+/* Whether copying len chars from a or from b leaves the same chain lengths,
+   so that the rest of the parse, and z, do not depend on the choice */
+static int sameDepths(unsigned int a, unsigned int b, unsigned int len, SUFFIX_TREE* tree)
+{
+   unsigned int k;
+   for(k = 0; k < len; k++)
+      if(tree->costArray[a+k] != tree->costArray[b+k]) return 0;
+   return 1;
+}
+
 void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int len, unsigned int minMaxOfRange, unsigned int distToC, SUFFIX_TREE* tree)
 {
    NODE * leaf = tree->inversePointers[textPos];
@@ -637,40 +728,49 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
    // 	if(leaf->annot.distToC > distToC)
    // 	   leaf->annot.distToC = distToC;
    // }
-   if(minMaxOfRange > leaf->annot.minMax || leaf->annot.minMax == -1)
+   if(minMaxOfRange > leaf->annot[0].minMax || leaf->annot[0].minMax == -1)
    {
-	   leaf->annot.minMax = minMaxOfRange;
-	   leaf->annot.optimisticMinMax = minMaxOfRange;
+	   leaf->annot[0].minMax = minMaxOfRange;
+	   leaf->annot[0].optimisticMinMax = minMaxOfRange;
    }
    NODE *parent = leaf->father;
+   unsigned int ancestors = 0;
    while(parent != NULL && (int)parent->strDepth > len)
    {
+      ancestors++;
    	NODE *newMinMaxHolder = getMinMaxOfChildren(parent);
    	
-   	unsigned int oldOptimisticMinMax = parent->annot.optimisticMinMax; 
+   	unsigned int oldOptimisticMinMax = parent->annot[0].optimisticMinMax; 
    	if(textPos + parent->strDepth - 1 <= finalPos)
    	{ 
+         if(textPos > parent->annot[0].recentPos) parent->annot[0].recentPos = textPos;
          unsigned cost = tree->costArray[cappedMax(tree->segm,textPos,textPos+parent->strDepth-1,tree->COST)];
+         /* A source that fell out of the window is replaced by any other */
+         int stale = tree->maxDist != 0 && parent->annot[0].textPos + tree->maxDist <= finalPos;
+         /* Among equally good sources, the one closer to the phrase, if it
+            leaves the same chain lengths */
+         int closer = tree->closest && textPos > parent->annot[0].textPos;
 // antes, usaca leaf->annot.optimisticMinMax como cost para decidir si asignarlo
 // y luego asignaba el cappedMax
-         if(parent->annot.minMax > cost)
+         if(parent->annot[0].minMax > cost || stale || (closer && parent->annot[0].minMax == cost &&
+            sameDepths(textPos, parent->annot[0].textPos, parent->strDepth, tree)))
    	   {
-		      parent->annot.minMax = cost;
-   	   	parent->annot.textPos = textPos;
+		      parent->annot[0].minMax = cost;
+   	   	parent->annot[0].textPos = textPos;
    	   }
    	}
-   	if(newMinMaxHolder->annot.optimisticMinMax < parent->annot.minMax)
+   	if(newMinMaxHolder->annot[0].optimisticMinMax < parent->annot[0].minMax)
    	{
-   		parent->annot.optimisticMinMax = newMinMaxHolder->annot.optimisticMinMax;
-   		parent->annot.optimisticTextPos = newMinMaxHolder->annot.optimisticTextPos;
+   		parent->annot[0].optimisticMinMax = newMinMaxHolder->annot[0].optimisticMinMax;
+   		parent->annot[0].optimisticTextPos = newMinMaxHolder->annot[0].optimisticTextPos;
    	}
    	else
    	{
-   		parent->annot.optimisticMinMax = parent->annot.minMax;
-   		parent->annot.optimisticTextPos = parent->annot.textPos; 
+   		parent->annot[0].optimisticMinMax = parent->annot[0].minMax;
+   		parent->annot[0].optimisticTextPos = parent->annot[0].textPos; 
    	}
 
-	   int newOptimisticMinMax = parent->annot.optimisticMinMax;
+	   int newOptimisticMinMax = parent->annot[0].optimisticMinMax;
    	parent = parent->father;
 	// este fix de arriba puede funcionar, pero no se si es lo mejor
 	// la leaf no tiene el mejor valor, lo tiene el hijo, por su RMQ
@@ -679,6 +779,7 @@ void changeAnnotationFromLeaf(unsigned int textPos, unsigned int finalPos, int l
 	// version que no funcionaba:
 	// if(parent == NULL || (leaf->annot.optimisticMinMax >= parent->annot.minMax && (oldOptimisticMinMax == newOptimisticMinMax))) return;
    }  
+   Tr.ancestors += ancestors;
 }
 
 
@@ -706,22 +807,161 @@ void propagateAnnotation(unsigned int textPos, unsigned int len, SUFFIX_TREE* tr
 }
 
 
-int parseBLZ(SUFFIX_TREE *tree)
+/******************************************************************************/
+/*
+   Checkpoints :
+   The parse state before textPos is the number z of phrases, the cost
+   array with the segm over it, and the annotations of the nodes. These
+   are kept in DFS order, in chunks of CKPTNODES, as the tree is built
+   again on resume.
+*/
+
+#define CKPTNODES 65536
+
+static BLZA ckptBuffer[CKPTNODES];
+static DBL_WORD ckptFill, ckptNext, ckptLeft;
+
+DBL_WORD countNodes(NODE *node)
+{
+   DBL_WORD count = 0;
+   while(node != 0)
+   {
+      count += 1 + countNodes(node->sons);
+      node = node->right_sibling;
+   }
+   return count;
+}
+
+/* Saves (or restores) the annotations of node, its sons and its right
+   siblings through the chunk buffer */
+void ckptAnnotations(NODE *node, checkpoint C, int save)
+{
+   while(node != 0)
+   {
+      if(save)
+      {
+         ckptBuffer[ckptFill++] = node->annot[0];
+         if(ckptFill == CKPTNODES)
+         {
+            ckptWrite(C, ckptBuffer, ckptFill*sizeof(BLZA));
+            ckptFill = 0;
+         }
+      }
+      else
+      {
+         if(ckptNext == ckptFill)
+         {
+            ckptFill = ckptLeft < CKPTNODES ? ckptLeft : CKPTNODES;
+            ckptRead(C, ckptBuffer, ckptFill*sizeof(BLZA));
+            ckptLeft -= ckptFill;
+            ckptNext = 0;
+         }
+         node->annot[0] = ckptBuffer[ckptNext++];
+      }
+      ckptAnnotations(node->sons, C, save);
+      node = node->right_sibling;
+   }
+}
+
+/* The parameters a checkpoint must match to be resumed: those of the
+   command line, the bounds and the text, the last two hashed */
+#define NPAR (7+HOPCLASSES)
+
+void ckptParameters(SUFFIX_TREE *tree, DBL_WORD *par)
+{
+   int c;
+   par[0] = tree->length; par[1] = tree->COST; par[2] = tree->maxDist;
+   par[3] = tree->closest; par[4] = countNodes(tree->root);
+   par[5] = ckptHash(tree->tree_string+1, tree->length, 0);
+   par[6] = 0;
+   if(tree->bounds != NULL)
+      par[6] = ckptHash(tree->bounds->bound, tree->bounds->m*sizeof(uint),
+                        ckptHash(tree->bounds->start, (tree->bounds->m+1)*sizeof(uint64_t), 0));
+   for(c = 0; c < HOPCLASSES; c++)
+      par[7+c] = tree->hops != NULL ? tree->hops->weight[c] : 0;
+}
+
+/* In the writer of C, saves the state and exits */
+void saveState(SUFFIX_TREE *tree, checkpoint C, unsigned int textPos, int z)
+{
+   DBL_WORD par[NPAR];
+   ckptParameters(tree, par);
+   ckptWrite(C, par, sizeof(par));
+   ckptWrite(C, &textPos, sizeof(unsigned int));
+   ckptWrite(C, &z, sizeof(int));
+   ckptWrite(C, tree->costArray, (tree->length+1)*sizeof(unsigned int));
+   ckptWrite(C, tree->segm->dirs, ((2*tree->segm->size+w-2)/w)*sizeof(uint64_t));
+   ckptFill = 0;
+   ckptAnnotations(tree->root, C, 1);
+   if(ckptFill > 0) ckptWrite(C, ckptBuffer, ckptFill*sizeof(BLZA));
+   ckptEnd(C);
+}
+
+/* Restores the state saved by saveState */
+void loadState(SUFFIX_TREE *tree, checkpoint C, unsigned int *textPos, int *z)
+{
+   DBL_WORD par[NPAR];
+   ckptParameters(tree, par);
+   ckptCheck(C, par, sizeof(par));
+   ckptOutput(C);
+   ckptRead(C, textPos, sizeof(unsigned int));
+   ckptRead(C, z, sizeof(int));
+   ckptRead(C, tree->costArray, (tree->length+1)*sizeof(unsigned int));
+   ckptRead(C, tree->segm->dirs, ((2*tree->segm->size+w-2)/w)*sizeof(uint64_t));
+   ckptFill = ckptNext = 0;
+   ckptLeft = par[4];
+   ckptAnnotations(tree->root, C, 0);
+}
+
+/* The phrase at textPos, of length len and copied from pos, was parsed
+   with the work in Tr: puts it in the trace, with text positions from 0,
+   and starts counting the next one. The depth of the source is the
+   largest cost among the positions copied before textPos. */
+void tracePhrase(SUFFIX_TREE *tree, unsigned int textPos, unsigned int len, unsigned int pos)
+{
+   unsigned int k;
+   Tr.pos = textPos-1;
+   Tr.len = len;
+   Tr.source = len > 0 ? pos-1 : 0;
+   Tr.depth = 0;
+   for(k = pos; len > 0 && k < pos+len && k < textPos; k++)
+      if(tree->costArray[k] > Tr.depth) Tr.depth = tree->costArray[k];
+   tracePut(Trace, &Tr);
+   Tr.checks = Tr.probes = Tr.updates = Tr.ancestors = 0;
+}
+
+int parseBLZ(SUFFIX_TREE *tree, checkpoint C, checkpoint R)
 {
    unsigned int textPos = 1;
    int z = 0;
-   printf("n = %d\n",tree->length);
+   if(R != NULL)
+      loadState(tree, R, &textPos, &z);
+   else printf("n = %d\n",tree->length);
+   Prog = progCreate(tree->length, textPos-1, z,
+                     progEvery != NULL ? atof(progEvery) : PROGEVERY,
+                     progStatus, progSock);
    while(textPos <= tree->length)
    {
+      if(C != NULL && ckptDue(C) && ckptBegin(C))
+         saveState(tree, C, textPos, z);
       MATCH currentPhrase = ST_FindSubstring(tree, (unsigned char*)tree->tree_string + textPos, tree->length);
       z++;
       unsigned int k = 0, i;
-   if (textPos/1024/1024 != (textPos+currentPhrase.length+1)/1024/1024)
-   {  
-      fprintf(stderr,"%i MB\n",(textPos+currentPhrase.length+1)/1024/1024); }
+      /* Each hop costs the weight of its distance, 1 without hop costs */
+      unsigned int wt = 1;
+      if(tree->hops != NULL && currentPhrase.length > 0)
+         wt = hopWeight(tree->hops, textPos - currentPhrase.pos);
       for(i = 0; i < currentPhrase.length; i++)
       {
-      	tree->costArray[textPos+i] = tree->costArray[currentPhrase.pos + k] + 1;
+         /* The phrase is cut before a position with a tighter bound, or
+            where a heavy hop would exceed it */
+         if((tree->bounds != NULL || wt > 1) &&
+            tree->costArray[currentPhrase.pos + k] + wt > boundOf(tree, textPos+i))
+         {
+            currentPhrase.length = i;
+            break;
+         }
+      	tree->costArray[textPos+i] = tree->costArray[currentPhrase.pos + k] + wt;
          // printf("costArray[%i] = %i\n", textPos+i, tree->costArray[textPos+i]);
          segmUpdate(tree->segm,textPos+i,tree->costArray[textPos+i]);
          if (tree->costArray[textPos+i] > tree->COST) 
@@ -732,12 +972,20 @@ int parseBLZ(SUFFIX_TREE *tree)
       tree->costArray[textPos+currentPhrase.length] = 0;
       // printf("costArray[%i] = %i\n", textPos+currentPhrase.length, tree->costArray[textPos+currentPhrase.length]);
       segmUpdate(tree->segm,textPos+currentPhrase.length,0);
+      Tr.updates += currentPhrase.length+1; // one per position
       propagateAnnotation(textPos, currentPhrase.length, tree);
+      if(Trace != NULL)
+         tracePhrase(tree, textPos, currentPhrase.length, currentPhrase.pos);
       
       textPos = textPos+currentPhrase.length+1;
+      progSet(Prog, textPos-1, z);
       printf("(%d,%d,%d)\n", currentPhrase.pos-1, currentPhrase.length, (unsigned)tree->tree_string[textPos-1]);
+      if(tree->phrases != NULL)
+         arcAdd(tree->phrases, currentPhrase.pos-1, currentPhrase.length, tree->tree_string[textPos-1]);
    }
+   progDestroy(Prog);
    printf("\n\nz = %i phrases\n",z);
+   fflush(stdout);
    /* unsigned int j;
    for(j = 1; j < textPos; j++)
    {
@@ -1046,22 +1294,23 @@ void SPA(
 
 unsigned dfsForInversePointers(NODE * node, SUFFIX_TREE *tree, unsigned int depth)
 { unsigned num = 0;
-	node->annot.minMax = -1;
-	node->annot.optimisticMinMax = -1;
+	node->annot[0].minMax = -1;
+	node->annot[0].optimisticMinMax = -1;
+	node->annot[0].recentPos = 0;
 	// node->annot.distToC = -1;
 	node->strDepth = depth;
 	if(node->sons == NULL)
 	{
 		tree->inversePointers[node->path_position] = node;
 		tree->maxStrDepth[node->path_position] = node->path_position + node->father->strDepth - 1;
-   		node->annot.optimisticTextPos = node->path_position;
-   		node->annot.textPos = node->path_position;
+   		node->annot[0].optimisticTextPos = node->path_position;
+   		node->annot[0].textPos = node->path_position;
    		num++;
 	}
 	else
 	{
-		node->annot.textPos = 0;
-		node->annot.optimisticTextPos = 0;
+		node->annot[0].textPos = 0;
+		node->annot[0].optimisticTextPos = 0;
 		NODE *currentChild = node->sons;
 		while(currentChild != NULL)
 		{
@@ -1114,12 +1363,19 @@ SUFFIX_TREE* ST_CreateTree(unsigned char* str, DBL_WORD length)
    }
    heap+=sizeof(SUFFIX_TREE);
    tree->inversePointers = malloc(sizeof(NODE *) * (length + 2));
-   tree->costArray = malloc(sizeof(unsigned short int) * (length + 2));
+   tree->costArray = malloc(sizeof(*tree->costArray) * (length + 2));
    tree->maxStrDepth = malloc(sizeof(unsigned int) * (length + 2));
    { int i;
      for (i=0;i<=length+1;i++) tree->costArray[i] = length+1;
    }
+   perfStage(Perf,"segmCreate");
    tree->segm = segmCreate(tree->costArray,length+1);
+   perfStage(Perf,"ST_CreateTree");
+   tree->phrases = NULL;
+   tree->maxDist = 0;
+   tree->closest = 0;
+   tree->bounds = NULL;
+   tree->hops = NULL;
 
    /* Calculating string length (with an ending $ sign) */
    tree->length         = length+1;
@@ -1363,6 +1619,25 @@ DBL_WORD ST_SelfTest(SUFFIX_TREE* tree)
 }
 
 
+/******************************************************************************/
+/*
+   estimate :
+   Estimates the memory of parsing a text of length len, with the suffix
+   tree at its largest: 2 nodes per position, each with a malloc header.
+*/
+
+memplan estimate(DBL_WORD len)
+{
+   memplan P = memCreate("suffix tree");
+   DBL_WORD n = len+1; /* with the final $ */
+   memAdd(P, "text", n, MEMBUILD|MEMPARSE);
+   memAdd(P, "suffix tree nodes", 2*n*(((sizeof(NODE)+sizeof(BLZA)+8+15)/16)*16), MEMBUILD|MEMPARSE);
+   memAdd(P, "leaf pointers", (n+1)*sizeof(NODE*), MEMBUILD|MEMPARSE);
+   memAdd(P, "costs and maximum depths", 2*(n+1)*sizeof(unsigned int), MEMBUILD|MEMPARSE);
+   memAdd(P, "chain structure", segmSpaceFor(n)*sizeof(uint64_t), MEMBUILD|MEMPARSE);
+   return P;
+}
+
 int main(int argc, char* argv[])
 {
 	SUFFIX_TREE* tree;
@@ -1370,8 +1645,32 @@ int main(int argc, char* argv[])
 	FILE* file = 0;
 	DBL_WORD i,z,len = 0;
 
+	int verify = argFlag(&argc,argv,"--verify");
+	char *depths = argOption(&argc,argv,"--depths");
+	char *dist = argOption(&argc,argv,"--max-distance");
+	int closest = argFlag(&argc,argv,"--closest");
+	char *map = argOption(&argc,argv,"--bounds");
+	char *hops = argOption(&argc,argv,"--hop-cost");
+	char *ckpt = argOption(&argc,argv,"--checkpoint");
+	char *every = argOption(&argc,argv,"--checkpoint-every");
+	char *resume = argOption(&argc,argv,"--resume");
+	checkpoint C = NULL, R = NULL;
+	char *mem = argOption(&argc,argv,"--mem-limit");
+	if(argFlag(&argc,argv,"--perf")) Perf = perfCreate();
+	char *tfile = argOption(&argc,argv,"--trace");
+	progEvery = argOption(&argc,argv,"--progress");
+	progStatus = argOption(&argc,argv,"--status");
+	progSock = argOption(&argc,argv,"--status-socket");
+	int est = argFlag(&argc,argv,"--estimate");
+	uint64_t limit = mem != NULL ? memParse(mem) : 0;
+	memplan P;
+
 	if(argc < 3) {
-	   fprintf(stderr,"Usage: %s <filename> <maxc>\n",argv[0]); 
+	   fprintf(stderr,"Usage: %s <filename> <maxc> [--verify] [--depths <file>] [--max-distance <W>] [--closest] [--bounds <file>] [--hop-cost <w0,w1,w2,w3>] [--checkpoint <file>] [--checkpoint-every <s>] [--resume <file>] [--mem-limit <size>] [--perf] [--trace <file>] [--progress <s>] [--status <file>] [--status-socket <path>] [--estimate]\n",argv[0]); 
+	   exit(1);
+	}
+	if(verify && resume != NULL) {
+	   fprintf(stderr,"--verify cannot check a resumed parse\n");
 	   exit(1);
 	}
    filename = argv[1];
@@ -1386,6 +1685,22 @@ int main(int argc, char* argv[])
    fseek(file, 0, SEEK_END);
    len = ftell(file);
    fseek(file, 0, SEEK_SET);
+   P = estimate(len);
+   memReport(P);
+   if(est)
+   {
+      printf("peak = %lu\n", memPeak(P));
+      exit(0);
+   }
+   if(limit != 0 && memPeak(P) > limit)
+   {
+      fprintf(stderr,"Error: the suffix tree needs %.1f MB, above the limit of %.1f MB; "
+                     "greedy_BATLZ --mem-limit can parse in less\n",
+              memPeak(P)/1048576.0, limit/1048576.0);
+      exit(1);
+   }
+   memDestroy(P);
+   perfStage(Perf,"text load");
    str = (unsigned char*)malloc((len+1)*sizeof(unsigned char));
    if(str == 0)
    {
@@ -1406,9 +1721,19 @@ int main(int argc, char* argv[])
    str[len] = 0;
 
 	fprintf(stderr,"Constructing tree...\n");
+	perfStage(Perf,"ST_CreateTree");
 	tree = ST_CreateTree(str,len); // it appends the 0 anyway
+	perfStage(Perf,NULL);
 	fprintf(stderr,"Parsing...\n");
    tree->COST = atoi(argv[2]);
+   if(dist != NULL) tree->maxDist = atol(dist);
+   tree->closest = closest;
+   if(map != NULL)
+   {
+      tree->bounds = boundsLoad(map, tree->length, tree->COST);
+      tree->COST = boundsMax(tree->bounds);
+   }
+   if(hops != NULL) tree->hops = hopParse(hops);
 	char *filename_cost = (char*)malloc(strlen(filename)+45);
 	strcpy(filename_cost,filename);
 	char *strCost = (char *)malloc(sizeof(char)*10);
@@ -1417,8 +1742,23 @@ int main(int argc, char* argv[])
 	strcat(filename_cost,strCost);
 	strcat(filename_cost,".cost");
 	fprintf(stderr, "filename_cost: %s\n",filename_cost);
-	z = parseBLZ(tree);
+	if(verify) tree->phrases = arcCreate();
+	if(ckpt != NULL) C = ckptCreate(ckpt, ckptEvery(every));
+	if(resume != NULL) R = ckptOpen(resume);
+	if(tfile != NULL) Trace = traceCreate(tfile, len, tree->COST);
+	perfStage(Perf,"parse");
+	z = parseBLZ(tree, C, R);
+	perfStage(Perf,"output");
+	if(Trace != NULL) traceDestroy(Trace);
+	fflush(stdout);
+	if(R != NULL) ckptClose(R);
+	if(C != NULL) ckptDestroy(C, 1); // the parse is complete
 	fprintf(stderr,"%i phrases\n",z);
+	if(depths != NULL) depthStore(depths,tree->costArray+1,tree->length,tree->COST);
+	perfReport(Perf,len);
+	if(verify && !verifyParse(tree->phrases,str,len+1,hops != NULL ? len+1 : tree->COST,0)) exit(1);
+	if(verify && hops != NULL && !hopCheck(tree->phrases,tree->hops,tree->bounds,tree->COST)) exit(1);
+	if(verify && hops == NULL && map != NULL && !boundsCheck(tree->bounds,tree->costArray+1)) exit(1);
 	
 	free(str);
    free(filename_cost);
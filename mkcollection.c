@@ -0,0 +1,55 @@
+#include <string.h>
+
+// concatenates many documents into one text to parse, writing the
+// document starts next to it
+
+#include "collection.h"
+
+void main (int argc, char **argv)
+{
+  char **fnames,line[4096];
+  uint64_t ndocs,size;
+
+  if (argc < 2)
+  {
+    fprintf(stderr,"Usage: %s <collection_file> [<file_1> ... <file_k>]\n"
+    "Writes the files to <collection_file>, each followed by a separator,\n"
+    "and their starts to <collection_file>.docs. If the files use all the\n"
+    "chars, the separator escapes its own occurrences and the 0s\n"
+    "With no files, reads one file name per line from stdin\n"
+    "Then parse <collection_file> with any variant\n\n",argv[0]);
+    exit(1);
+  }
+
+  if (argc > 2)
+  {
+    fnames = argv+2;
+    ndocs = argc-2;
+  }
+  else
+  {
+    size = 1024; ndocs = 0;
+    fnames = myalloc(size*sizeof(char*));
+    while (fgets(line,sizeof(line),stdin) != NULL)
+    {
+      line[strcspn(line,"\n")] = 0;
+      if (line[0] == 0) continue;
+      if (ndocs == size)
+      {
+        size *= 2;
+        fnames = myrealloc(fnames,size*sizeof(char*));
+      }
+      fnames[ndocs] = myalloc(strlen(line)+1);
+      strcpy(fnames[ndocs++],line);
+    }
+  }
+  if (ndocs == 0)
+  {
+    fprintf(stderr,"No documents given\n");
+    exit(1);
+  }
+
+  colBuild(argv[1],fnames,ndocs);
+  fprintf(stderr,"%li documents written to %s\n",ndocs,argv[1]);
+  exit(0);
+}
@@ -0,0 +1,142 @@
+
+	// supports counting hardware events per stage of a run, with
+	// perf_event_open
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "perfstat.h"
+
+static struct { char *name; uint32_t type; uint64_t config; }
+   event[PERFEVENTS] =
+   { { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+     { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+     { "LLC misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+	  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+     { "dTLB misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+	  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+	  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+     { "branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+     { "page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS }
+   };
+
+static double now (void)
+
+   { struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC,&t);
+     return t.tv_sec + t.tv_nsec/1e9;
+   }
+
+	// opens the counters, warning about those not available
+
+perfstat perfCreate (void)
+
+   { perfstat P = myalloc(sizeof(struct s_perfstat));
+     struct perf_event_attr attr;
+     uint e,none = 0;
+     for (e=0;e<PERFEVENTS;e++)
+	{ memset(&attr,0,sizeof(attr));
+	  attr.size = sizeof(attr);
+	  attr.type = event[e].type;
+	  attr.config = event[e].config;
+	  attr.exclude_kernel = 1; // allowed with perf_event_paranoid 2
+	  attr.exclude_hv = 1;
+		// with more events than counters, the kernel multiplexes
+	  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			     PERF_FORMAT_TOTAL_TIME_RUNNING;
+	  P->fd[e] = syscall(SYS_perf_event_open,&attr,0,-1,-1,0);
+	  if (P->fd[e] < 0)
+	     { fprintf(stderr,"%s %s",none++ ? "," : "Warning: cannot count",
+		       event[e].name);
+	     }
+	}
+     if (none) fprintf(stderr,", reported as n/a\n");
+     P->ns = 0;
+     P->cur = -1;
+     return P;
+   }
+
+	// reads counter e, scaled if it was multiplexed
+
+static uint64_t value (perfstat P, uint e)
+
+   { uint64_t v[3]; // value, time enabled, time running
+     if ((P->fd[e] < 0) || (read(P->fd[e],v,sizeof(v)) != sizeof(v)))
+	return 0;
+     if ((v[2] == 0) || (v[2] == v[1])) return v[0];
+     return (uint64_t)((double)v[0]*v[1]/v[2]);
+   }
+
+	// ends the current stage and starts stage name
+
+void perfStage (perfstat P, char *name)
+
+   { uint e,s;
+     double t;
+     if (P == NULL) return;
+     t = now();
+     if (P->cur >= 0)
+	{ for (e=0;e<PERFEVENTS;e++)
+	     P->count[P->cur][e] += value(P,e) - P->start[e];
+	  P->time[P->cur] += t - P->t0;
+	}
+     P->cur = -1;
+     if (name == NULL) return;
+     for (s=0;(s<P->ns) && strcmp(P->name[s],name);s++);
+     if (s == P->ns)
+	{ if (s == PERFSTAGES)
+	     { fprintf(stderr,"Warning: too many stages, %s not counted\n",
+		       name);
+	       return;
+	     }
+	  P->name[s] = name;
+	  for (e=0;e<PERFEVENTS;e++) P->count[s][e] = 0;
+	  P->time[s] = 0;
+	  P->ns++;
+	}
+     P->cur = s;
+     for (e=0;e<PERFEVENTS;e++) P->start[e] = value(P,e);
+     P->t0 = now();
+   }
+
+	// prints v in a column, or n/a if event e is not available
+
+static void column (perfstat P, uint e, double v)
+
+   { if (P->fd[e] < 0) fprintf(stderr," %14s","n/a");
+     else fprintf(stderr," %14.0f",v);
+   }
+
+	// reports the events of each stage, in total and per MB of n bytes
+
+void perfReport (perfstat P, uint64_t n)
+
+   { uint e,s;
+     double mb = n/1048576.0;
+     if (P == NULL) return;
+     perfStage(P,NULL);
+     fprintf(stderr,"\n%-16s %10s","stage","seconds");
+     for (e=0;e<PERFEVENTS;e++) fprintf(stderr," %14s",event[e].name);
+     fprintf(stderr,"\n");
+     for (s=0;s<P->ns;s++)
+	{ fprintf(stderr,"%-16s %10.3f",P->name[s],P->time[s]);
+	  for (e=0;e<PERFEVENTS;e++) column(P,e,P->count[s][e]);
+	  fprintf(stderr,"\n%-16s %10.3f","  per MB",P->time[s]/mb);
+	  for (e=0;e<PERFEVENTS;e++) column(P,e,P->count[s][e]/mb);
+	  fprintf(stderr,"\n");
+	}
+     fprintf(stderr,"\n");
+   }
+
+	// closes the counters and destroys P
+
+void perfDestroy (perfstat P)
+
+   { uint e;
+     for (e=0;e<PERFEVENTS;e++) if (P->fd[e] >= 0) close(P->fd[e]);
+     myfree(P);
+   }
@@ -0,0 +1,45 @@
+
+#ifndef INCLUDEDperfstat
+#define INCLUDEDperfstat
+
+	// supports counting hardware events per stage of a run (like
+	// building the index or parsing), with perf_event_open: cycles,
+	// instructions, last level cache misses, dTLB misses, branch
+	// misses, and also page faults. Only the user space of the calling
+	// thread is counted. Events the kernel or the hardware do not
+	// provide are reported as n/a, so without counters only the wall
+	// time of each stage is reported
+
+#include "basics.h"
+
+#define PERFEVENTS 6 // events counted
+#define PERFSTAGES 16 // maximum number of distinct stages
+
+typedef struct s_perfstat {
+    int fd[PERFEVENTS]; // counter of each event, -1 if not available
+    uint ns; // number of distinct stages so far
+    char *name[PERFSTAGES]; // name of each stage
+    uint64_t count[PERFSTAGES][PERFEVENTS]; // events of each stage
+    double time[PERFSTAGES]; // wall time of each stage, in seconds
+    int cur; // the current stage, -1 if none
+    uint64_t start[PERFEVENTS]; // the counters when it started
+    double t0; // and the time
+    } *perfstat;
+
+	// opens the counters, warning in stderr about those not available
+perfstat perfCreate (void);
+
+	// ends the current stage, if any, and starts stage name (a string
+	// that must last), or none if name is NULL. A stage can be entered
+	// many times, adding up. Does nothing if P is NULL
+void perfStage (perfstat P, char *name);
+
+	// ends the current stage and reports in stderr the events of each
+	// stage, in total and per MB of an input of n bytes. Does nothing
+	// if P is NULL
+void perfReport (perfstat P, uint64_t n);
+
+	// closes the counters and destroys P
+void perfDestroy (perfstat P);
+
+#endif
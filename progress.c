@@ -0,0 +1,202 @@
+
+	// supports reporting the progress of a parse from a sampling thread
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "progress.h"
+
+static double now (void)
+
+   { struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC,&t);
+     return t.tv_sec + t.tv_nsec/1e9;
+   }
+
+	// writes the status line to buf, with speeds since the last report
+
+static void line (progress P, char *buf, uint64_t len)
+
+   { uint64_t pos = atomic_load_explicit(&P->pos,memory_order_relaxed);
+     uint64_t phr = atomic_load_explicit(&P->phrases,memory_order_relaxed);
+     int done = atomic_load_explicit(&P->done,memory_order_relaxed);
+     double t = now(),dt = t-P->last,el = t-P->t0,eta = -1;
+     if (dt <= 0) dt = 1e-9;
+     if ((pos > P->from) && (el > 0))
+	eta = (P->n > pos ? P->n-pos : 0)*el/(pos-P->from);
+     snprintf(buf,len,"pos=%li n=%li phrases=%li elapsed=%.1f "
+	      "mb_per_s=%.3f phrases_per_s=%.1f eta=%.0f done=%i\n",pos,P->n,
+	      phr,el,(pos-P->lastPos)/dt/1048576.0,(phr-P->lastPhrases)/dt,
+	      eta,done);
+   }
+
+	// writes the status file, through a temporary file so that it is
+	// always whole
+
+static void writeStatus (progress P, char *buf)
+
+   { FILE *f = fopen(P->tmp,"w");
+     if (f == NULL) return;
+     fputs(buf,f);
+     if (fclose(f) == 0) rename(P->tmp,P->status);
+   }
+
+	// makes a report: a line in stderr, and the status file
+
+static void report (progress P)
+
+   { uint64_t pos = atomic_load_explicit(&P->pos,memory_order_relaxed);
+     uint64_t phr = atomic_load_explicit(&P->phrases,memory_order_relaxed);
+     double t = now(),dt = t-P->last,el = t-P->t0,eta;
+     char buf[256];
+     if (P->status != NULL) { line(P,buf,sizeof(buf)); writeStatus(P,buf); }
+     fprintf(stderr,"%.1f MB of %.1f MB (%.1f%%), %.2f MB/s, %.0f phrases/s",
+	     pos/1048576.0,P->n/1048576.0,100.0*pos/max(P->n,1),
+	     (pos-P->lastPos)/dt/1048576.0,(phr-P->lastPhrases)/dt);
+     if ((pos > P->from) && (el > 0))
+	{ eta = (P->n > pos ? P->n-pos : 0)*el/(pos-P->from);
+	  fprintf(stderr,", ETA %lih%02lim%02lis\n",(uint64_t)eta/3600,
+		  ((uint64_t)eta/60)%60,(uint64_t)eta%60);
+	}
+     else fprintf(stderr,"\n");
+     P->last = t; P->lastPos = pos; P->lastPhrases = phr;
+   }
+
+	// the sampling thread: reports at each interval, and answers the
+	// connections to the socket meanwhile. It sleeps in poll until the
+	// next report, a connection, or a byte on the wake pipe, which
+	// progDestroy writes when the parse ends
+
+static void *sampler (void *arg)
+
+   { progress P = (progress)arg;
+     struct pollfd pfd[2];
+     double next = P->t0 + P->every;
+     char buf[256];
+     int c,wait;
+     pfd[0].fd = P->wake[0];
+     pfd[1].fd = P->fd;
+     pfd[0].events = pfd[1].events = POLLIN;
+     while (!atomic_load_explicit(&P->done,memory_order_acquire))
+	{ wait = (int)((next-now())*1000)+1;
+	  if (wait < 0) wait = 0;
+	  if ((poll(pfd,P->fd >= 0 ? 2 : 1,wait) > 0) && (P->fd >= 0) &&
+	      (pfd[1].revents & POLLIN))
+	     { c = accept(P->fd,NULL,NULL);
+	       if (c >= 0)
+		  { line(P,buf,sizeof(buf));
+		    if (write(c,buf,strlen(buf)) < 0) {} // the client left
+		    close(c);
+		  }
+	     }
+	  if (now() >= next)
+	     { report(P);
+	       next += P->every;
+	       if (next < now()) next = now() + P->every;
+	     }
+	}
+     return NULL;
+   }
+
+	// opens the listening socket at path
+
+static int listenAt (char *path)
+
+   { struct sockaddr_un addr;
+     int fd;
+     if (strlen(path) >= sizeof(addr.sun_path))
+	{ fprintf(stderr,"Error: socket path %s is too long\n",path);
+	  exit(1);
+	}
+     memset(&addr,0,sizeof(addr));
+     addr.sun_family = AF_UNIX;
+     strcpy(addr.sun_path,path);
+     unlink(path); // a leftover from a previous run
+     fd = socket(AF_UNIX,SOCK_STREAM,0);
+     if ((fd < 0) || (bind(fd,(struct sockaddr*)&addr,sizeof(addr)) != 0) ||
+	 (listen(fd,8) != 0))
+	{ fprintf(stderr,"Error: cannot listen on socket %s\n",path);
+	  exit(1);
+	}
+     fcntl(fd,F_SETFL,O_NONBLOCK);
+     return fd;
+   }
+
+	// starts reporting the progress of a parse
+
+progress progCreate (uint64_t n, uint64_t from, uint64_t z, double every,
+		     char *status, char *sock)
+
+   { progress P = myalloc(sizeof(struct s_progress));
+     atomic_init(&P->pos,from);
+     atomic_init(&P->phrases,z);
+     atomic_init(&P->done,0);
+     P->n = n;
+     P->from = from;
+     P->fromPhrases = z;
+     P->every = every > 0 ? every : PROGEVERY;
+     P->t0 = P->last = now();
+     P->lastPos = from;
+     P->lastPhrases = z;
+     P->status = status;
+     P->tmp = NULL;
+     if (status != NULL)
+	{ P->tmp = myalloc(strlen(status)+5);
+	  sprintf(P->tmp,"%s.tmp",status);
+	}
+     P->sock = sock;
+     P->fd = sock != NULL ? listenAt(sock) : -1;
+     if (pipe(P->wake) != 0)
+	{ fprintf(stderr,"Error: cannot create the progress wake pipe\n");
+	  exit(1);
+	}
+     if (pthread_create(&P->thread,NULL,sampler,P) != 0)
+	{ fprintf(stderr,"Error: cannot start the progress thread\n");
+	  exit(1);
+	}
+     return P;
+   }
+
+	// the parser has parsed pos positions in the given phrases
+
+void progSet (progress P, uint64_t pos, uint64_t phrases)
+
+   { if (P == NULL) return;
+     atomic_store_explicit(&P->pos,pos,memory_order_relaxed);
+     atomic_store_explicit(&P->phrases,phrases,memory_order_relaxed);
+   }
+
+	// stops the thread and destroys P
+
+void progDestroy (progress P)
+
+   { double el;
+     uint64_t pos;
+     char buf[256];
+     if (P == NULL) return;
+     atomic_store_explicit(&P->done,1,memory_order_release);
+     if (write(P->wake[1],"",1) < 0) {} // the thread sees done anyway
+     pthread_join(P->thread,NULL);
+     close(P->wake[0]); close(P->wake[1]);
+     pos = atomic_load_explicit(&P->pos,memory_order_relaxed);
+     el = now()-P->t0;
+     if (el > 0)
+	fprintf(stderr,"Parsed %.1f MB in %.1f s, %.2f MB/s, %.0f phrases/s\n",
+		(pos-P->from)/1048576.0,el,(pos-P->from)/el/1048576.0,
+		(atomic_load_explicit(&P->phrases,memory_order_relaxed)-
+		 P->fromPhrases)/el);
+     if (P->status != NULL)
+	{ P->last = P->t0; P->lastPos = P->from;
+	  P->lastPhrases = P->fromPhrases;
+	  line(P,buf,sizeof(buf)); // with the overall speeds
+	  writeStatus(P,buf);
+	  myfree(P->tmp);
+	}
+     if (P->fd >= 0) { close(P->fd); unlink(P->sock); }
+     myfree(P);
+   }
@@ -0,0 +1,57 @@
+
+#ifndef INCLUDEDprogress
+#define INCLUDEDprogress
+
+	// supports reporting the progress of a parse from a sampling thread,
+	// so that the parser only stores its position and phrases after each
+	// phrase. Every so many seconds the thread prints in stderr the MB
+	// parsed, the speed in MB/s and phrases/s over the last interval, and
+	// the time left at the mean speed so far. The same figures can be
+	// written to a status file, replaced at each interval, and be asked
+	// for at any time on a Unix socket, which answers each connection with
+	// them and closes it. Both hold one line of key=value pairs:
+	// pos n phrases elapsed mb_per_s phrases_per_s eta done
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "basics.h"
+
+#define PROGEVERY 10 // default seconds between reports
+
+typedef struct s_progress {
+    _Atomic uint64_t pos; // text positions parsed, set by the parser
+    _Atomic uint64_t phrases; // phrases so far, set by the parser
+    _Atomic int done; // the parse ended
+    uint64_t n; // text positions to parse
+    uint64_t from; // the position the parse started at
+    uint64_t fromPhrases; // and the phrases before it
+    double every; // seconds between reports
+    double t0; // when the parse started
+    double last; // when the last report was made
+    uint64_t lastPos,lastPhrases; // and the figures then
+    char *status; // the status file, NULL if none
+    char *tmp; // where it is written before being renamed
+    char *sock; // the socket path, NULL if none
+    int fd; // the listening socket, -1 if none
+    int wake[2]; // a pipe to wake the thread when the parse ends
+    pthread_t thread;
+    } *progress;
+
+	// starts reporting the progress of a parse of n positions, from
+	// position from with z phrases before it (both 0 unless resuming),
+	// every so many seconds, also to the status file and the socket sock
+	// unless they are NULL
+progress progCreate (uint64_t n, uint64_t from, uint64_t z, double every,
+		     char *status, char *sock);
+
+	// the parser has parsed pos positions in the given phrases. Does
+	// nothing if P is NULL
+void progSet (progress P, uint64_t pos, uint64_t phrases);
+
+	// stops the thread, printing the overall speed, and destroys P. The
+	// status file is left with done=1, and the socket is removed. Does
+	// nothing if P is NULL
+void progDestroy (progress P);
+
+#endif
@@ -0,0 +1,460 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdbool.h>
+
+	// parses a target text relative to a fixed reference text R: each
+	// phrase copies from R or from earlier in the target, as in RLZ,
+	// and the chains are bounded as in greedy_BATLZ
+
+	// R is stored apart, so its positions are explicit and any of them
+	// can be a source. Its index is then just R and its suffix array,
+	// built once and mapped read-only, so many parser processes share
+	// them. The target is parsed as greedy_BATLZ does, on its own SA
+
+#include "segm.h"
+#include "verify.h"
+#include "progress.h"
+
+#define K 4  // space/time tradeoff for bitmaps
+
+uint MAX;    // max number of copies allowed
+
+	// the target, as in greedy_BATLZ
+
+byte *T; // null-terminated target
+
+uint64_t n; // its length, with the terminator
+
+uintData *SA, *ISA, *Map; // its SA and inverse, Map as in greedy_BATLZ
+
+uintData *D; // distance to next unusable pos, 0 for unusable pos
+
+uintData *U; // number of uses (length of chain)
+
+wmatrix M; // wmatrix of SA
+
+segm S; // segment structures, one per wm level
+
+	// the reference, mapped
+
+byte *R; // the reference, not null-terminated
+uint64_t r; // its length
+uintData *RSA; // its suffix array, without the terminator
+
+// initializes the structures of the target, given SA and ISA of
+// length n and maximum allowed chain length
+void initialize (uint64_t n, uint64_t maxChain)
+{
+  uint64_t i;
+  uint depth;
+	// create the data D and U
+  D = myalloc (n*sizeof(uintData));
+  for (i=0;i<n;i++) D[i] = n; // maximum bound for all positions
+  U = myalloc (n*sizeof(uintData));
+	// create wavelet matrix on the SA
+  depth = numbits(n);
+
+  fprintf(stderr,"Creating wavelet matrix... "); fflush(stderr);
+
+  M = wmCreate (n,depth,SA,K);
+
+  fprintf(stderr,"done\n");
+
+  Map = SA; // SA was scrambled by wmCreate
+
+  // create the segments, one per wmatrix level
+
+  fprintf(stderr,"Creating chain structures... "); fflush(stderr);
+
+  S = segmCreate(M,D,Map);
+
+  fprintf(stderr,"done\n");
+
+	// stores the maximum number of copies
+  if (maxChain == 0)
+  {
+    fprintf (stderr,"maxchain must be positive or parse is trivial\n");
+    exit(1);
+  }
+  MAX = maxChain;
+}
+
+#define nomax ((uint64_t)~0)
+
+// finds the longest admissible phrase T[i..], returning matching length
+// and source
+static uint64_t check (segm S, int64_t i, int64_t sp, int64_t ep,
+		       uintData val)
+
+{ uint lev = 0;
+  int p = numbits(S->size);
+  uint64_t v,maxv;
+  int64_t nsp,nep;
+
+  maxv = nomax;
+  while ((i >= 0) && (sp <= ep))
+  {
+    p--;
+    if (i >= (1<<p)-1) // all the left part is inside
+    {
+      nsp = sp; nep = ep;
+      wmTrackLeftRange (S->wm,lev,&nsp,&nep);
+      if (nsp <= nep)
+      {
+        v = cappedMax (S,lev+1,nsp,nep,val);
+        v = Map[v];
+        if (D[v] >= val) return v;
+        if ((maxv == nomax) || (D[v] > D[maxv])) maxv = v;
+      }
+      i -= (1<<p);
+      wmTrackRightRange (S->wm,lev,&sp,&ep);
+    }
+    else
+    {
+      wmTrackLeftRange (S->wm,lev,&sp,&ep);
+    }
+    lev++;
+  }
+
+  return maxv;
+}
+
+
+// SA[sp..ep] corresponds to T[i..i+len-1], extend by 1 char and
+// descend the whole stree edge
+uint64_t restrictRange (int64_t sp, int64_t ep, uint64_t i, uint64_t len,
+		   int64_t *nsp, int64_t *nep)
+{
+  int64_t p,m,om;
+  byte c,c0 = T[i+len];
+  while (sp <= ep)
+  {
+    m = (sp+ep)/2;
+    c = T[SA[m]+len];
+    if (c == c0) break;
+    if (c < c0) sp = m+1;
+    else ep = m-1;
+  }
+  if (sp > ep)
+  {
+    *nsp = sp; *nep = ep; return len;
+  }
+  // char found at m
+  p = om = m;
+  *nsp = sp;
+  while (*nsp < p)
+  {
+    m = (*nsp+p)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nsp = m+1;
+  }
+  p = om;
+  *nep = ep;
+  while (*nep > p)
+  {
+    m = (*nep+p+1)/2;
+    c = T[SA[m]+len];
+    if (c == c0) p = m; else *nep = m-1;
+  }
+  if (*nsp == *nep)
+    return n-SA[*nsp]; // stree leaf
+
+  while (T[SA[*nsp]+len] == T[SA[*nep]+len]) len++;
+
+  return len;
+}
+
+uint64_t nextPhrase (uint64_t i, uint64_t *source)
+{
+  uint64_t n = S->size; // text length
+  int64_t sp,ep,nsp,nep;
+  uint64_t len,l,maxl;
+
+  len = 0; sp = 0; ep = n-1;
+
+  while (1) // text terminator ensures termination here
+  {
+    l = restrictRange (sp,ep,i,len,&nsp,&nep);
+    if (nsp > nep) break; // cannot be extended even to len
+    maxl = check (S,i-1,nsp,nep,l);
+    if ((maxl == nomax) || (D[maxl] <= len)) break; // has no points
+    *source = maxl; len = D[*source];
+    sp = nsp; ep = nep;
+    if (len < l) break; // cannot be extended beyond l
+    len = l;
+  }
+  return len;
+}
+
+// R[p], or -1 if p is beyond R, which sorts it before any char
+static inline int refChar (uint64_t p)
+{
+  return p < r ? R[p] : -1;
+}
+
+// the same on the reference, whose SA does not contain T[i..], so the
+// chars of each edge are compared with it. All its positions are
+// usable, so the source is any suffix in the final range. The phrase
+// cannot reach the terminator of the target
+uint64_t nextPhraseRef (uint64_t i, uint64_t *source)
+{
+  int64_t sp,ep,nsp,nep,p,m;
+  uint64_t len;
+  int c0;
+
+  len = 0; sp = 0; ep = r-1;
+
+  while (i+len < n-1)
+  {
+    c0 = T[i+len];
+    nsp = sp; nep = ep; // first and last suffix with c0 at len
+    while (nsp < nep)
+    {
+      m = (nsp+nep)/2;
+      if (refChar(RSA[m]+len) < c0) nsp = m+1; else nep = m;
+    }
+    if (refChar(RSA[nsp]+len) != c0) break;
+    p = nsp; nep = ep;
+    while (p < nep)
+    {
+      m = (p+nep+1)/2;
+      if (refChar(RSA[m]+len) > c0) nep = m-1; else p = m;
+    }
+    len++;
+    while ((i+len < n-1) && (refChar(RSA[nsp]+len) == T[i+len]) &&
+           (refChar(RSA[nep]+len) == T[i+len])) len++;
+    *source = RSA[nsp];
+    sp = nsp; ep = nep;
+  }
+  return len;
+}
+
+
+// phrase T[i..j] = T[pi..] and T[j] is explicit
+// update D and U. last unusable position was last (can be -1 at first)
+// the source is in the target, or in the reference if ref
+// returns new value of last
+int64_t copyPhrase (uint64_t i, uint64_t j, uint64_t pi, bool ref,
+		    int64_t last)
+{
+  int64_t k,s;
+  s = pi;
+  for (k = i; k < j; k++)
+	{
+    U[k] = (ref ? 0 : U[s])+1;
+	  s++; if (!ref && (s == i)) s = pi; // for self-overlapping phrases
+	  if (U[k] >= MAX) // new unusable position
+	     while (last < k)
+        {
+          last++;
+          D[last] = k-last;
+          segmUpdate(S,ISA[last],D[last]);
+        }
+	}
+
+  U[j] = 0; // explicit char
+
+  return last;
+}
+
+
+bool file_exists (char *filename) {
+  struct stat   buffer;
+  return (stat (filename, &buffer) == 0);
+}
+
+// reads text file fname into *T, null-terminated, and its suffix array,
+// created with gensa if it does not exist, into *SA. Gives its length
+uint64_t readBlock (char *fname, byte **T, uintData **SA)
+{
+  struct stat st;
+  FILE *f;
+  uint64_t n;
+  char fnameSA[1024];
+
+  strcpy (fnameSA,fname);
+  strcat(fnameSA,".sa");
+  if (stat(fname,&st) != 0)
+  {
+    fprintf(stderr,"Cannot open %s\n",fname);
+    exit(1);
+  }
+  n = st.st_size;
+  f = fopen(fname,"r");
+  if ((f == NULL) || (n == 0))
+  {
+    fprintf(stderr,"Cannot open %s, or it is empty\n",fname);
+    exit(1);
+  }
+  *T = myalloc(n+1);
+  fread (*T,1,n,f);
+  fclose(f);
+  (*T)[n] = 0;
+
+  if (!file_exists(fnameSA))
+  {
+    fprintf(stderr,"File %s does not exist, creating it\n",fnameSA);
+    char cmdbuf[1024];
+    snprintf (cmdbuf, sizeof(cmdbuf), "./gensa %s %s", fname, fnameSA);
+    int ret = system(cmdbuf);
+    if (ret != 0)
+    {
+      fprintf(stderr,"Error creating %s\n",fnameSA);
+      exit(1);
+    }
+  }
+
+  f = fopen(fnameSA,"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",fnameSA);
+    exit(1);
+  }
+  *SA = myalloc((n+1)*sizeof(uintData));
+  (*SA)[0] = n; // simulate the final \0, kkp does not add it
+  fread (*SA+1,sizeof(uintData),n,f);
+  fclose(f);
+  return n;
+}
+
+// maps file fname read-only, and gives its length in *len
+void *mapFile (char *fname, uint64_t *len)
+{
+  struct stat st;
+  void *map;
+  int fd = open(fname,O_RDONLY);
+  if ((fd == -1) || fstat(fd,&st) || (st.st_size == 0))
+  {
+    fprintf(stderr,"Cannot open %s, or it is empty\n",fname);
+    exit(1);
+  }
+  *len = st.st_size;
+  map = mmap(NULL,*len,PROT_READ,MAP_SHARED,fd,0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    fprintf(stderr,"Cannot map %s\n",fname);
+    exit(1);
+  }
+  return map;
+}
+
+void main (int argc, char **argv)
+{
+  uint64_t z,i,len,source,l,s,sal;
+  int64_t last = -1;
+  bool fromRef;
+  archive V = NULL; // phrases kept for --verify
+  char fnameSA[1024];
+  byte *TV;
+  char *prog; // value of --progress
+  char *status; // file for --status
+  char *sock; // socket for --status-socket
+  progress P;
+
+  if (argFlag(&argc,argv,"--verify")) V = arcCreate();
+  prog = argOption(&argc,argv,"--progress");
+  status = argOption(&argc,argv,"--status");
+  sock = argOption(&argc,argv,"--status-socket");
+
+  if (argc < 3)
+  {
+    fprintf(stderr,"Usage: %s <reference> <target> [<maxchain>] [--verify]\n"
+    "[--progress <s>] [--status <file>] [--status-socket <path>]\n"
+    "Parses <target> with sources in <reference> or earlier in <target>\n"
+    "<reference>.sa and <target>.sa are created if needed\n"
+    "No maxchain uses infinity and yields the max chain\n"
+    "--verify checks the parse in memory after producing it\n"
+    "--progress reports the progress every <s> seconds (%i by default),\n"
+    "  also to <file> with --status, and on request on the Unix socket\n"
+    "  <path> with --status-socket\n"
+    "Redirect output to save/discard tuples\n\n",argv[0],PROGEVERY);
+    exit(1);
+  }
+
+  fprintf(stderr,"Mapping reference and its suffix array... ");
+  fflush(stderr);
+  strcpy (fnameSA,argv[1]);
+  strcat(fnameSA,".sa");
+  if (!file_exists(fnameSA))
+  {
+    fprintf(stderr,"File %s does not exist, creating it\n",fnameSA);
+    char cmdbuf[1024];
+    snprintf (cmdbuf, sizeof(cmdbuf), "./gensa %s %s", argv[1], fnameSA);
+    int ret = system(cmdbuf);
+    if (ret != 0)
+    {
+      fprintf(stderr,"Error creating %s\n",fnameSA);
+      exit(1);
+    }
+  }
+  R = mapFile(argv[1],&r);
+  RSA = mapFile(fnameSA,&sal);
+  if (sal != r*sizeof(uintData))
+  {
+    fprintf(stderr,"%s does not match %s\n",fnameSA,argv[1]);
+    exit(1);
+  }
+  fprintf(stderr,"done, r = %li\n",r);
+
+  fprintf(stderr,"Reading target and its suffix array... ");
+  fflush(stderr);
+  n = readBlock(argv[2],&T,&SA)+1;
+  ISA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) ISA[SA[i]] = i;
+  fprintf(stderr,"done\n");
+
+  initialize(n,argc == 3 ? r+n : atoi(argv[3]));
+
+	// recover SA after wm construction, to save space
+  SA = myalloc(n*sizeof(uintData));
+  for (i=0;i<n;i++) SA[ISA[i]] = i;
+
+	// parsing, the target starts at position r
+
+  fprintf(stderr,"Parsing starts, n = %li\n",n);
+  fprintf(stderr,"File %s, n = %li, parsed against %s with maxchain = %i\n\n",
+	  argv[2],n,argv[1],MAX);
+  printf("r = %li\n", r);
+  printf("n = %li\n", r+n);
+  if (V != NULL) arcStartAt(V,r);
+  i = 0; z = 0;
+  P = progCreate(n,i,z,prog != NULL ? atof(prog) : PROGEVERY,status,sock);
+
+  while (i < n)
+  {
+    len = nextPhrase(i,&source);
+    l = nextPhraseRef(i,&s);
+    fromRef = (l > 0) && (l >= len); // a source in R has chain length 0
+    if (fromRef) { len = l; source = s; }
+    if (len == 0) { printf("(0,0,%d)\n", T[i]); source = 0; }
+    else printf("(%li,%li,%d)\n", (fromRef ? 0 : r)+source, len, T[i+len]);
+    if (V != NULL) arcAdd(V,(fromRef ? 0 : r)+source,len,T[i+len]);
+    last = copyPhrase (i,i+len,source,fromRef,last);
+    i += len+1;
+    z++;
+    progSet(P,i,z);
+  }
+  progDestroy(P);
+  printf("\nz = %li phrases\n",z);
+  fprintf(stderr,"\n\nz = %li phrases\n",z);
+  if (argc == 3)
+  {
+    uint64_t u = 0;
+    for (i=0;i<n;i++) if (U[i] > u) u = U[i];
+    fprintf(stderr,"Maximum chain length = %li\n",u);
+  }
+  fprintf(stderr,"\n");
+  if (V != NULL)
+  {
+    TV = myalloc(r+n);
+    memcpy(TV,R,r);
+    memcpy(TV+r,T,n);
+    if (!verifyParse(V,TV,r+n,MAX,0)) exit(1);
+  }
+  exit(0);
+}
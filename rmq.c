@@ -0,0 +1,80 @@
+
+	// supports range maximum queries on a static array
+
+#include "rmq.h"
+
+	// the position of the larger of A[p] and A[q], p if they tie
+
+static inline uint64_t larger (uintData *A, uint64_t p, uint64_t q)
+
+   { return A[q] > A[p] ? q : p;
+   }
+
+	// position of a maximum in A[i..j], scanning
+
+static uint64_t scan (uintData *A, uint64_t i, uint64_t j)
+
+   { uint64_t p = i;
+     for (i++;i<=j;i++) p = larger(A,p,i);
+     return p;
+   }
+
+	// creates the structure for A[0..n-1], which is pointed to
+
+rmq rmqCreate (uintData *A, uint64_t n)
+
+   { rmq R = myalloc(sizeof(struct s_rmq));
+     uint64_t b;
+     uint l;
+     R->n = n; R->A = A;
+     R->nb = (n+RMQBLOCK-1)/RMQBLOCK;
+     R->nlevels = 1;
+     while ((((uint64_t)1) << R->nlevels) <= R->nb) R->nlevels++;
+     R->table = myalloc(R->nlevels*sizeof(uint64_t*));
+     R->table[0] = myalloc(R->nb*sizeof(uint64_t));
+     for (b=0;b<R->nb;b++)
+	R->table[0][b] = scan(A,b*RMQBLOCK,min((b+1)*RMQBLOCK,n)-1);
+     for (l=1;l<R->nlevels;l++)
+	{ R->table[l] = myalloc((R->nb-(1<<l)+1)*sizeof(uint64_t));
+	  for (b=0;b+(1<<l)<=R->nb;b++)
+	      R->table[l][b] = larger(A,R->table[l-1][b],
+				      R->table[l-1][b+(1<<(l-1))]);
+	}
+     return R;
+   }
+
+	// destroys R, not its array
+
+void rmqDestroy (rmq R)
+
+   { uint l;
+     for (l=0;l<R->nlevels;l++) myfree(R->table[l]);
+     myfree(R->table);
+     myfree(R);
+   }
+
+	// gives space of R in w-bit words, not counting its array
+
+uint64_t rmqSpace (rmq R)
+
+   { uint64_t s = sizeof(struct s_rmq)/(w/8) + R->nlevels;
+     uint l;
+     for (l=0;l<R->nlevels;l++) s += R->nb-(1<<l)+1;
+     return s;
+   }
+
+	// gives the position of a maximum in A[i..j], i <= j
+
+uint64_t rmqMax (rmq R, uint64_t i, uint64_t j)
+
+   { uint64_t bi = i/RMQBLOCK, bj = j/RMQBLOCK, p;
+     uint l;
+     if (bj <= bi+1) return scan(R->A,i,j);
+     p = larger(R->A,scan(R->A,i,(bi+1)*RMQBLOCK-1),
+		     scan(R->A,bj*RMQBLOCK,j));
+	// the whole blocks bi+1..bj-1, with two overlapping table cells
+     bi++; bj--;
+     l = w-1 - __builtin_clzll(bj-bi+1);
+     p = larger(R->A,p,R->table[l][bi]);
+     return larger(R->A,p,R->table[l][bj-(1<<l)+1]);
+   }
@@ -0,0 +1,35 @@
+
+#ifndef INCLUDEDrmq
+#define INCLUDEDrmq
+
+	// supports range maximum queries on a static array
+
+	// the array is cut in blocks of RMQBLOCK cells, and a sparse table
+	// over the block maxima answers the whole blocks of a range, so a
+	// query scans at most two partial blocks
+
+#include "basics.h"
+
+#define RMQBLOCK 64 // cells per block
+
+typedef struct s_rmq {
+    uint64_t n; // array length
+    uintData *A; // the array (shared)
+    uint64_t nb; // number of blocks
+    uint nlevels; // levels of the sparse table
+    uint64_t **table; // table[l][b] = cell of the max of blocks b..b+2^l-1
+    } *rmq;
+
+	// creates the structure for A[0..n-1], which is pointed to
+rmq rmqCreate (uintData *A, uint64_t n);
+
+	// destroys R, not its array
+void rmqDestroy (rmq R);
+
+	// gives space of R in w-bit words, not counting its array
+uint64_t rmqSpace (rmq R);
+
+	// gives the position of a maximum in A[i..j], i <= j
+uint64_t rmqMax (rmq R, uint64_t i, uint64_t j);
+
+#endif
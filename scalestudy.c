@@ -0,0 +1,352 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+// runs a variant on prefixes of doubling length of a file, recording the
+// time, peak memory and phrases of each run, and fits power laws to them
+// to extrapolate the needs of a larger run. Writes CSV to stdout
+
+#include "memplan.h"
+
+#define MAXSIZES 64 // prefixes measured at most
+#define FITPOINTS 4 // largest prefixes the power laws are fitted on
+#define MAXARGS 64 // arguments of the variant
+#define BUFSIZE (1024*1024) // for copying the prefixes
+
+// the variants that need <file>.sa, which is built once per prefix
+char *needSA[] = { "greedy_BATLZ", "baseline1_BATLZ", "baseline2_BATLZ",
+                   "bitcost_BATLZ", NULL };
+
+typedef struct {
+  uint64_t n; // prefix length
+  double secs,user,sys; // wall and cpu time of the variant
+  uint64_t rss; // its peak resident memory in bytes
+  uint64_t z; // its phrases
+  double saSecs; // the same for gensa, negative if the SA was reused
+  uint64_t saRss;
+} size;
+
+static double now (void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC,&t);
+  return t.tv_sec + t.tv_nsec/1e9;
+}
+
+// the file exists, is newer than ref (if not NULL), and has len bytes
+static int fresh (char *file, char *ref, uint64_t len)
+{
+  struct stat s,r;
+  if (stat(file,&s) != 0) return 0;
+  if ((ref != NULL) && ((stat(ref,&r) != 0) || (s.st_mtime < r.st_mtime)))
+    return 0;
+  return s.st_size == len;
+}
+
+// runs args[0] with stdout to a pipe, which is scanned for "z = <z>" if z
+// is not NULL, and stderr to file lname. Gives the exit status, and the times
+// and peak memory of the run
+static int run (char **args, char *lname, uint64_t *z, double *secs,
+                double *user, double *sys, uint64_t *rss)
+{
+  int fd[2],status;
+  pid_t pid;
+  struct rusage ru;
+  FILE *out;
+  char *line = NULL;
+  size_t len = 0;
+  double t;
+
+  if (pipe(fd) != 0)
+  {
+    fprintf(stderr,"Cannot create a pipe\n");
+    exit(1);
+  }
+  fflush(stdout); fflush(stderr);
+  t = now();
+  pid = fork();
+  if (pid < 0)
+  {
+    fprintf(stderr,"Cannot fork\n");
+    exit(1);
+  }
+  if (pid == 0)
+  {
+    int e = open(lname,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    dup2(fd[1],1);
+    if (e >= 0) dup2(e,2);
+    close(fd[0]); close(fd[1]);
+    execv(args[0],args);
+    fprintf(stderr,"Cannot run %s\n",args[0]);
+    _exit(127);
+  }
+  close(fd[1]);
+  out = fdopen(fd[0],"r");
+  if (z != NULL) *z = 0;
+  while (getline(&line,&len,out) != -1)
+    if (z != NULL) sscanf(line,"z = %lu",z);
+  free(line);
+  fclose(out);
+  wait4(pid,&status,0,&ru);
+  *secs = now()-t;
+  *user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec/1e6;
+  *sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec/1e6;
+  *rss = ((uint64_t)ru.ru_maxrss)*1024;
+  return status;
+}
+
+// the name of the prefix of len bytes of file, in dir
+static void prefixName (char *name, char *dir, char *file, uint64_t len)
+{
+  char *b = strrchr(file,'/');
+  sprintf(name,"%s/%s.%li",dir,b ? b+1 : file,len);
+}
+
+// writes the first len bytes of in to out, unless it is already there
+static void prefix (char *in, char *out, uint64_t len)
+{
+  FILE *f,*g;
+  byte *buf;
+  uint64_t k,l;
+  if (fresh(out,in,len)) return;
+  f = fopen(in,"r");
+  g = fopen(out,"w");
+  if ((f == NULL) || (g == NULL))
+  {
+    fprintf(stderr,"Cannot copy %s to %s\n",in,out);
+    exit(1);
+  }
+  buf = myalloc(BUFSIZE);
+  for (k=0;k<len;k+=l)
+  {
+    l = min(BUFSIZE,len-k);
+    if ((fread(buf,1,l,f) != l) || (fwrite(buf,1,l,g) != l))
+    {
+      fprintf(stderr,"Cannot copy %s to %s\n",in,out);
+      exit(1);
+    }
+  }
+  myfree(buf);
+  fclose(f);
+  if (fclose(g) != 0)
+  {
+    fprintf(stderr,"Cannot write %s\n",out);
+    exit(1);
+  }
+}
+
+// fits v = a n^b by least squares in log-log scale, on the k points
+// (x[i],v[i]) with v[i] > 0. Gives b, and v at target
+static double fit (double *x, double *v, uint k, uint64_t target, double *at)
+{
+  double lx,ly,sx = 0,sy = 0,sxx = 0,sxy = 0,a,b;
+  uint i,m = 0;
+  for (i=0;i<k;i++)
+  {
+    if (v[i] <= 0) continue;
+    lx = log(x[i]); ly = log(v[i]);
+    sx += lx; sy += ly; sxx += lx*lx; sxy += lx*ly; m++;
+  }
+  if ((m < 2) || (m*sxx == sx*sx)) { *at = 0; return 0; }
+  b = (m*sxy-sx*sy)/(m*sxx-sx*sx);
+  a = (sy-b*sx)/m;
+  *at = exp(a+b*log(target));
+  return b;
+}
+
+// fits v = c + d n by least squares, on the k points (x[i],v[i]), and
+// gives v at target. Memory is rather a fixed part plus a linear one
+static double affine (double *x, double *v, uint k, uint64_t target)
+{
+  double sx = 0,sy = 0,sxx = 0,sxy = 0,c,d;
+  uint i;
+  for (i=0;i<k;i++)
+  {
+    sx += x[i]; sy += v[i]; sxx += x[i]*x[i]; sxy += x[i]*v[i];
+  }
+  if ((k < 2) || (k*sxx == sx*sx)) return 0;
+  d = (k*sxy-sx*sy)/(k*sxx-sx*sx);
+  c = (sy-d*sx)/k;
+  return c+d*target;
+}
+
+void main (int argc, char **argv)
+{
+  size S[MAXSIZES];
+  char *args[MAXARGS],prog[1024],pre[1024],sa[1024],lname[1024],*opt;
+  char *dir = NULL,*extra = NULL,*variant,*base,*sarg[4];
+  uint64_t minSize = 1024*1024,maxSize = 0,target = 0,n,m;
+  uint ns = 0,na,i,f;
+  int clean,status,withSA;
+  struct stat st;
+  double bt,bm,bz,vt,vm,vz,u,s;
+  double x[MAXSIZES],t[MAXSIZES],r[MAXSIZES],y[MAXSIZES];
+
+  clean = argFlag(&argc,argv,"--clean");
+  if ((opt = argOption(&argc,argv,"--min-size")) != NULL)
+    minSize = memParse(opt);
+  if ((opt = argOption(&argc,argv,"--max-size")) != NULL)
+    maxSize = memParse(opt);
+  if ((opt = argOption(&argc,argv,"--target")) != NULL)
+    target = memParse(opt);
+  dir = argOption(&argc,argv,"--dir");
+  extra = argOption(&argc,argv,"--args");
+
+  if (argc != 4)
+  {
+    fprintf(stderr,"Usage: %s <variant> <file> <maxchain> [--min-size <size>] "
+    "[--max-size <size>]\n"
+    "[--target <size>] [--dir <dir>] [--args \"<options>\"] [--clean]\n"
+    "Runs <variant> with <maxchain> (and the <options> given) on the\n"
+    "prefixes of <file> of <min-size> bytes (1M by default), twice that,\n"
+    "and so on up to <max-size> (half of <file> by default). Sizes are\n"
+    "like 512K or 4G, no suffix is MB. Writes to stdout, as CSV, the\n"
+    "time, peak memory and phrases of each run, the exponents of the\n"
+    "power laws fitted on the %i largest prefixes, and their values at\n"
+    "<target> (the size of <file> by default). The prefixes, and their\n"
+    "suffix arrays if the variant needs them, are kept in <dir> (<file>\n"
+    ".prefixes by default) to be reused, unless --clean is given\n\n",
+    argv[0],FITPOINTS);
+    exit(1);
+  }
+  variant = argv[1];
+  base = strrchr(variant,'/') ? strrchr(variant,'/')+1 : variant;
+  if (strchr(variant,'/')) strcpy(prog,variant);
+  else sprintf(prog,"./%s",variant); // as gensa is run by the variants
+  if (access(prog,X_OK) != 0)
+  {
+    fprintf(stderr,"Cannot run %s\n",prog);
+    exit(1);
+  }
+  if (stat(argv[2],&st) != 0)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[2]);
+    exit(1);
+  }
+  n = st.st_size;
+  if (maxSize == 0) maxSize = n/2;
+  if (maxSize > n) maxSize = n;
+  if (target == 0) target = n;
+  if ((minSize == 0) || (2*minSize > maxSize))
+  {
+    fprintf(stderr,"Error: there must be at least 2 prefixes, of %li "
+            "bytes and twice that, up to %li bytes\n",minSize,maxSize);
+    exit(1);
+  }
+  if (dir == NULL)
+  {
+    dir = myalloc(strlen(argv[2])+16);
+    sprintf(dir,"%s.prefixes",argv[2]);
+  }
+  if ((mkdir(dir,0755) != 0) && ((stat(dir,&st) != 0) || !S_ISDIR(st.st_mode)))
+  {
+    fprintf(stderr,"Cannot create directory %s\n",dir);
+    exit(1);
+  }
+  for (withSA=0;needSA[withSA] != NULL;withSA++)
+    if (!strcmp(base,needSA[withSA])) break;
+  withSA = needSA[withSA] != NULL;
+
+  // the arguments of the variant, the prefix going in args[1]
+  args[0] = prog; args[1] = pre; args[2] = argv[3]; na = 3;
+  for (opt=extra ? strtok(extra," ") : NULL;opt != NULL;opt=strtok(NULL," "))
+  {
+    if (na+1 == MAXARGS)
+    {
+      fprintf(stderr,"Error: more than %i arguments in --args\n",MAXARGS-4);
+      exit(1);
+    }
+    args[na++] = opt;
+  }
+  args[na] = NULL;
+  sarg[0] = "./gensa"; sarg[1] = pre; sarg[2] = sa; sarg[3] = NULL;
+
+  printf("variant,maxchain,kind,n,seconds,user_seconds,sys_seconds,"
+         "peak_rss_bytes,z,sa_seconds,sa_peak_rss_bytes\n");
+  fprintf(stderr,"%14s %10s %10s %12s %10s %10s\n","n","seconds","cpu",
+          "peak MB","z","SA secs");
+  for (m=minSize;(m<=maxSize) && (ns<MAXSIZES);m*=2)
+  {
+    size *Z = &S[ns];
+    Z->n = m;
+    if (m == n) strcpy(pre,argv[2]); // the file itself, and its SA if any
+    else
+    {
+      prefixName(pre,dir,argv[2],m);
+      prefix(argv[2],pre,m);
+    }
+    sprintf(sa,"%s.sa",pre);
+    Z->saSecs = -1; Z->saRss = 0;
+    if (withSA && !fresh(sa,pre,4*m))
+    {
+      sprintf(lname,"%s/gensa.%li.log",dir,m);
+      status = run(sarg,lname,NULL,&Z->saSecs,&u,&s,&Z->saRss);
+      if (status != 0)
+      {
+        fprintf(stderr,"gensa failed on %s, see %s\n",pre,lname);
+        exit(1);
+      }
+    }
+    sprintf(lname,"%s/%s.%li.log",dir,base,m);
+    status = run(args,lname,&Z->z,&Z->secs,&Z->user,&Z->sys,&Z->rss);
+    if ((status != 0) || (Z->z == 0))
+    {
+      fprintf(stderr,"%s failed on %li bytes, see %s\n",base,m,lname);
+      break;
+    }
+    fprintf(stderr,"%14li %10.2f %10.2f %12.1f %10li ",m,Z->secs,
+            Z->user+Z->sys,Z->rss/1048576.0,Z->z);
+    if (Z->saSecs >= 0) fprintf(stderr,"%10.2f\n",Z->saSecs);
+    else fprintf(stderr,"%10s\n",withSA ? "reused" : "-");
+    printf("%s,%s,measured,%li,%.3f,%.3f,%.3f,%li,%li,",base,argv[3],m,
+           Z->secs,Z->user,Z->sys,Z->rss,Z->z);
+    if (Z->saSecs >= 0) printf("%.3f,%li\n",Z->saSecs,Z->saRss);
+    else printf(",\n");
+    fflush(stdout);
+    ns++;
+  }
+  if (ns < 2)
+  {
+    fprintf(stderr,"Error: fewer than 2 prefixes were parsed, nothing to "
+            "fit\n");
+    exit(1);
+  }
+
+  // the power laws, on the largest sizes where fixed costs matter least
+  f = ns > FITPOINTS ? ns-FITPOINTS : 0;
+  for (i=f;i<ns;i++)
+  {
+    x[i-f] = S[i].n; t[i-f] = S[i].secs; r[i-f] = S[i].rss; y[i-f] = S[i].z;
+  }
+  bt = fit(x,t,ns-f,target,&vt);
+  bm = fit(x,r,ns-f,target,&vm);
+  vm = affine(x,r,ns-f,target);
+  bz = fit(x,y,ns-f,target,&vz);
+  printf("%s,%s,exponent,,%.3f,,,%.3f,%.3f,,\n",base,argv[3],bt,bm,bz);
+  printf("%s,%s,extrapolated,%li,%.1f,,,%.0f,%.0f,,\n",base,argv[3],
+         target,vt,vm,vz);
+  fprintf(stderr,"\nfitted on %li..%li bytes: time ~ n^%.2f, memory ~ "
+          "n^%.2f, z ~ n^%.2f\n",S[f].n,S[ns-1].n,bt,bm,bz);
+  fprintf(stderr,"at %li bytes: %.0f seconds (%.1f hours), %.1f MB, %.0f "
+          "phrases\n",target,vt,vt/3600,vm/1048576.0,vz);
+
+  if (clean)
+  {
+    for (i=0;i<ns;i++)
+    {
+      if (S[i].n == n) continue;
+      prefixName(pre,dir,argv[2],S[i].n);
+      sprintf(sa,"%s.sa",pre);
+      unlink(pre); unlink(sa);
+      sprintf(lname,"%s/%s.%li.log",dir,base,S[i].n); unlink(lname);
+      sprintf(lname,"%s/gensa.%li.log",dir,S[i].n); unlink(lname);
+    }
+    rmdir(dir); // if nothing else is left there
+  }
+  exit(0);
+}
@@ -0,0 +1,79 @@
+#include <string.h>
+
+// counts or locates patterns in a compressed file without decompressing it
+
+#include "lzindex.h"
+
+#define MAXPAT 65536 // maximum pattern length read from stdin
+
+static int ucmp (const void *a, const void *b)
+{
+  uint64_t x = *(uint64_t*)a, y = *(uint64_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+void main (int argc, char **argv)
+{
+  archive A;
+  lzindex I;
+  uint64_t i,m,occs,q = 0;
+  uint64_t *occ;
+  char *P;
+  int locate;
+  FILE *f;
+
+  if ((argc < 3) || (strcmp(argv[2],"count") && strcmp(argv[2],"locate")))
+  {
+    fprintf(stderr,"Usage: %s <compressed_file> count|locate [<pattern>]\n"
+    "With no pattern, reads one pattern per line from stdin\n"
+    "Prints the number of occurrences, and their positions if locate\n\n",
+    argv[0]);
+    exit(1);
+  }
+  locate = !strcmp(argv[2],"locate");
+
+  f = fopen(argv[1],"r");
+  if (f == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[1]);
+    exit(1);
+  }
+  A = arcLoad(f);
+  fclose(f);
+
+  fprintf(stderr,"Building index... "); fflush(stderr);
+  I = idxCreate(A);
+  fprintf(stderr,"done, n = %li, z = %li, %li bytes\n",
+          A->n,A->z,(idxSpace(I)+arcSpace(A))*(w/8));
+
+  P = myalloc(MAXPAT+1);
+  while (1)
+  {
+    if (argc > 3)
+    {
+      if (q) break;
+      P = argv[3];
+    }
+    else
+    {
+      if (fgets(P,MAXPAT+1,stdin) == NULL) break;
+      if ((m = strlen(P)) && (P[m-1] == '\n')) P[m-1] = 0;
+    }
+    m = strlen(P);
+    q++;
+    occs = idxLocate(I,(byte*)P,m,&occ);
+    printf("%li",occs);
+    if (locate)
+    {
+      qsort(occ,occs,sizeof(uint64_t),ucmp);
+      for (i=0;i<occs;i++) printf(" %li",occ[i]);
+    }
+    printf("\n");
+    myfree(occ);
+  }
+
+  fprintf(stderr,"%li patterns\n",q);
+  idxDestroy(I);
+  arcDestroy(A);
+  exit(0);
+}
@@ -47,8 +47,26 @@ void segmDestroy (segm S)
 
 uint64_t segmSpace (segm S)
 
-   { return S->nlevels*((2*S->size+w-2)/w) + S->nlevels + 
-	    sizeof(struct s_segm)/(w/8);
+   { return segmSpaceFor(S->size,S->nlevels);
+   }
+
+	// gives the space of a segm over a wm of n values and l levels
+
+uint64_t segmSpaceFor (uint64_t n, uint l)
+
+   { return l*((2*n+w-2)/w) + l + sizeof(struct s_segm)/(w/8);
+   }
+
+	// the data value of position p of the last wm level, where the map
+	// is computed if there is none
+
+static inline uintData value (segm S, uint64_t p)
+
+   { uint64_t v;
+     if (S->map != NULL) { touch(&S->map[p]); v = S->map[p]; }
+     else v = wmPermValue(S->wm,p);
+     touch(&S->data[v]);
+     return S->data[v];
    }
 
 #define ancestor(i,l) ((((i)+1)>>(l))-1)
@@ -94,10 +112,10 @@ static uint64_t cappedmax (segm S, uint l, uint64_t i, uint64_t j, uintData val,
      if ((i == from) && (j == to)) return segmValue(S,node,l);
 	// otherwise, the search divides in two
      pos1 = cappedmax (S,l,i,from+span/2-1,val,left(node),nodel+1);
-     v1 = S->data[S->map[pos1]];
+     v1 = value(S,pos1);
      if (v1 >= val) return pos1;
      pos2 = cappedmax (S,l,from+span/2,j,val,right(node),nodel+1);
-     v2 = S->data[S->map[pos2]];
+     v2 = value(S,pos2);
      if (v1 >= v2) return pos1; else return pos2;
    }
 
@@ -126,7 +144,7 @@ static void update (segm S, uint64_t i, uint l, uintData v)
 	  sa = 2*pa+1+(1-d); // the sibling of a
 	  p = segmValue(S,sa,l); // pos of sibling (might be out of bounds)
 	  if (p < S->size) // if it exists
-	     { sv = S->data[S->map[p]]; // value of sibling
+	     { sv = value(S,p); // value of sibling
 	       if (sv > v) // pa should cease pointing to a
 	          { bitsWriteA(S->dirs[l],pa,1-d);
 	            v = sv; // for the ancestors
@@ -23,7 +23,8 @@ typedef struct s_segm {
     } *segm;
 
 	// creates a segment from wm and data assuming all data values are max
-        // data and map are arrays to retrieve data
+        // data and map are arrays to retrieve data. If map is NULL, wm
+	// must be of a permutation, and the map is computed instead
 
 segm segmCreate (wmatrix wm, uintData *data, uintData *map);
 
@@ -33,6 +34,10 @@ void segmDestroy (segm S);
 	// gives space of segm in w-bit words
 uint64_t segmSpace (segm S);
 
+	// gives the space segmSpace would give for a wm of n values and l
+	// levels, before creating it
+uint64_t segmSpaceFor (uint64_t n, uint l);
+
 	// returns maximum pos in data for node dirs[i] level l
 extern uint64_t segmValue (segm S, uint64_t i, uint l);
 
@@ -38,7 +38,14 @@ void segmDestroy (Tsegm S)
 
 uint64_t segmSpace (Tsegm S)
 
-   { return ((2*S->size+w-2)/w) + sizeof(struct s_segm)/(w/8);
+   { return segmSpaceFor(S->size);
+   }
+
+	// gives the space of a segm of n values
+
+uint64_t segmSpaceFor (uint64_t n)
+
+   { return ((2*n+w-2)/w) + sizeof(struct s_segm)/(w/8);
    }
 
 #define ancestor(i,l) ((((i)+1)>>(l))-1)
@@ -82,9 +89,11 @@ static uint64_t cappedmax (Tsegm S, uint64_t i, uint64_t j, uintData val,
      if ((i == from) && (j == to)) return segmValue(S,node);
 	// otherwise, the search divides in two
      pos1 = cappedmax (S,i,from+span/2-1,val,left(node),nodel+1);
+     touch(&S->data[pos1]);
      v1 = S->data[pos1];
      if (v1 >= val) return pos1;
      pos2 = cappedmax (S,from+span/2,j,val,right(node),nodel+1);
+     touch(&S->data[pos2]);
      v2 = S->data[pos2];
      if (v1 >= v2) return pos1; else return pos2;
    }
@@ -114,7 +123,8 @@ void segmUpdate (Tsegm S, uint64_t i, uintData v)
 	  sa = 2*pa+1+(1-d); // the sibling of a
 	  p = segmValue(S,sa); // pos of sibling (might be out of bounds)
 	  if (p < S->size) // if it exists
-	     { sv = S->data[p]; // value of sibling
+	     { touch(&S->data[p]);
+	       sv = S->data[p]; // value of sibling
 	       if (sv > v) // pa should cease pointing to a
 	          { bitsWriteA(S->dirs,pa,1-d);
 	            v = sv; // for the ancestors
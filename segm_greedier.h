@@ -31,6 +31,10 @@ void segmDestroy (Tsegm S);
 	// gives space of segm in w-bit words
 uint64_t segmSpace (Tsegm S);
 
+	// gives the space segmSpace would give for n values, before creating
+	// it
+uint64_t segmSpaceFor (uint64_t n);
+
 	// returns maximum pos in data for node dirs[i]
 extern uint64_t segmValue (Tsegm S, uint64_t i);
 
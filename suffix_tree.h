@@ -22,6 +22,11 @@ under the same terms as Perl itself.
 *******************************************************************************/
 
 #include "segm_greedier.h"
+#include "archive.h"
+#include "bounds.h"
+#include "hopcost.h"
+#include "checkpoint.h"
+#include "memplan.h"
 
 /* A type definition for a 32 bits variable - a double word. */
 #define     DBL_WORD      unsigned long   
@@ -47,6 +52,8 @@ typedef struct BLZAnnotation
 //   unsigned int distToC;
   unsigned int optimisticMinMax;
   unsigned int optimisticTextPos;
+  /* The most recent complete occurrence, 0 if none, for --max-distance */
+  unsigned int recentPos;
 }BLZA;
 
 
@@ -70,9 +77,10 @@ typedef struct SUFFIXTREENODE
    DBL_WORD                 edge_label_start;
    /* End index of the incoming edge */
    DBL_WORD                 edge_label_end;
-   /* Annotation for BLZ */
-   BLZA			    annot;
    unsigned int 	    strDepth;
+   /* Annotations for BLZ, allocated with the node: one per distinct chain
+      bound in greedier (see SUFFIX_TREE), a single one in minmax */
+   BLZA			    annot[];
 } NODE;
 
 /* This structure describes a suffix tree */
@@ -91,10 +99,35 @@ typedef struct SUFFIXTREE
    NODE*                    root;
    NODE **		    inversePointers;
    unsigned int * 	    costArray;
+   /* In greedier, the distance to the next position whose cost reaches the
+      bound of the annotation in use, cls, which is bound. Db, Cb and lastC
+      hold the D, the bound and the last such position of each annotation,
+      in increasing order of bounds */
    unsigned int * D;
+   unsigned int		cls, bound;
+   unsigned int **	Db;
+   unsigned int *	Cb;
+   unsigned int *	lastC;
    unsigned int *	    maxStrDepth;
    Tsegm		segm;
+   /* Phrases kept for --verify, NULL if they are not kept */
+   archive		phrases;
    uint COST;
+   /* Maximum distance from a phrase to its source, 0 for none */
+   DBL_WORD		maxDist;
+   /* Whether ties between sources are broken by the closest one */
+   int			closest;
+   /* Chain bounds along the text, NULL to use COST everywhere */
+   bounds		bounds;
+   /* Weights of the hops by distance class, NULL to count 1 per hop */
+   hopcost		hops;
+#ifdef PREFIXSUM
+   /* prefixSumCostArray[i] is the sum of costArray[1..i-1], and the
+      mean cost over each region of positions cannot exceed avg */
+   uint64_t *		    prefixSumCostArray;
+   uint64_t		region;
+   double		avg;
+#endif
 } SUFFIX_TREE;
 
 
@@ -185,5 +218,6 @@ void ST_DeleteTree(SUFFIX_TREE* tree);
 
 DBL_WORD ST_SelfTest(SUFFIX_TREE* tree);
 
-
-int parseBLZ(SUFFIX_TREE *tree);
+/* Parses the text, saving checkpoints on C and resuming from R, which are
+   NULL if not used. Gives the number of phrases */
+int parseBLZ(SUFFIX_TREE *tree, checkpoint C, checkpoint R);
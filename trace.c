@@ -0,0 +1,101 @@
+
+	// supports writing a binary trace of a parse, one record per phrase
+
+#include <sched.h>
+#include <time.h>
+
+#include "trace.h"
+
+static char magic[8] = "BATLZTR1";
+
+	// the writer thread: writes the records put in the ring, as they
+	// come, until the parse ends and the ring is empty
+
+static void *writer (void *arg)
+
+   { trace T = (trace)arg;
+     struct timespec nap = { 0, 1000000 }; // 1 ms
+     uint64_t head,tail,k;
+     int done;
+     while (1)
+	{ done = atomic_load_explicit(&T->done,memory_order_acquire);
+	  head = atomic_load_explicit(&T->head,memory_order_acquire);
+	  tail = atomic_load_explicit(&T->tail,memory_order_relaxed);
+	  if (head == tail)
+	     { if (done) return NULL;
+	       nanosleep(&nap,NULL);
+	       continue;
+	     }
+	  while (tail < head) // up to the end of the ring each time
+	     { k = min(head-tail,TRACERING-(tail & (TRACERING-1)));
+	       if (fwrite(T->ring+(tail & (TRACERING-1)),sizeof(tracerec),k,
+			  T->file) != k)
+		  { fprintf(stderr,"Error: cannot write the trace\n");
+		    exit(1);
+		  }
+	       tail += k;
+	       atomic_store_explicit(&T->tail,tail,memory_order_release);
+	     }
+	}
+   }
+
+	// creates fname with the header, and starts the writer
+
+trace traceCreate (char *fname, uint64_t n, uint64_t maxchain)
+
+   { trace T = myalloc(sizeof(struct s_trace));
+     uint64_t header[3];
+     T->file = fopen(fname,"w");
+     if (T->file == NULL)
+	{ fprintf(stderr,"Error: cannot create trace file %s\n",fname);
+	  exit(1);
+	}
+     header[0] = sizeof(tracerec);
+     header[1] = n;
+     header[2] = maxchain;
+     fwrite(magic,1,sizeof(magic),T->file);
+     fwrite(header,sizeof(uint64_t),3,T->file);
+     T->ring = myalloc(TRACERING*sizeof(tracerec));
+     atomic_init(&T->head,0);
+     atomic_init(&T->tail,0);
+     atomic_init(&T->done,0);
+     T->records = 0;
+     T->waits = 0;
+     if (pthread_create(&T->writer,NULL,writer,T) != 0)
+	{ fprintf(stderr,"Error: cannot start the trace writer\n");
+	  exit(1);
+	}
+     return T;
+   }
+
+	// puts record r in the ring, waiting if it is full
+
+void tracePut (trace T, tracerec *r)
+
+   { uint64_t head = T->records;
+     if (head - atomic_load_explicit(&T->tail,memory_order_acquire)
+	    == TRACERING)
+	{ T->waits++;
+	  while (head - atomic_load_explicit(&T->tail,memory_order_acquire)
+		    == TRACERING) sched_yield();
+	}
+     T->ring[head & (TRACERING-1)] = *r;
+     T->records = head+1;
+     atomic_store_explicit(&T->head,head+1,memory_order_release);
+   }
+
+	// writes the remaining records and destroys T
+
+void traceDestroy (trace T)
+
+   { atomic_store_explicit(&T->done,1,memory_order_release);
+     pthread_join(T->writer,NULL);
+     if (fclose(T->file) != 0)
+	{ fprintf(stderr,"Error: cannot write the trace\n");
+	  exit(1);
+	}
+     fprintf(stderr,"Trace: %li phrases, the ring was full %li times\n",
+	     T->records,T->waits);
+     myfree(T->ring);
+     myfree(T);
+   }
@@ -0,0 +1,55 @@
+
+#ifndef INCLUDEDtrace
+#define INCLUDEDtrace
+
+	// supports writing a binary trace of a parse, one record per phrase
+	// with the work it took, for offline analysis (see tracestat). The
+	// parser only puts each record in a lock-free ring shared with a
+	// writer thread, which writes them out in batches, so tracing does
+	// not add file writes to the parse. If the ring is full, the parser
+	// waits for the writer, and the waits are reported at the end
+
+	// the file is a header (the magic string, the size of a record, the
+	// text length and the maximum chain length, as 64-bit numbers) and
+	// then the records, all in the byte order of the machine
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "basics.h"
+
+#define TRACERING (1<<16) // records in the ring, a power of 2
+
+typedef struct {
+    uint32_t pos; // text position of the phrase
+    uint32_t len; // its length, 0 for an explicit character
+    uint32_t source; // where it is copied from
+    uint32_t depth; // the largest chain length in the source
+    uint32_t checks; // iterations of check (nodes in a window search)
+    uint32_t probes; // binary search steps of restrictRange
+    uint32_t updates; // segmUpdate calls triggered
+    uint32_t ancestors; // visited in changeAnnotationFromLeaf
+    } tracerec;
+
+typedef struct s_trace {
+    FILE *file; // the trace
+    tracerec *ring; // the records not written yet
+    _Atomic uint64_t head; // records put by the parser
+    _Atomic uint64_t tail; // records written by the writer
+    _Atomic int done; // the parse ended
+    pthread_t writer;
+    uint64_t records; // put so far, only used by the parser
+    uint64_t waits; // times the parser found the ring full
+    } *trace;
+
+	// creates fname with the header, and starts the writer
+trace traceCreate (char *fname, uint64_t n, uint64_t maxchain);
+
+	// puts record r in the ring, waiting if it is full
+void tracePut (trace T, tracerec *r);
+
+	// writes the remaining records, stops the writer, closes the file
+	// and destroys T, reporting in stderr the records and waits
+void traceDestroy (trace T);
+
+#endif
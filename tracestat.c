@@ -0,0 +1,162 @@
+#include <string.h>
+
+// summarizes the per-phrase trace written with --trace: totals and
+// histograms of each field, the work by chain depth of the source, and
+// the phrases that took the most work
+
+#include "trace.h"
+
+#define FIELDS 6 // those summarized, from len on
+#define BUCKETS 33 // 0, and then [2^(b-1)..2^b-1] for b = 1..32
+#define BATCH 4096 // records read at a time
+
+char *fieldName[FIELDS] = { "length", "source depth", "checks", "probes",
+                            "segmUpdates", "ancestors" };
+
+// the value of field f of r
+static uint32_t field (tracerec *r, int f)
+{
+  switch (f)
+  {
+    case 0: return r->len;
+    case 1: return r->depth;
+    case 2: return r->checks;
+    case 3: return r->probes;
+    case 4: return r->updates;
+    case 5: return r->ancestors;
+  }
+  return 0;
+}
+
+// the work of r, the field the top phrases are ranked by
+static uint64_t work (tracerec *r)
+{
+  return (uint64_t)r->checks + r->probes + r->updates + r->ancestors;
+}
+
+// 0 for 0, else 1 + the position of the highest bit of v
+static int bucket (uint32_t v)
+{
+  return v ? 32-__builtin_clz(v) : 0;
+}
+
+void main (int argc, char **argv)
+{
+  char mg[8],lab[24],*opt;
+  uint64_t header[3],z = 0,k,top = 10,nt = 0,d,nd;
+  uint64_t total[FIELDS],maxv[FIELDS],hist[FIELDS][BUCKETS];
+  uint64_t *dcount,(*dsum)[FIELDS];
+  tracerec *buf,*best;
+  size_t got;
+  int f,b;
+  FILE *file;
+
+  if ((opt = argOption(&argc,argv,"--top")) != NULL) top = atol(opt);
+  if (argc != 2)
+  {
+    fprintf(stderr,"Usage: %s <trace_file> [--top <k>]\n"
+    "Summarizes a trace written with --trace: totals and histograms of\n"
+    "the work per phrase, the work by chain depth of the source, and the\n"
+    "<k> phrases with the most work (10 by default)\n\n",argv[0]);
+    exit(1);
+  }
+  file = fopen(argv[1],"r");
+  if (file == NULL)
+  {
+    fprintf(stderr,"Cannot open %s\n",argv[1]);
+    exit(1);
+  }
+  if ((fread(mg,1,8,file) != 8) || memcmp(mg,"BATLZTR1",8) ||
+      (fread(header,sizeof(uint64_t),3,file) != 3) ||
+      (header[0] != sizeof(tracerec)))
+  {
+    fprintf(stderr,"Error: %s is not a trace of this version\n",argv[1]);
+    exit(1);
+  }
+
+  nd = header[2]+1 < 1024 ? header[2]+1 : 1024; // depths kept apart
+  dcount = myalloc((nd+1)*sizeof(uint64_t));
+  dsum = myalloc((nd+1)*sizeof(*dsum));
+  memset(dcount,0,(nd+1)*sizeof(uint64_t));
+  memset(dsum,0,(nd+1)*sizeof(*dsum));
+  memset(total,0,sizeof(total));
+  memset(maxv,0,sizeof(maxv));
+  memset(hist,0,sizeof(hist));
+  buf = myalloc(BATCH*sizeof(tracerec));
+  best = myalloc((top+1)*sizeof(tracerec));
+
+  while ((got = fread(buf,sizeof(tracerec),BATCH,file)) > 0)
+    for (k=0;k<got;k++)
+    {
+      tracerec *r = buf+k;
+      z++;
+      d = min(r->depth,nd); // the last one collects the deeper ones
+      dcount[d]++;
+      for (f=0;f<FIELDS;f++)
+      {
+        uint32_t v = field(r,f);
+        total[f] += v;
+        if (v > maxv[f]) maxv[f] = v;
+        hist[f][bucket(v)]++;
+        dsum[d][f] += v;
+      }
+      if (top == 0) continue;
+      if ((nt == top) && (work(r) <= work(&best[nt-1]))) continue;
+      b = nt < top ? nt : nt-1; // insertion, best is by decreasing work
+      for (;(b > 0) && (work(&best[b-1]) < work(r));b--) best[b] = best[b-1];
+      best[b] = *r;
+      if (nt < top) nt++;
+    }
+  fclose(file);
+  if (z == 0)
+  {
+    fprintf(stderr,"Error: %s has no phrases\n",argv[1]);
+    exit(1);
+  }
+
+  printf("n = %li, maxchain = %li, z = %li phrases\n\n",header[1],
+         header[2],z);
+  printf("%-14s %16s %12s %12s\n","per phrase","total","mean","max");
+  for (f=0;f<FIELDS;f++)
+    printf("%-14s %16li %12.2f %12li\n",fieldName[f],total[f],
+           (double)total[f]/z,maxv[f]);
+
+  for (f=0;f<FIELDS;f++)
+  {
+    printf("\n%s\n",fieldName[f]);
+    for (b=0;b<BUCKETS;b++)
+    {
+      if (hist[f][b] == 0) continue;
+      if (b <= 1) printf("  %10i            ",b);
+      else printf("  %10li..%-10li",1L<<(b-1),(1L<<b)-1);
+      printf(" %12li %6.2f%%\n",hist[f][b],100.0*hist[f][b]/z);
+    }
+  }
+
+  printf("\n  %-10s %16s","depth","phrases"); // of the source
+  for (f=0;f<FIELDS;f++) if (f != 1) printf(" %12s",fieldName[f]);
+  printf("\n");
+  for (d=0;d<=nd;d++)
+  {
+    if (dcount[d] == 0) continue;
+    sprintf(lab,d < nd ? "%li" : "%li+",d);
+    printf("  %-10s %16li",lab,dcount[d]);
+    for (f=0;f<FIELDS;f++)
+      if (f != 1) printf(" %12.2f",(double)dsum[d][f]/dcount[d]);
+    printf("\n");
+  }
+
+  if (nt > 0)
+  {
+    printf("\nphrases with the most work\n");
+    printf("%12s %10s %12s %6s %10s %10s %10s %10s\n","position","length",
+           "source","depth","checks","probes","updates","ancestors");
+    for (k=0;k<nt;k++)
+      printf("%12u %10u %12u %6u %10u %10u %10u %10u\n",best[k].pos,
+             best[k].len,best[k].source,best[k].depth,best[k].checks,
+             best[k].probes,best[k].updates,best[k].ancestors);
+  }
+
+  myfree(buf); myfree(best); myfree(dcount); myfree(dsum);
+  exit(0);
+}
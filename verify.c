@@ -0,0 +1,118 @@
+
+	// supports checking a parse in memory, instead of decompressing it
+	// and comparing against the original file
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "verify.h"
+
+#define CHUNK (1024*1024) // bytes compared by each memcmp
+
+typedef struct {
+    archive A;
+    byte *T;
+    uint64_t from,to; // phrases to check
+    uint64_t bad; // first wrong text position, or n if none
+    } job;
+
+	// first wrong text position of phrase j, or n if it is right
+
+static uint64_t checkPhrase (archive A, byte *T, uint64_t j)
+
+   { uint64_t s = A->source[j], p = A->start[j], l = A->len[j];
+     uint64_t c,t;
+     if (l && (s >= p)) return p; // not a copy from the left
+     for (t=0;t<l;t+=CHUNK)
+	{ c = min(CHUNK,l-t);
+	  if (memcmp(T+p+t,T+s+t,c))
+	     { while (T[p+t] == T[s+t]) t++;
+	       return p+t;
+	     }
+	}
+     if (T[p+l] != A->chr[j]) return p+l;
+     return A->n;
+   }
+
+static void *checkPhrases (void *arg)
+
+   { job *J = (job*)arg;
+     uint64_t j;
+     J->bad = J->A->n;
+     for (j=J->from;j<J->to;j++)
+	{ J->bad = checkPhrase(J->A,J->T,j);
+	  if (J->bad < J->A->n) break;
+	}
+     return NULL;
+   }
+
+static double now (void)
+
+   { struct timespec t;
+     clock_gettime(CLOCK_MONOTONIC,&t);
+     return t.tv_sec + t.tv_nsec/1e9;
+   }
+
+	// checks that A is a parse of T[0..n-1] whose chains are at most
+	// maxchain long, using threads threads (0 for all the cores).
+	// Reports in stderr the first mismatch and the throughput.
+	// Gives 1 if A is correct and 0 otherwise
+
+int verifyParse (archive A, byte *T, uint64_t n, uint64_t maxchain,
+		 uint threads)
+
+   { uint64_t t,j,p,bad,u;
+     uintData *U;
+     pthread_t *th;
+     job *J;
+     double t0 = now();
+     fprintf(stderr,"Verifying parse... "); fflush(stderr);
+     if (A->n != n)
+	{ fprintf(stderr,"wrong: phrases cover %li positions, n = %li\n",
+		  A->n,n);
+	  return 0;
+	}
+	// the phrases, in parallel, each thread on about n/threads bytes
+     if (threads == 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+     if (threads > A->z) threads = A->z;
+     th = myalloc(threads*sizeof(pthread_t));
+     J = myalloc(threads*sizeof(job));
+     for (t=0;t<threads;t++)
+	{ J[t].A = A; J[t].T = T;
+	  J[t].from = t ? J[t-1].to : 0;
+	  J[t].to = t+1 < threads ? arcPhrase(A,(t+1)*(n/threads)) : A->z;
+	  if (J[t].to < J[t].from) J[t].to = J[t].from;
+	  pthread_create(&th[t],NULL,checkPhrases,&J[t]);
+	}
+     bad = n;
+     for (t=0;t<threads;t++)
+	{ pthread_join(th[t],NULL);
+	  if (J[t].bad < bad) bad = J[t].bad;
+	}
+     myfree(th); myfree(J);
+     if (bad < n)
+	{ j = arcPhrase(A,bad);
+	  fprintf(stderr,"wrong: first mismatch at T[%li], phrase %li = "
+		  "(%li,%li,%i)\n",bad,j,A->source[j],A->len[j],A->chr[j]);
+	  return 0;
+	}
+	// the chain lengths, left to right as the variants compute them
+     U = arcDepths(A);
+     u = 0;
+     for (p=0;p<n;p++)
+	{ if (U[p] > u) u = U[p];
+	  if (U[p] > maxchain)
+	     { fprintf(stderr,"wrong: chain of length %i > %li at T[%li]\n",
+		       U[p],maxchain,p);
+	       myfree(U);
+	       return 0;
+	     }
+	}
+     myfree(U);
+     t0 = now()-t0;
+     fprintf(stderr,"ok, max chain %li, %.2f s, %.2f MB/s\n",u,t0,
+	     n/1024.0/1024.0/t0);
+     return 1;
+   }
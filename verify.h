@@ -0,0 +1,22 @@
+
+#ifndef INCLUDEDverify
+#define INCLUDEDverify
+
+	// supports checking a parse in memory, instead of decompressing it
+	// and comparing against the original file
+
+	// a phrase decodes correctly if its copy equals its source in T and
+	// its explicit char is right: by induction, then all of A decodes
+	// to T. So the phrases can be checked in parallel against T
+
+#include "archive.h"
+
+	// checks that A is a parse of T[0..n-1] whose chains are at most
+	// maxchain long, using threads threads (0 for all the cores).
+	// Reports in stderr the first mismatch and the throughput.
+	// Gives 1 if A is correct and 0 otherwise
+
+int verifyParse (archive A, byte *T, uint64_t n, uint64_t maxchain,
+		 uint threads);
+
+#endif
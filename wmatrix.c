@@ -2,6 +2,8 @@
 
 	// supports static wavelet matrices 
 
+#include <string.h>
+
 #include "wmatrix.h"
 
 	// creates a wavelet matrix from data[0..n-1] using lev lowest bits
@@ -42,6 +44,102 @@ wmatrix wmCreate (uint64_t n, uint16_t lev, uintData *data, uint k)
      return M;
    }
 
+typedef struct {
+    uintData *head; uint64_t h; // values read first
+    FILE *file[2]; // then those of file[0] and file[1], if not NULL
+    uint f; // the file being read
+    } wmInput;
+
+static uint64_t wmRead (wmInput *in, uintData *buf, uint64_t m)
+
+   { uint64_t r = 0,got;
+     if (in->h)
+	{ r = min(m,in->h);
+	  memcpy(buf,in->head,r*sizeof(uintData));
+	  in->head += r; in->h -= r;
+	}
+     while ((r < m) && (in->f < 2) && (in->file[in->f] != NULL))
+	{ got = fread(buf+r,sizeof(uintData),m-r,in->file[in->f]);
+	  r += got;
+	  if (r < m) in->f++;
+	}
+     return r;
+   }
+
+static void wmWrite (uintData *buf, uint64_t m, FILE *file)
+
+   { if (fwrite(buf,sizeof(uintData),m,file) != m)
+	{ fprintf(stderr,"Error: cannot write wavelet matrix temporary "
+			 "file\n");
+	  exit(1);
+	}
+   }
+
+	// creates a wavelet matrix from head[0..h-1] and n-h values of file
+
+wmatrix wmCreateStream (uint64_t n, uint16_t lev, uintData *head, uint64_t h,
+			FILE *file, uint k)
+
+   { uint l,s;
+     uint64_t i,j,m,c,nz[2];
+     uintData *buf,*out[2];
+     FILE *next[2];
+     wmInput in;
+     wmatrix M = myalloc(sizeof(struct s_wmatrix));
+     M->size = n;
+     M->nlevels = lev;
+     M->levels = myalloc(lev*sizeof(bitvector));
+     M->zeros = myalloc(lev*sizeof(uint64_t));
+     c = min(WMCHUNK,n);
+     buf = myalloc(c*sizeof(uintData));
+     out[0] = myalloc(c*sizeof(uintData));
+     out[1] = myalloc(c*sizeof(uintData));
+     in.head = head; in.h = h; in.f = 0;
+     in.file[0] = file; in.file[1] = NULL;
+     for (l=0;l<lev;l++)
+	{ M->levels[l] = bitsCreate(n);
+	  next[0] = next[1] = NULL;
+	  if (l+1 < lev) // the values with 0 and with 1, in order
+	     { next[0] = tmpfile(); next[1] = tmpfile();
+	       if ((next[0] == NULL) || (next[1] == NULL))
+		  { fprintf(stderr,"Error: cannot create wavelet matrix "
+				   "temporary files\n");
+		    exit(1);
+		  }
+	     }
+	  i = 0; nz[0] = nz[1] = 0;
+	  while ((m = wmRead(&in,buf,min(c,n-i))) > 0)
+	     { for (j=0;j<m;j++)
+		  { s = (buf[j] >> (lev-1-l)) & 1;
+		    bitsWrite(M->levels[l],i+j,s);
+		    if (next[s] != NULL)
+		       { out[s][nz[s]%c] = buf[j];
+			 if (++nz[s] % c == 0) wmWrite(out[s],c,next[s]);
+		       }
+		    else nz[s]++;
+		  }
+	       i += m;
+	     }
+	  if (i != n)
+	     { fprintf(stderr,"Error: wavelet matrix input has %li values, "
+			      "not %li\n",i,n);
+	       exit(1);
+	     }
+	  bitsRankPreprocess (M->levels[l],k);
+	  M->zeros[l] = nz[0];
+	  if (l > 0) { fclose(in.file[0]); fclose(in.file[1]); }
+	  if (next[0] != NULL)
+	     { for (s=0;s<2;s++)
+		  { wmWrite(out[s],nz[s]%c,next[s]);
+		    rewind(next[s]);
+		  }
+	       in.file[0] = next[0]; in.file[1] = next[1]; in.f = 0;
+	     }
+	}
+     myfree(buf); myfree(out[0]); myfree(out[1]);
+     return M;
+   }
+
 	// destroys M
 void wmDestroy (wmatrix M)
 
@@ -60,6 +158,56 @@ uint64_t wmSpace (wmatrix M)
 	    sizeof(struct s_wmatrix)/(w/8);
    }
 
+	// gives the space of a wmatrix of n values of lev bits
+
+uint64_t wmSpaceFor (uint64_t n, uint16_t lev, uint k)
+
+   { return lev*bitsSpaceFor(n,k) + lev + sizeof(struct s_wmatrix)/(w/8);
+   }
+
+	// writes M to file, which must be opened for writing
+
+void wmSave (wmatrix M, FILE *file)
+
+   { uint l;
+     fwrite (&M->size,sizeof(uint64_t),1,file);
+     fwrite (&M->nlevels,sizeof(uint16_t),1,file);
+     fwrite (M->zeros,sizeof(uint64_t),M->nlevels,file);
+     for (l=0;l<M->nlevels;l++) bitsSave(M->levels[l],file);
+   }
+
+	// loads wmatrix from file, which must be opened for reading,
+	// and preprocesses it for rank with parameter k
+
+wmatrix wmLoad (FILE *file, uint k)
+
+   { uint l;
+     wmatrix M = myalloc(sizeof(struct s_wmatrix));
+     fread (&M->size,sizeof(uint64_t),1,file);
+     fread (&M->nlevels,sizeof(uint16_t),1,file);
+     M->zeros = myalloc(M->nlevels*sizeof(uint64_t));
+     fread (M->zeros,sizeof(uint64_t),M->nlevels,file);
+     M->levels = myalloc(M->nlevels*sizeof(bitvector));
+     for (l=0;l<M->nlevels;l++)
+	{ M->levels[l] = bitsLoad(file);
+	  bitsRankPreprocess (M->levels[l],k);
+	}
+     return M;
+   }
+
+	// gives the value at position i
+
+uintData wmAccess (wmatrix M, uint64_t i)
+
+   { uint l;
+     uintData v = 0;
+     for (l=0;l<M->nlevels;l++)
+	{ v = (v << 1) | bitsAccess(M->levels[l],i);
+	  i = wmTrackDown(M,l,i);
+	}
+     return v;
+   }
+
 	// tracks down i from level l to level l+1
 
 extern inline uint64_t wmTrackDown (wmatrix M, uint16_t l, uint64_t i)
@@ -69,6 +217,58 @@ extern inline uint64_t wmTrackDown (wmatrix M, uint16_t l, uint64_t i)
      return i - r;
    }
 
+	// tracks up i from level l+1 to level l, where its bit is b:
+	// the position of the (i+1)th b, or of the (i-zeros+1)th 1
+
+uint64_t wmTrackUp (wmatrix M, uint16_t l, uint64_t i, uint b)
+
+   { uint64_t lo = 0, hi = M->size-1, m, r;
+     if (b) i -= M->zeros[l];
+     while (lo < hi)
+	{ m = (lo+hi)/2;
+	  r = bitsRank(M->levels[l],m);
+	  if (!b) r = m+1-r;
+	  if (r > i) hi = m; else lo = m+1;
+	}
+     return lo;
+   }
+
+	// the number of values u < n with u mod 2^(b+1) = low, where low
+	// has only bits 0..b-1: the values that go before those with bit b
+	// in the last level, among those ending in low
+
+static uint64_t wmBefore (uint64_t n, uint64_t low, uint b)
+
+   { return low < n ? ((n-1-low) >> (b+1)) + 1 : 0;
+   }
+
+	// gives the value at position i of the last level of a permutation
+
+uintData wmPermValue (wmatrix M, uint64_t i)
+
+   { uint b;
+     uint64_t v = 0,c;
+     for (b=0;b<M->nlevels;b++)
+	{ c = wmBefore(M->size,v,b);
+	  if (i >= c) { i -= c; v |= ((uint64_t)1) << b; }
+	}
+     return v;
+   }
+
+	// gives the position of value v in a permutation
+
+uint64_t wmPermLocate (wmatrix M, uintData v)
+
+   { uint b;
+     int l;
+     uint64_t i = 0;
+     for (b=0;b<M->nlevels;b++) // its position in the last level
+	if ((v >> b) & 1) i += wmBefore(M->size,v & ((((uint64_t)1)<<b)-1),b);
+     for (l=M->nlevels-1;l>=0;l--)
+	i = wmTrackUp(M,l,i,(v >> (M->nlevels-1-l)) & 1);
+     return i;
+   }
+
 	// tracks down [*i,*j] from level l to level l+1, left or right
 extern inline void wmTrackLeftRange (wmatrix M, uint16_t l, 
 				     int64_t *i, int64_t *j)
@@ -15,20 +15,54 @@ typedef struct s_wmatrix {
 
 typedef uint32_t uintData; // convert to 64 bits to handle longer texts
 
+#define WMCHUNK (1<<20)
+
 	// creates a wavelet matrix from data[0..n-1] using lev lowest bits
 	// bitrank parameter k
 
 wmatrix wmCreate (uint64_t n, uint16_t lev, uintData *data, uint k);
 
+	// creates the same wavelet matrix from head[0..h-1] followed by
+	// n-h values read from file, without holding the data in memory:
+	// each level is written to temporary files and read back for the
+	// next one. It uses 3 buffers of min(n,WMCHUNK) values
+wmatrix wmCreateStream (uint64_t n, uint16_t lev, uintData *head, uint64_t h,
+			FILE *file, uint k);
+
 	// destroys M
 void wmDestroy (wmatrix M);
 
 	// gives space of wmatrix in w-bit words
 uint64_t wmSpace (wmatrix M);
 
+	// gives the space wmSpace would give for n values of lev bits and
+	// bitrank parameter k, before creating it
+uint64_t wmSpaceFor (uint64_t n, uint16_t lev, uint k);
+
+	// writes M to file, which must be opened for writing
+void wmSave (wmatrix M, FILE *file);
+
+	// loads wmatrix from file, which must be opened for reading,
+	// and preprocesses it for rank with parameter k
+wmatrix wmLoad (FILE *file, uint k);
+
+	// gives the value at position i
+uintData wmAccess (wmatrix M, uint64_t i);
+
 	// tracks down i from level l to level l+1
 extern inline uint64_t wmTrackDown (wmatrix M, uint16_t l, uint64_t i);
 
+	// tracks up i from level l+1 to level l, where its bit is b
+uint64_t wmTrackUp (wmatrix M, uint16_t l, uint64_t i, uint b);
+
+	// for a wavelet matrix of a permutation of 0..size-1, the last level
+	// has the values sorted by their reversed bits, so the position of
+	// each value there can be computed instead of stored. These give
+	// the value at position i of the last level, and the position of
+	// value v in the sequence (the inverse of wmAccess)
+uintData wmPermValue (wmatrix M, uint64_t i);
+uint64_t wmPermLocate (wmatrix M, uintData v);
+
 	// tracks down [*i,*j] from level l to level l+1, left or right
 extern inline void wmTrackLeftRange (wmatrix M, uint16_t l, 
 				     int64_t *i, int64_t *j);